@@ -0,0 +1,122 @@
+#include "elk/core/bounding_box.h"
+#include "elk/core/bounding_box_batch.h"
+#include "elk/core/frustum.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace elk::core;
+
+// Compares the per box frustum and ray tests with the batched kernels
+// (scalar and SIMD) on the same random boxes.
+
+namespace {
+  const int n_boxes = 100000;
+  const int n_iterations = 200;
+
+  float random(float min, float max)
+  {
+    return min + (max - min) * (std::rand() / static_cast<float>(RAND_MAX));
+  }
+
+  // Average milliseconds per call of \param function
+  double measure(const std::function<void()>& function)
+  {
+    // Warm up the caches
+    function();
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < n_iterations; ++i)
+      function();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() /
+      n_iterations;
+  }
+
+  void report(const char* name, double ms, double reference_ms, int result)
+  {
+    printf("  %-24s %8.3f ms  %5.2fx  (result %d)\n",
+      name, ms, reference_ms / ms, result);
+  }
+}
+
+int main(int argc, char const *argv[])
+{
+  std::srand(1);
+  std::vector<BoundingBox> boxes;
+  BoundingBoxBatch batch;
+  for (int i = 0; i < n_boxes; ++i)
+  {
+    glm::vec3 min(
+      random(-1000, 1000), random(-100, 100), random(-1000, 1000));
+    glm::vec3 size(random(0.5, 10), random(0.5, 10), random(0.5, 10));
+    boxes.push_back(BoundingBox(min, min + size));
+    batch.add(boxes.back());
+  }
+
+  glm::mat4 projection = glm::perspective(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+  glm::mat4 view = glm::lookAt(
+    glm::vec3(0, 20, 0), glm::vec3(100, 0, -300), glm::vec3(0, 1, 0));
+  Frustum frustum(projection * view);
+  glm::vec3 origin(0, 20, 0);
+  glm::vec3 direction = glm::normalize(glm::vec3(1, -0.1f, -3));
+
+  printf("%d boxes, SIMD kernels use %s\n",
+    n_boxes, BoundingBoxBatch::instructionSet());
+
+  // Frustum culling
+  int n_visible = 0;
+  std::vector<unsigned char> visible;
+  double reference_ms = measure([&]() {
+    n_visible = 0;
+    for (auto& box : boxes)
+      n_visible += frustum.intersects(box);
+  });
+  printf("Frustum\n");
+  report("Frustum::intersects", reference_ms, reference_ms, n_visible);
+
+  for (bool simd : { false, true })
+  {
+    batch.setUseSimd(simd);
+    double ms = measure([&]() { batch.intersects(frustum, visible); });
+    n_visible = 0;
+    for (auto v : visible)
+      n_visible += v;
+    report(simd ? "BoundingBoxBatch SIMD" : "BoundingBoxBatch scalar",
+      ms, reference_ms, n_visible);
+  }
+
+  // Picking
+  int closest = -1;
+  reference_ms = measure([&]() {
+    float closest_distance = std::numeric_limits<float>::infinity();
+    closest = -1;
+    for (int i = 0; i < n_boxes; ++i)
+    {
+      auto hit = boxes[i].intersects(origin, direction);
+      if (hit.first && hit.second < closest_distance)
+      {
+        closest_distance = hit.second;
+        closest = i;
+      }
+    }
+  });
+  printf("Ray\n");
+  report("BoundingBox::intersects", reference_ms, reference_ms, closest);
+
+  for (bool simd : { false, true })
+  {
+    batch.setUseSimd(simd);
+    double ms = measure([&]() { closest = batch.closestHit(origin, direction); });
+    report(simd ? "BoundingBoxBatch SIMD" : "BoundingBoxBatch scalar",
+      ms, reference_ms, closest);
+  }
+
+  return 0;
+}
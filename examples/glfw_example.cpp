@@ -186,10 +186,12 @@ public:
   virtual void step(float dt) override;
 private:
   MyEngine& _engine;
+  bool _profile_key_down;
 };
 
 DebugInputController::DebugInputController(MyEngine& engine) :
-  _engine(engine)
+  _engine(engine),
+  _profile_key_down(false)
 {
 
 }
@@ -277,6 +279,47 @@ void DebugInputController::step(float dt)
       _engine._lamp2.setRadiance(0.18);
   }
 
+  // Point light shading, tiled shading needs compute shaders
+  if (_keys_pressed.count(Key::KEY_7))
+  {
+    _engine._renderer.setPointLightShading(
+      DeferredShadingRenderer::PointLightShading::LightVolumes);
+  }
+  else if (_keys_pressed.count(Key::KEY_8))
+  {
+    _engine._renderer.setPointLightShading(
+      DeferredShadingRenderer::PointLightShading::Clustered);
+  }
+  else if (_keys_pressed.count(Key::KEY_9))
+  {
+    _engine._renderer.setPointLightShading(
+      DeferredShadingRenderer::PointLightShading::TiledCompute);
+  }
+
+  // Dynamic resolution with a 60 Hz budget, or back to full resolution
+  if (_keys_pressed.count(Key::KEY_R) && !_engine._renderer.dynamicResolution())
+  {
+    _engine._renderer.setDynamicResolution(true);
+  }
+  else if (_keys_pressed.count(Key::KEY_T))
+  {
+    _engine._renderer.setDynamicResolution(false);
+  }
+
+  // Prints the average pass times and writes a trace once per press
+  bool profile_key_down = _keys_pressed.count(Key::KEY_P) > 0;
+  if (profile_key_down && !_profile_key_down)
+  {
+    const FrameProfiler& profiler = _engine._renderer.profiler();
+    for (const auto& times : profiler.averageTimes())
+    {
+      printf("%-12s cpu %6.3f ms  gpu %6.3f ms\n", times.name.c_str(),
+        times.cpu_time * 1e3f, times.gpu_time * 1e3f);
+    }
+    profiler.writeChromeTrace("elk_trace.json");
+  }
+  _profile_key_down = profile_key_down;
+
   if (_keys_pressed.count(Key::KEY_D))
   {
     _engine.camera().setFocalRatio(_engine.camera().focalRatio() * (1.0 - dt * 2));
@@ -2,6 +2,8 @@
 
 #include <vector>
 
+#include "elk/core/gl_state.h"
+
 #include <gl/glew.h>
 
 namespace elk { namespace core {
@@ -27,10 +29,11 @@ public:
   
   inline GLuint id() { return _id; };
 
-  inline void bind() { glBindBuffer(_init_data.buffer_type, _id); };
-  inline void unbind() { glBindBuffer(_init_data.buffer_type, 0); };
+  inline void bind() { GLState::bindBuffer(_init_data.buffer_type, _id); };
+  inline void unbind() { GLState::bindBuffer(_init_data.buffer_type, 0); };
 
   void render();
+  void renderInstanced(GLsizei n_instances);
   void update(InitData init_data);
 
 protected:
@@ -44,6 +47,7 @@ class ElementArrayBuffer : public ArrayBuffer
 public:
   ElementArrayBuffer(InitData init_data);
   void render();
+  void renderInstanced(GLsizei n_instances);
 private:
 };
 
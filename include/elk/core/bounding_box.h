@@ -1,6 +1,6 @@
 #pragma once
 
-#include "elk/core/mesh.h"
+#include <utility>
 
 #include <glm/glm.hpp>
 
@@ -11,11 +11,22 @@ class BoundingBox {
 public:
   BoundingBox(glm::vec3 min, glm::vec3 max);
   ~BoundingBox();
+  //! A box containing everything, used for objects without known bounds
+  static BoundingBox infinite();
+
   inline glm::vec3 min() const {return _min;}
   inline glm::vec3 max() const {return _max;}
+  bool isInfinite() const;
+  float surfaceArea() const;
+  bool contains(const BoundingBox& other) const;
+  bool intersects(const BoundingBox& other) const;
   bool intersects(const glm::vec3& point) const;
   std::pair<bool, float> intersects(
   	const glm::vec3& origin, const glm::vec3& direction) const;
+  //! The box containing this box transformed by \param transform
+  BoundingBox transformed(const glm::mat4& transform) const;
+  //! The smallest box containing both boxes
+  BoundingBox merged(const BoundingBox& other) const;
 private:
   glm::vec3 _min;
   glm::vec3 _max;
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "elk/core/bounding_box.h"
+#include "elk/core/frustum.h"
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace elk { namespace core {
+
+//! Many axis aligned bounding boxes stored as structure of arrays.
+/*!
+  Each coordinate of the corners is stored in its own array so that several
+  boxes can be tested at once against frustums, rays and spheres with SIMD
+  instructions. The kernels use AVX2
+  (8 boxes at a time) when the library is built with ELK_USE_AVX2, SSE
+  (4 boxes) on other x86 targets and scalar code elsewhere.
+  The arrays are padded to a multiple of 8 with empty boxes.
+*/
+class BoundingBoxBatch {
+public:
+  BoundingBoxBatch();
+  ~BoundingBoxBatch();
+
+  //! Returns the index of the added box
+  size_t add(const BoundingBox& box);
+  void set(size_t index, const BoundingBox& box);
+  BoundingBox get(size_t index) const;
+  void clear();
+  inline size_t size() const { return _size; };
+
+  //! Sets \param visible[i] to 1 if box i intersects \param frustum, else 0
+  /*!
+    Same result as Frustum::intersects() for each box. The boxes need to
+    be finite.
+  */
+  void intersects(
+    const Frustum& frustum, std::vector<unsigned char>& visible) const;
+  //! Sets \param distances[i] to the distance along \param direction to the
+  //! entry point of box i, or to infinity if the ray misses the box
+  /*!
+    Boxes behind the origin are missed, if the origin is inside a box the
+    distance is negative. Same result as BoundingBox::intersects() for rays,
+    a ray lying exactly in the plane of a side of a box misses it.
+  */
+  void intersects(
+    const glm::vec3& origin,
+    const glm::vec3& direction,
+    std::vector<float>& distances) const;
+  //! Sets \param intersecting[i - begin] to 1 if box i of [begin, end)
+  //! intersects the sphere, else 0
+  /*!
+    \param begin needs to be a multiple of 8 and \param intersecting needs
+    room for end - begin rounded up to a multiple of 8. A sphere touching a
+    box intersects it.
+  */
+  void intersects(
+    const glm::vec3& center,
+    float radius,
+    size_t begin,
+    size_t end,
+    unsigned char* intersecting) const;
+  //! Index of the closest box hit by the ray, -1 if no box is hit
+  int closestHit(
+    const glm::vec3& origin,
+    const glm::vec3& direction,
+    float* distance = nullptr) const;
+
+  //! Uses the scalar kernels if false, for comparisons. On by default
+  inline void setUseSimd(bool use) { _use_simd = use; };
+  //! Name of the instruction set used by the SIMD kernels
+  static const char* instructionSet();
+private:
+  //! Writes the distances of the boxes in [begin, end) to
+  //! \param distances[0, end - begin), begin is a multiple of 8
+  void intersects(
+    const glm::vec3& origin,
+    const glm::vec3& direction,
+    size_t begin,
+    size_t end,
+    float* distances) const;
+
+  size_t _size;
+  bool _use_simd;
+  // Padded to a multiple of 8
+  std::vector<float> _min_x, _min_y, _min_z;
+  std::vector<float> _max_x, _max_y, _max_z;
+};
+
+} }
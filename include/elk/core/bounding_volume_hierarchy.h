@@ -0,0 +1,109 @@
+#pragma once
+
+#include "elk/core/bounding_box.h"
+#include "elk/core/frustum.h"
+
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace elk { namespace core {
+
+//! A dynamic tree of axis aligned bounding boxes.
+/*!
+  Every leaf holds one object (a proxy) with a user data pointer. Leaves
+  store a box that is enlarged by a margin, objects that move within their
+  enlarged box do not change the tree. Leaves are inserted next to the
+  sibling that increases the surface area the least and the tree is kept
+  balanced with rotations, so inserts, removals and queries are O(log n).
+  Proxy ids stay valid until the proxy is removed.
+*/
+class BoundingVolumeHierarchy {
+public:
+  //! \param fat_margin is the enlargement of each side of the leaf boxes,
+  //! relative to the size of the box
+  BoundingVolumeHierarchy(float fat_margin = 0.1f);
+  ~BoundingVolumeHierarchy();
+
+  //! Returns the id of the new proxy
+  int insert(const BoundingBox& box, void* user_data);
+  void remove(int proxy);
+  //! Updates the box of \param proxy
+  /*!
+    \return true if the proxy had to be reinserted in the tree, false if
+    the new box is still contained in the enlarged box of the leaf.
+  */
+  bool move(int proxy, const BoundingBox& box);
+  void clear();
+
+  inline void* userData(int proxy) const
+    { return _nodes[proxy].user_data; };
+  inline const BoundingBox& boundingBox(int proxy) const
+    { return _nodes[proxy].tight_box; };
+
+  //! Appends the proxies that may be inside of \param frustum
+  /*!
+    Subtrees completely inside the frustum are added without testing their
+    leaves. The result is conservative since enlarged boxes are tested.
+  */
+  void query(const Frustum& frustum, std::vector<int>& proxies) const;
+  //! Appends the proxies whose box intersects \param box
+  void query(const BoundingBox& box, std::vector<int>& proxies) const;
+  //! Appends the proxies whose box is hit by the ray, with the distance
+  //! along \param direction to the hit, sorted front to back
+  void raycast(
+    const glm::vec3& origin,
+    const glm::vec3& direction,
+    std::vector<std::pair<int, float>>& hits) const;
+
+  inline size_t size() const { return _n_proxies; };
+  int height() const;
+private:
+  static const int null_node = -1;
+
+  struct Node
+  {
+    Node() :
+      box(BoundingBox::infinite()),
+      tight_box(BoundingBox::infinite()),
+      user_data(nullptr),
+      parent(null_node),
+      height(-1)
+    {
+      children[0] = null_node;
+      children[1] = null_node;
+    }
+
+    inline bool isLeaf() const { return children[0] == null_node; };
+
+    // Enlarged for leaves
+    BoundingBox box;
+    BoundingBox tight_box;
+    void* user_data;
+    // Next free node when the node is in the free list
+    int parent;
+    int children[2];
+    // Zero for leaves, -1 for free nodes
+    int height;
+  };
+
+  int allocateNode();
+  void freeNode(int node);
+  void insertLeaf(int leaf);
+  void removeLeaf(int leaf);
+  //! Rotates the tree at \param node if it is unbalanced, returns the node
+  //! that takes its place
+  int balance(int node);
+  //! Recomputes boxes and heights from \param node up to the root
+  void refitAncestors(int node);
+  BoundingBox enlarged(const BoundingBox& box) const;
+
+  std::vector<Node> _nodes;
+  int _root;
+  int _free_list;
+  size_t _n_proxies;
+  float _fat_margin;
+};
+
+} }
@@ -26,13 +26,16 @@ public:
 
   // Getters
   glm::mat4 projectionTransform() const;
-  glm::mat4 viewTransform() const;
+  //! Inverse of the absolute transform, only recomputed when it changes.
+  //! Not safe to call from several threads at once
+  const glm::mat4& viewTransform() const;
   // Origin and direction
   std::pair<glm::vec3, glm::vec3> unproject(const glm::vec2& position_ndc) const;
 protected:
   glm::mat4 _projection_transform;
-  // Cached view matrix
-  glm::mat4 _view_transform;
+  // Cached view matrix and the absolute transform it is the inverse of
+  mutable glm::mat4 _view_transform;
+  mutable glm::mat4 _view_transform_source;
 };
 
 //! A perspective camera defined in 3D space
@@ -62,6 +65,8 @@ public:
   void setFocalRatio(float focal_ratio);
   void setFocus(float focus);
   
+  inline float nearClippingPlane() const { return _near; };
+  inline float farClippingPlane() const { return _far; };
   float apertureDiameter();
   // f-number
   float focalRatio();
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace elk { namespace core {
+
+//! Dense storage of components of type \param T, indexed by entity.
+/*!
+  The components are packed in one contiguous array so that systems can
+  iterate over them linearly. A sparse array maps entity indices to
+  positions in the dense array, so lookup, insertion and removal are O(1).
+  Removal moves the last component into the hole, which changes the order
+  of the dense array and invalidates pointers to the moved component.
+*/
+template <typename T>
+class ComponentArray {
+public:
+  //! Adds or replaces the component of \param entity
+  T& insert(uint32_t entity, const T& component)
+  {
+    if (entity >= _sparse.size())
+      _sparse.resize(entity + 1, invalid_index);
+    uint32_t& dense_index = _sparse[entity];
+    if (dense_index != invalid_index)
+      return _components[dense_index] = component;
+    dense_index = static_cast<uint32_t>(_components.size());
+    _components.push_back(component);
+    _entities.push_back(entity);
+    return _components.back();
+  }
+
+  //! Does nothing if \param entity has no component
+  void erase(uint32_t entity)
+  {
+    if (!contains(entity))
+      return;
+    uint32_t dense_index = _sparse[entity];
+    uint32_t last_entity = _entities.back();
+    _components[dense_index] = std::move(_components.back());
+    _entities[dense_index] = last_entity;
+    _sparse[last_entity] = dense_index;
+    _sparse[entity] = invalid_index;
+    _components.pop_back();
+    _entities.pop_back();
+  }
+
+  inline bool contains(uint32_t entity) const
+  {
+    return entity < _sparse.size() && _sparse[entity] != invalid_index;
+  }
+
+  //! nullptr if \param entity has no component
+  inline T* find(uint32_t entity)
+  {
+    return contains(entity) ? &_components[_sparse[entity]] : nullptr;
+  }
+  inline const T* find(uint32_t entity) const
+  {
+    return contains(entity) ? &_components[_sparse[entity]] : nullptr;
+  }
+
+  // Dense access, \param i in [0, size())
+  inline T& operator[](size_t i) { return _components[i]; };
+  inline const T& operator[](size_t i) const { return _components[i]; };
+  //! Index of the entity owning component \param i
+  inline uint32_t entity(size_t i) const { return _entities[i]; };
+  inline size_t size() const { return _components.size(); };
+
+  void clear()
+  {
+    _components.clear();
+    _entities.clear();
+    _sparse.clear();
+  }
+private:
+  static const uint32_t invalid_index = 0xffffffff;
+
+  std::vector<T> _components;
+  std::vector<uint32_t> _entities;
+  std::vector<uint32_t> _sparse;
+};
+
+template <typename T>
+const uint32_t ComponentArray<T>::invalid_index;
+
+} }
@@ -2,7 +2,9 @@
 
 #include "elk/core/texture.h"
 #include "elk/core/cube_map_texture.h"
+#include "elk/core/job_system.h"
 
+#include <functional>
 #include <memory>
 
 namespace elk { namespace core {
@@ -14,6 +16,16 @@ public:
   ~CreateTexture() {};
   
   static std::shared_ptr<Texture> load(const char* path);
+  //! Decodes the image on a worker and creates the texture on the main thread
+  /*!
+    \param on_loaded is called on the main thread with the created texture,
+    or with nullptr if the image could not be loaded. It is not called if
+    decoding throws, waiting for the returned job then rethrows.
+    \return the main thread job creating the texture.
+  */
+  static JobSystem::JobHandle loadAsync(
+    JobSystem& job_system, const char* path,
+    std::function<void(std::shared_ptr<Texture>)> on_loaded);
   static std::shared_ptr<CubeMapTexture> loadCubeMap(
     const char* path_positive_x, const char* path_negative_x,
     const char* path_positive_y, const char* path_negative_y,
@@ -5,7 +5,13 @@
 #include "elk/core/shader_program.h"
 #include "elk/core/renderer.h"
 #include "elk/core/cube_map_texture.h"
-#include "elk/object_extensions/framebuffer_quad.h"
+#include "elk/core/streaming_buffer.h"
+#include "elk/core/texture_buffer.h"
+#include "elk/core/light_cluster_grid.h"
+#include "elk/core/render_scale_controller.h"
+#include "elk/core/render_graph.h"
+#include "elk/core/frame_profiler.h"
+#include "elk/object_extensions/light_source.h"
 #include "elk/object_extensions/renderable_cube_map.h"
 
 #include <memory>
@@ -19,44 +25,115 @@ class DirectionalLightSource;
 
 class DeferredShadingRenderer : public Renderer {
 public:
+  //! How point lights are shaded
+  enum class PointLightShading {
+    //! Instanced light volumes blended into the light buffer
+    LightVolumes,
+    //! One full screen pass, lights are binned into a LightClusterGrid on
+    //! the CPU
+    Clustered,
+    //! One compute dispatch culling lights per screen tile on the GPU.
+    //! Needs OpenGL 4.3 or ARB_compute_shader
+    TiledCompute
+  };
+
+  //! Attachments of the G-buffer, see shaders/deferred_shading/g_buffer.glsl
+  enum class GBufferLayout {
+    //! Albedo, and view space position, normal and material in RGB16F each
+    Full,
+    //! Albedo, octahedral normal and packed material in one RGBA16 texture,
+    //! and a depth texture positions are reconstructed from. About half the
+    //! bandwidth of the full layout for every pass reading the G-buffer
+    Compact
+  };
+
   DeferredShadingRenderer(
-    PerspectiveCamera& camera, int framebuffer_width, int framebuffer_height);
-  ~DeferredShadingRenderer();
+    PerspectiveCamera& camera, int framebuffer_width, int framebuffer_height,
+    GBufferLayout g_buffer_layout = GBufferLayout::Full);
+  ~DeferredShadingRenderer() = default;
   
   void setSkyBox(std::shared_ptr<RenderableCubeMap> sky_box);
+  //! LightVolumes by default. Clustered and tiled shading scale to many
+  //! more lights. Keeps the current shading and prints an error if
+  //! \param shading is not supported
+  void setPointLightShading(PointLightShading shading);
+  inline PointLightShading pointLightShading() const
+    { return _point_light_shading; };
+  //! Renders at a fraction of the framebuffer resolution chosen each frame
+  //! so that the GPU time of a frame stays within \param target_frame_time
+  //! seconds. The render targets keep their size, only the part of them
+  //! that is rendered to changes, and renderToScreen() upscales it.
+  //! Disabling goes back to the scale set by setRenderScale()
+  void setDynamicResolution(
+    bool enabled, float target_frame_time = 1.0f / 60.0f, float min_scale = 0.5f);
+  //! Fixed fraction of the framebuffer resolution to render at, in (0, 1].
+  //! Used while dynamic resolution is disabled
+  void setRenderScale(float scale);
+  //! Scale of the last frame
+  inline float renderScale() const { return _render_scale; };
+  inline bool dynamicResolution() const { return _dynamic_resolution; };
+  //! GPU time of the last frame that has been measured, in seconds
+  inline float gpuFrameTime() const { return _profiler.gpuFrameTime(); };
+  //! Times of the passes and the scene submission. Passes are named as in
+  //! the render graph: geometry, lights, reflections, highlights,
+  //! post_process, motion_blur, forward and screen
+  inline const FrameProfiler& profiler() const { return _profiler; };
   virtual void render(Object3D& scene) override;
 private:
   // Initialization. Called from constructor
   void initializeShaders();
-  void initializeFramebuffers(int framebuffer_width, int framebuffer_height);
+  //! Declares the passes for the G-buffer layout and whether there is a sky
+  //! box, and compiles them. Called from render() when one of them changed
+  void buildRenderGraph();
+  //! Declares that \param pass reads the G-buffer
+  void readGeometryBuffer(RenderGraph::Pass& pass, int albedo_mip_levels = 1);
 
-  // External render functions called from render()
-  // Input is the fbo to render to
-  void renderGeometryBuffer(FrameBufferQuad& geometry_buffer);
-  void renderLightSources(FrameBufferQuad& light_buffer);
-  
-  // ping pong rendering if irradiance buffers
-  void renderReflections(
-    FrameBufferQuad& sample_buffer, FrameBufferQuad& output_buffer);
-  void renderHighlights(
-    FrameBufferQuad& sample_buffer, FrameBufferQuad& output_buffer);
-  void renderPostProcess(
-    FrameBufferQuad& sample_buffer, FrameBufferQuad& output_buffer);
-  void renderPostProcessMotionBlur(
-    FrameBufferQuad& sample_buffer, FrameBufferQuad& output_buffer);
-  void forwardRenderIndependentRenderables(FrameBufferQuad& final_buffer);
-  
-  // Input is the fbo to sample from, index is the attachment to bind
-  void renderToScreen(FrameBufferQuad& sample_fbo_quad, int attachment);
+  //! Picks the render scale of the coming frame from the times of all
+  //! frames the profiler has read back since the last call. Frames that
+  //! are not done yet are read later, none are skipped
+  void updateRenderScale();
+  //! Size of the part of a texture of \param size rendered to at the
+  //! current scale
+  glm::ivec2 renderSize(const glm::uvec2& size) const;
+  //! Sets the viewport to the part of a texture of \param size rendered to
+  void setRenderViewport(const glm::uvec2& size);
+
+  // Passes of the render graph, the frame buffer to render to is bound and
+  // the textures read are bound to texture units
+  void renderGeometryBuffer(const RenderGraph::PassContext& context);
+  void renderLightSources(const RenderGraph::PassContext& context);
+  void renderReflections(const RenderGraph::PassContext& context);
+  void renderHighlights(const RenderGraph::PassContext& context);
+  void renderPostProcess(const RenderGraph::PassContext& context);
+  void renderPostProcessMotionBlur(const RenderGraph::PassContext& context);
+  void forwardRenderIndependentRenderables(
+    const RenderGraph::PassContext& context);
+  void renderToScreen(const RenderGraph::PassContext& context);
 
-  // Internal render functions
-  void renderPointLights();
-  void renderDirectionalLights();
-  void renderDiffuseEnvironmentLights();
-  void renderSkyBox();
-  void renderScreenSpaceReflections(FrameBufferQuad& sample_buffer);
+  // Internal render functions of the passes
+  //! Draws all point lights with two instanced draws, full screen quads for
+  //! the lights whose volume contains the camera and spheres for the others
+  void renderPointLights(const RenderGraph::PassContext& context);
+  //! Collects the view space instances of all point lights of the frame
+  void gatherPointLights();
+  //! Shades the gathered point lights in one pass over the light clusters
+  void renderClusteredPointLights(const RenderGraph::PassContext& context);
+  //! Shades the gathered point lights in one compute dispatch, adding to
+  //! the light buffer written by the pass
+  void renderTiledPointLights(const RenderGraph::PassContext& context);
+  //! Draws \param n_lights instances of \param mesh reading the lights
+  //! from byte \param offset of _point_light_buffer
+  void drawPointLightInstances(
+    Mesh& mesh, bool light_volume, GLintptr offset, GLsizei n_lights);
+  void renderDirectionalLights(const RenderGraph::PassContext& context);
+  void renderDiffuseEnvironmentLights(const RenderGraph::PassContext& context);
+  void renderSkyBox(const RenderGraph::PassContext& context);
+  void renderScreenSpaceReflections(const RenderGraph::PassContext& context);
 
   std::shared_ptr<ShaderProgram> _shading_program_point_lights;
+  std::shared_ptr<ShaderProgram> _shading_program_clustered_point_lights;
+  // Null without compute shader support
+  std::shared_ptr<ShaderProgram> _shading_program_tiled_point_lights;
   std::shared_ptr<ShaderProgram> _shading_program_directional_lights;
   std::shared_ptr<ShaderProgram> _shading_program_environment_diffuse;
   std::shared_ptr<ShaderProgram> _shading_program_reflections;
@@ -68,16 +145,35 @@ private:
   std::shared_ptr<ShaderProgram> _motion_blur_program;
   std::shared_ptr<ShaderProgram> _final_pass_through_program;
 
-  std::unique_ptr<FrameBufferQuad> _geometry_fbo_quad;
-  // Two irradiance FBOs to be able to perform ping ponging
-  std::unique_ptr<FrameBufferQuad> _irradiance_fbo_quad1;
-  std::unique_ptr<FrameBufferQuad> _irradiance_fbo_quad2;
-  std::unique_ptr<FrameBufferQuad> _post_process_fbo_quad;
+  GBufferLayout _g_buffer_layout;
+  glm::uvec2 _framebuffer_size;
+  // Passes and render targets of a frame, rebuilt when the passes change
+  RenderGraph _render_graph;
+  bool _render_graph_dirty;
 
   std::shared_ptr<RenderableCubeMap> _sky_box;
+  // Full screen passes, also shared by all light sources
+  std::shared_ptr<Mesh> _quad_mesh;
+  std::shared_ptr<Mesh> _light_sphere_mesh;
+  // Instances of the point lights of the frame
+  std::vector<PointLightInstance> _point_light_instances;
+  std::unique_ptr<StreamingBuffer> _point_light_buffer;
+
+  PointLightShading _point_light_shading;
+  // Lights read by the clustered and tiled shaders
+  std::unique_ptr<TextureBuffer> _light_texture_buffer;
+  LightClusterGrid _light_cluster_grid;
+  // Clusters and light indices of the grid
+  std::unique_ptr<TextureBuffer> _cluster_buffer;
+  std::unique_ptr<TextureBuffer> _cluster_light_index_buffer;
 
-  // Cached
-  glm::mat4 _camera_previous_view_transform;
+  float _render_scale;
+  float _fixed_render_scale;
+  bool _dynamic_resolution;
+  RenderScaleController _render_scale_controller;
+  // GPU times are read a few frames late instead of stalling, the frame
+  // time is the sum of the passes
+  FrameProfiler _profiler;
 };
 
 } }
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "elk/core/texture.h"
+#include "elk/core/shader_program.h"
+
+#include <gl/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <memory>
+
+namespace elk { namespace core {
+
+//! Fills mip levels of 2D textures from level 0 with a compute shader.
+/*!
+  One dispatch writes all levels. Each work group reduces a 64x64 tile to
+  levels 1 to 6 and the last group to finish reduces the tiles to the levels
+  after that, so level 0 is read once and no pass per level is needed.
+  Only the tiles covering a region of level 0 are reduced, which lets
+  renderers that draw to part of a texture skip the rest.
+  Needs compute shaders and a texture format that can be bound as image,
+  see supported() and supportsFormat(). Texture::generateMipMap() is the
+  fallback.
+*/
+class Downsampler {
+public:
+  //! Number of levels one dispatch can fill after level 0
+  static const int max_levels = 8;
+
+  Downsampler();
+  ~Downsampler();
+
+  //! Fills levels 1 to \param levels of \param texture, which needs to have
+  //! them allocated. \param internal_format is the one of the texture.
+  //! Levels beyond \param levels are left as they are and not sampled
+  void generate(
+    const Texture& texture,
+    GLenum internal_format,
+    glm::uvec2 region,
+    int levels);
+
+  static bool supported();
+  static bool supportsFormat(GLenum internal_format);
+private:
+  //! Grows the buffer of tile texels to hold \param n_tiles tiles
+  void reserveTiles(GLsizeiptr n_tiles);
+
+  std::unique_ptr<ShaderProgram> _program;
+  GLuint _tile_buffer;
+  GLsizeiptr _tile_capacity;
+};
+
+} }
@@ -3,6 +3,9 @@
 #include "elk/core/object_3d.h"
 #include "elk/core/mesh.h"
 #include "elk/core/camera.h"
+#include "elk/core/transform_hierarchy.h"
+#include "elk/core/job_system.h"
+#include "elk/core/entity_registry.h"
 
 #include <vector>
 #include <map>
@@ -22,12 +25,36 @@ namespace elk { namespace core {
 */
 class ElkEngine {
 public:
+  enum class UpdateMode {
+    //! All objects are updated in order on the calling thread
+    Serial,
+    //! Top level subtrees of the scenes are updated on worker threads.
+    //! See Object3D for what update() may do in this mode.
+    Parallel
+  };
+
   ElkEngine();
   virtual ~ElkEngine();
   
   // Getters
   PerspectiveCamera& camera();
   OrthoCamera& viewSpaceCamera();
+  //! Scheduler shared by all subsystems of the engine
+  JobSystem& jobSystem();
+
+  //! Store the transforms of the scenes in flat, contiguous arrays
+  /*!
+    When enabled, the transforms of scene, view_space and background_space
+    are updated in one linear pass each instead of walking the tree
+    recursively. The flat hierarchies are rebuilt automatically when
+    children are added or removed.
+  */
+  void setUseFlatTransformHierarchy(bool use);
+  //! Serial is deterministic and the default, useful when debugging
+  void setUpdateMode(UpdateMode mode);
+  //! Number of absolute transforms recomputed in the last update
+  inline unsigned int numberOfUpdatedTransforms() const
+    { return _n_updated_transforms; };
 
 protected:
   //! Update all objects
@@ -37,12 +64,30 @@ protected:
   Object3D scene;
   Object3D view_space;
   Object3D background_space;
+  //! Objects stored as components, updated after the scenes. Give it to
+  //! the renderer with Renderer::setEntityRegistry() to render them.
+  EntityRegistry entities;
 
   PerspectiveCamera perspective_camera;
   OrthoCamera viewspace_ortho_camera;
 private:
   //! Initializes GLEW, an OpenGL context needs to be active
   virtual bool _initializeGL();
+  unsigned int updateFlatTransforms(
+    Object3D& root, TransformHierarchy& hierarchy);
+  void updateObjects(Object3D& root, double dt);
+
+  // Declared after the scenes so that they are destroyed before them
+  TransformHierarchy _scene_transforms;
+  TransformHierarchy _view_space_transforms;
+  TransformHierarchy _background_space_transforms;
+  bool _use_flat_transform_hierarchy;
+  unsigned int _n_updated_transforms;
+  UpdateMode _update_mode;
+
+  // Declared last so that the workers are stopped before anything else
+  // is destroyed
+  JobSystem _job_system;
 };
 
 } }
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "elk/core/component_array.h"
+#include "elk/core/bounding_box.h"
+#include "elk/core/bounding_box_batch.h"
+#include "elk/core/frustum.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace elk { namespace core {
+
+class Object3D;
+class Mesh;
+class Material;
+class RenderableModel;
+class PointLightSource;
+class DirectionalLightSource;
+
+//! Refers to an entity of an EntityRegistry
+/*!
+  The generation is incremented when an entity is destroyed so that a
+  stale Entity can be detected even if its index is reused.
+*/
+struct Entity
+{
+  uint32_t index;
+  uint32_t generation;
+
+  inline bool operator==(const Entity& other) const
+    { return index == other.index && generation == other.generation; };
+  inline bool operator!=(const Entity& other) const
+    { return !(*this == other); };
+};
+
+struct TransformComponent
+{
+  glm::mat4 world;
+};
+
+struct MeshComponent
+{
+  std::shared_ptr<Mesh> mesh;
+  //! Copy of the bounds of the mesh in model space
+  BoundingBox local_bounding_box;
+};
+
+struct MaterialComponent
+{
+  std::shared_ptr<Material> material;
+};
+
+struct PointLightComponent
+{
+  glm::vec3 color;
+  float radiant_flux;
+};
+
+struct DirectionalLightComponent
+{
+  glm::vec3 color;
+  float radiance;
+};
+
+//! Entities whose transform follows an Object3D of a scene
+struct SceneNodeComponent
+{
+  Object3D* node;
+};
+
+//! Data oriented alternative to scene objects that need no custom behavior.
+/*!
+  An entity is an index, its data is stored in one ComponentArray per
+  component type. Every entity has a TransformComponent. An entity with a
+  MeshComponent and a MaterialComponent is rendered like a RenderableModel,
+  entities with a PointLightComponent or DirectionalLightComponent like
+  PointLightSource and DirectionalLightSource.
+
+  The systems below iterate over the dense arrays instead of walking the
+  scene graph and calling virtual functions on each object. An entity can
+  be attached to an Object3D to be positioned by the scene graph, its world
+  transform is then copied from the node in updateTransforms().
+  ElkEngine updates its registry after the transforms of the scenes, and a
+  Renderer given the registry with Renderer::setEntityRegistry() culls and
+  renders the entities together with the scene. Materials only have
+  G-buffer programs, so like RenderableModel the entities are drawn by
+  DeferredShadingRenderer and not by SimpleForward3DRenderer.
+
+  Components may not be added or removed while Renderer::render() runs.
+  Adding or removing components reorders the dense arrays, removing moves
+  the last component into the gap. Culling between such a change and the
+  next updateTransforms() would apply bounds to the wrong components, so
+  cull() treats everything as visible until then.
+*/
+class EntityRegistry {
+public:
+  EntityRegistry();
+  ~EntityRegistry();
+
+  //! Creates an entity with an identity transform
+  Entity create();
+  //! Creates an entity with the data and absolute transform of \param model
+  /*!
+    The entity does not refer to the object, which can be removed from the
+    scene and destroyed to move it to the registry.
+  */
+  Entity create(const RenderableModel& model);
+  Entity create(const PointLightSource& light_source);
+  Entity create(const DirectionalLightSource& light_source);
+  //! Removes all components of \param entity, does nothing if it is stale
+  void destroy(Entity entity);
+  bool isAlive(Entity entity) const;
+  //! Number of alive entities
+  inline size_t size() const { return _transforms.size(); };
+  //! Incremented whenever a mesh or point light component is added,
+  //! replaced or removed
+  inline uint64_t structureVersion() const { return _structure_version; };
+  //! Destroys all entities
+  void clear();
+
+  // Components. Setters replace the previous component and, like destroy(),
+  // do nothing if \param entity is stale
+  void setTransform(Entity entity, const glm::mat4& world);
+  //! The bounds of \param mesh are copied, set the mesh again if they change
+  void setMesh(Entity entity, std::shared_ptr<Mesh> mesh);
+  void setMaterial(Entity entity, std::shared_ptr<Material> material);
+  void setPointLight(Entity entity, const glm::vec3& color, float radiant_flux);
+  void setDirectionalLight(
+    Entity entity, const glm::vec3& color, float radiance);
+  //! The world transform of \param entity follows \param node
+  /*!
+    \param node must outlive the attachment, call detachFromNode() or
+    destroy() before destroying it.
+  */
+  void attachToNode(Entity entity, Object3D& node);
+  void detachFromNode(Entity entity);
+
+  inline const ComponentArray<TransformComponent>& transforms() const
+    { return _transforms; };
+  inline const ComponentArray<MeshComponent>& meshes() const
+    { return _meshes; };
+  inline const ComponentArray<MaterialComponent>& materials() const
+    { return _materials; };
+  inline const ComponentArray<PointLightComponent>& pointLights() const
+    { return _point_lights; };
+  inline const ComponentArray<DirectionalLightComponent>& directionalLights()
+    const { return _directional_lights; };
+
+  // Systems
+
+  //! Copies the absolute transforms of the attached nodes and recomputes
+  //! the world bounds of meshes and point lights
+  void updateTransforms();
+  //! Sets \param visible_meshes[i] to 1 if meshes()[i] intersects
+  //! \param frustum and \param visible_point_lights[i] for pointLights()[i]
+  /*!
+    Uses the world bounds of the last updateTransforms(), the tests run on
+    BoundingBoxBatch. If the structure changed since then, the bounds no
+    longer match the components and all of them are set visible.
+  */
+  void cull(
+    const Frustum& frustum,
+    std::vector<unsigned char>& visible_meshes,
+    std::vector<unsigned char>& visible_point_lights) const;
+  //! World transform of the entity owning component \param i of
+  //! \param components
+  template <typename T>
+  inline const glm::mat4& worldTransform(
+    const ComponentArray<T>& components, size_t i) const
+    { return _transforms.find(components.entity(i))->world; };
+private:
+  std::vector<uint32_t> _generations;
+  std::vector<uint32_t> _free_indices;
+
+  ComponentArray<TransformComponent> _transforms;
+  ComponentArray<MeshComponent> _meshes;
+  ComponentArray<MaterialComponent> _materials;
+  ComponentArray<PointLightComponent> _point_lights;
+  ComponentArray<DirectionalLightComponent> _directional_lights;
+  ComponentArray<SceneNodeComponent> _scene_nodes;
+
+  uint64_t _structure_version;
+  // In the order of _meshes and _point_lights, recomputed every update
+  BoundingBoxBatch _mesh_world_bounding_boxes;
+  BoundingBoxBatch _point_light_world_bounding_boxes;
+  // Structure version the bounds were computed for
+  uint64_t _bounds_structure_version;
+};
+
+} }
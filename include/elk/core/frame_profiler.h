@@ -0,0 +1,126 @@
+#pragma once
+
+#include <gl/glew.h>
+
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace elk { namespace core {
+
+//! Measures the CPU and GPU time of named scopes of each frame.
+/*!
+  Scopes are opened and closed between beginFrame() and endFrame() and may
+  nest. Each scope is timed on the CPU. The outermost scopes are also timed
+  on the GPU with GL_TIME_ELAPSED queries, which can not nest, so nested
+  scopes only get CPU times.
+  Frames stay pending until all their queries are done. Each beginFrame()
+  reads the pending frames that are done, oldest first, without waiting for
+  the GPU, so frames are read late but not lost when the GPU falls behind.
+  Only if the GPU is more than 16 frames behind are the oldest dropped.
+  Times are averaged over the last frames per scope name. The frames read
+  back last are kept and can be written as a Chrome trace, to be opened in
+  chrome://tracing or Perfetto.
+*/
+class FrameProfiler {
+public:
+  //! Times of a scope in seconds, averaged over the last frames
+  struct ScopeTimes
+  {
+    std::string name;
+    float cpu_time;
+    //! Zero for nested scopes
+    float gpu_time;
+  };
+
+  FrameProfiler();
+  ~FrameProfiler();
+
+  //! Reads the results of the pending frames that are done and starts
+  //! recording a new one. Returns true if results were read, gpuFrameTimes()
+  //! then holds the time of each of those frames
+  bool beginFrame();
+  void endFrame();
+  //! Opens a scope in the current frame. Does nothing outside of a frame
+  void beginScope(const std::string& name);
+  //! Closes the last opened scope
+  void endScope();
+
+  //! Average times per scope name, in the order the scopes were first seen
+  std::vector<ScopeTimes> averageTimes() const;
+  //! GPU time of the outermost scopes of the last frame read back, in
+  //! seconds
+  inline float gpuFrameTime() const { return _gpu_frame_time; };
+  //! GPU times of the frames read back by the last beginFrame(), oldest
+  //! first
+  inline const std::vector<float>& gpuFrameTimes() const
+    { return _gpu_frame_times; };
+  //! Writes the frames kept to \param path as Chrome trace events. Prints
+  //! an error and returns false if the file can not be written. Elapsed
+  //! time queries do not tell when a scope ran on the GPU, so GPU scopes
+  //! are laid out one after the other from the start of their frame
+  bool writeChromeTrace(const std::string& path) const;
+private:
+  struct Scope
+  {
+    std::string name;
+    int depth;
+    // Seconds since the profiler was created
+    double cpu_begin;
+    double cpu_end;
+    // Index into the queries of the frame, -1 for nested scopes
+    int query;
+    double gpu_time;
+  };
+  struct Frame
+  {
+    std::vector<Scope> scopes;
+    double cpu_begin;
+    double cpu_end;
+    // Queries are taken from the free ones and returned once read
+    std::vector<GLuint> queries;
+    size_t n_queries;
+  };
+  //! Times of one scope name over the last frames
+  struct Statistics
+  {
+    std::string name;
+    std::vector<float> cpu_times;
+    std::vector<float> gpu_times;
+    // Next sample to replace once the window is full
+    size_t next;
+  };
+
+  double now() const;
+  //! Gets the query results of \param frame if they are all done
+  bool readBack(Frame& frame);
+  void addToStatistics(const Frame& frame);
+  //! Keeps the queries of \param frame for later frames
+  void releaseQueries(Frame& frame);
+
+  // Pending frames kept before the oldest is dropped
+  static const size_t max_pending_frames = 16;
+  // Frames the averages are taken over
+  static const size_t n_averaged_frames = 60;
+  // Frames kept for the trace
+  static const size_t n_traced_frames = 300;
+
+  std::chrono::steady_clock::time_point _start_time;
+  // Frame being recorded
+  Frame _frame;
+  // Recorded frames waiting for their query results, oldest first
+  std::deque<Frame> _pending_frames;
+  std::vector<std::vector<GLuint>> _free_queries;
+  bool _recording;
+  // Open scopes of the current frame, as indices into its scopes
+  std::vector<size_t> _open_scopes;
+  // The scope with the running GPU query, -1 if there is none
+  int _gpu_scope;
+  std::vector<Statistics> _statistics;
+  std::deque<Frame> _traced_frames;
+  float _gpu_frame_time;
+  std::vector<float> _gpu_frame_times;
+};
+
+} }
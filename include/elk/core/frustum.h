@@ -0,0 +1,42 @@
+#pragma once
+
+#include "elk/core/bounding_box.h"
+
+#include <glm/glm.hpp>
+
+namespace elk { namespace core {
+
+class AbstractCamera;
+
+//! The volume visible through a camera, bounded by six planes.
+/*!
+  The planes are extracted from the combined view projection matrix and are
+  given in world space with normals pointing into the frustum.
+*/
+class Frustum {
+public:
+  enum class Intersection { Outside, Intersecting, Inside };
+
+  //! A frustum that contains everything
+  Frustum();
+  Frustum(const glm::mat4& view_projection);
+  Frustum(const AbstractCamera& camera);
+
+  //! False if \param box is completely outside of the frustum
+  /*!
+    Conservative, boxes close to the corners of the frustum may be reported
+    as intersecting even though they are outside.
+  */
+  bool intersects(const BoundingBox& box) const;
+  //! Like intersects() but also tells if \param box is completely inside
+  Intersection classify(const BoundingBox& box) const;
+  //! False if the sphere is completely outside of the frustum
+  bool intersects(const glm::vec3& center, float radius) const;
+  //! Plane \param i, xyz is the normal and w the distance
+  inline const glm::vec4& plane(int i) const { return _planes[i]; };
+private:
+  // Left, right, bottom, top, near, far. xyz is the normal, w the distance
+  glm::vec4 _planes[6];
+};
+
+} }
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <map>
+#include <unordered_set>
+#include <vector>
+
+#include <gl/glew.h>
+
+namespace elk { namespace core {
+
+class Mesh;
+class StreamingBuffer;
+
+//! Layout of the commands read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+  GLuint count;
+  GLuint instance_count;
+  GLuint first_index;
+  GLint  base_vertex;
+  GLuint base_instance;
+};
+
+//! Vertices and elements of many meshes in a few shared buffers.
+/*!
+  Meshes added to the pool are copied into one buffer per vertex attribute
+  (position, normal, texture coordinate and tangent, attributes 0 to 3) and
+  one element buffer, all referenced by a single vertex array. Draws of
+  pooled meshes then need no vertex array or buffer changes in between and
+  can be submitted together with multiDraw().
+  The buffers grow when they are full. Meshes are removed from the pool
+  when they are destroyed, and freed ranges are reused.
+  Only indexed triangle meshes without vertex colors are pooled.
+*/
+class GeometryPool {
+public:
+  //! Capacities in number of vertices and elements
+  GeometryPool(GLuint vertex_capacity = 1 << 18, GLuint index_capacity = 1 << 20);
+  ~GeometryPool();
+
+  //! Copies the vertices and elements of \param mesh into the pool
+  /*!
+    Does nothing if the mesh is already in a pool. Returns false if the mesh
+    can not be pooled. Needs an OpenGL context.
+  */
+  bool add(Mesh& mesh);
+  void remove(Mesh& mesh);
+
+  void bind();
+  void unbind();
+  //! Draws \param n_commands commands starting at \param first_command
+  /*!
+    The commands are read from \param indirect_buffer, which holds a copy of
+    \param commands from byte \param commands_offset on. The model matrix
+    of each instance is read from \param instance_transforms, from byte
+    \param instances_offset on, at the base instance of its command plus
+    the instance index, as attributes 5 to 8. The pool needs to be bound.
+    Without multi draw indirect (OpenGL 4.3 or ARB_multi_draw_indirect
+    and ARB_base_instance) each command is drawn with
+    glDrawElementsInstancedBaseVertex.
+  */
+  void multiDraw(
+    const std::vector<DrawElementsIndirectCommand>& commands,
+    StreamingBuffer& indirect_buffer,
+    GLintptr commands_offset,
+    size_t first_command,
+    GLsizei n_commands,
+    StreamingBuffer& instance_transforms,
+    GLintptr instances_offset);
+
+  inline GLuint vertexCapacity() const { return _vertices.capacity(); };
+  inline GLuint indexCapacity() const { return _indices.capacity(); };
+  static bool multiDrawIndirectSupported();
+private:
+  //! First fit allocation of ranges in [0, capacity)
+  class RangeAllocator {
+  public:
+    RangeAllocator(GLuint capacity);
+    //! Returns false if there is no free range of \param size
+    bool allocate(GLuint size, GLuint& offset);
+    void free(GLuint offset, GLuint size);
+    void grow(GLuint capacity);
+    inline GLuint capacity() const { return _capacity; };
+  private:
+    GLuint _capacity;
+    // Offset to size of the free ranges, neighbours are always merged
+    std::map<GLuint, GLuint> _free_ranges;
+  };
+
+  void allocateVertexBuffers(GLuint capacity);
+  void allocateIndexBuffer(GLuint capacity);
+  void setupVertexArray();
+
+  RangeAllocator _vertices;
+  RangeAllocator _indices;
+
+  GLuint _vertex_array;
+  // Positions, normals, texture coordinates and tangents
+  GLuint _vertex_buffers[4];
+  GLuint _index_buffer;
+
+  std::unordered_set<Mesh*> _meshes;
+};
+
+} }
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <gl/glew.h>
+
+#include <utility>
+#include <vector>
+
+namespace elk { namespace core {
+
+//! Number of state calls made through GLState
+struct GLStateStats
+{
+  //! Calls that changed the state and were passed on to OpenGL
+  unsigned int n_issued;
+  //! Calls that would not have changed the state
+  unsigned int n_skipped;
+};
+
+//! Shadow copy of the OpenGL state that skips calls that would not change it.
+/*!
+  Programs, vertex arrays, buffer bindings, texture units, frame buffers,
+  enabled capabilities, the blend function, the depth mask and function
+  and the viewport are tracked. All code changing this state needs to go
+  through GLState, otherwise the copy is out of date and invalidate() needs
+  to be called.
+  Objects that are deleted must also be deleted through GLState, since
+  OpenGL unbinds them and may reuse their names.
+  The element array buffer binding is part of the vertex array, it is only
+  cached until the next vertex array is bound.
+  Like the OpenGL state itself, GLState must only be used from the thread
+  owning the context.
+*/
+class GLState {
+public:
+  static void useProgram(GLuint program);
+  static void bindVertexArray(GLuint vertex_array);
+  static void bindBuffer(GLenum target, GLuint buffer);
+  //! \param unit is GL_TEXTURE0 + i
+  static void activeTexture(GLenum unit);
+  //! Binds \param texture to the active texture unit
+  static void bindTexture(GLenum target, GLuint texture);
+  //! GL_FRAMEBUFFER binds both the draw and the read frame buffer
+  static void bindFramebuffer(GLenum target, GLuint framebuffer);
+  static void enable(GLenum capability);
+  static void disable(GLenum capability);
+  static void blendFunc(GLenum source_factor, GLenum destination_factor);
+  static void depthMask(GLboolean enabled);
+  static void depthFunc(GLenum function);
+  static void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+  static void deleteProgram(GLuint program);
+  static void deleteVertexArray(GLuint vertex_array);
+  static void deleteBuffer(GLuint buffer);
+  static void deleteTexture(GLuint texture);
+  static void deleteFramebuffer(GLuint framebuffer);
+
+  //! The draw frame buffer, 0 for the default one or if unknown
+  static GLuint framebuffer();
+  //! Forgets all state, the next call of each kind is always issued
+  static void invalidate();
+
+  //! Stores the counts of the frame that ended and restarts counting
+  static void beginFrame();
+  inline static const GLStateStats& lastFrameStats()
+    { return _last_frame_stats; };
+private:
+  // Marks state that is not known, so the next call is issued
+  static const GLuint unknown = 0xffffffff;
+
+  // Index of \param target in _buffers or _bound_textures, -1 if untracked
+  static int bufferSlot(GLenum target);
+  static int textureSlot(GLenum target);
+  //! Counts the call and returns true if \param cached needs to change
+  static bool change(GLuint& cached, GLuint value);
+  static void setCapability(GLenum capability, bool enabled);
+
+  static GLuint _program;
+  static GLuint _vertex_array;
+  static GLuint _buffers[8];
+  static GLuint _active_texture;
+  // Bound textures per unit and target, grown when a unit is first used
+  static std::vector<GLuint> _bound_textures;
+  static GLuint _draw_framebuffer;
+  static GLuint _read_framebuffer;
+  static std::vector<std::pair<GLenum, GLuint>> _capabilities;
+  static GLuint _blend_source;
+  static GLuint _blend_destination;
+  static GLuint _depth_mask;
+  static GLuint _depth_func;
+  static GLint _viewport[4];
+  static bool _viewport_known;
+
+  static GLStateStats _stats;
+  static GLStateStats _last_frame_stats;
+};
+
+} }
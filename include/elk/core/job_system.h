@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace elk { namespace core {
+
+//! A work stealing task scheduler.
+/*!
+  Each worker thread owns a queue of jobs. A worker takes jobs from the back
+  of its own queue and steals from the front of the other queues when its
+  own is empty. Jobs can depend on other jobs, they are not started before
+  all of their dependencies are done.
+  Jobs scheduled with scheduleOnMainThread() are never run by the workers,
+  they are run by the thread that created the JobSystem (the thread with the
+  OpenGL context) in runMainThreadJobs() or while it is waiting for a job.
+  A thread that waits for a job helps executing other jobs meanwhile, so
+  jobs can schedule and wait for other jobs. If there is nothing to help
+  with it backs off to short sleeps.
+  An exception thrown by a task is caught and rethrown by wait() on that
+  job. The job still counts as done. Jobs depending on it fail with the
+  same exception without running their task, so a task only runs when all
+  of its dependencies succeeded.
+*/
+class JobSystem {
+public:
+  struct Job;
+  using JobHandle = std::shared_ptr<Job>;
+
+  //! Starts \param n_workers worker threads
+  JobSystem(unsigned int n_workers = defaultNumberOfWorkers());
+  //! Jobs that have not been started are discarded
+  ~JobSystem();
+
+  //! Schedules \param task to run on a worker thread
+  JobHandle schedule(
+    std::function<void()> task,
+    const std::vector<JobHandle>& dependencies = {});
+  //! Schedules \param task to run on the main thread, for example GL calls
+  JobHandle scheduleOnMainThread(
+    std::function<void()> task,
+    const std::vector<JobHandle>& dependencies = {});
+  //! Blocks until \param job is done, executing other jobs meanwhile.
+  //! Rethrows the exception thrown by the task of \param job, if any
+  void wait(const JobHandle& job);
+  bool isDone(const JobHandle& job) const;
+
+  //! Calls \param body for sub ranges of [begin, end) in parallel
+  /*!
+    The range is split in chunks of at most \param grain_size elements.
+    Returns when all chunks are processed, then rethrows the first
+    exception thrown by \param body, if any.
+  */
+  void parallelFor(
+    size_t begin, size_t end, size_t grain_size,
+    const std::function<void(size_t, size_t)>& body);
+
+  //! Runs the main thread jobs that are ready. Called from the main thread.
+  /*!
+    Rethrows the first exception of a job whose handle nobody holds, for
+    example a fire and forget CreateTexture::loadAsync(), after all ready
+    jobs have run. Failed jobs that can still be waited for are left to
+    wait().
+  */
+  void runMainThreadJobs();
+
+  inline unsigned int numberOfWorkers() const
+    { return static_cast<unsigned int>(_workers.size()); };
+  //! One worker per hardware thread, excluding the main thread
+  static unsigned int defaultNumberOfWorkers();
+private:
+  struct WorkerQueue
+  {
+    std::mutex mutex;
+    std::deque<JobHandle> jobs;
+  };
+
+  JobHandle createJob(
+    std::function<void()> task, bool main_thread,
+    const std::vector<JobHandle>& dependencies);
+  void makeReady(const JobHandle& job);
+  //! Passes the \param exception of a dependency on to \param job
+  static void failDependent(Job& job, std::exception_ptr exception);
+  void execute(const JobHandle& job);
+  //! Executes one ready job, returns false if no job was found
+  bool executeOne();
+  JobHandle popOrSteal(int worker_index);
+  JobHandle popMainThreadJob();
+  void workerLoop(int worker_index);
+  //! Index of the worker of this job system running the current thread, -1
+  //! for other threads
+  int workerIndex() const;
+  bool isMainThread() const;
+
+  std::vector<std::unique_ptr<WorkerQueue>> _queues;
+  std::vector<std::thread> _workers;
+  std::thread::id _main_thread_id;
+
+  std::mutex _main_thread_mutex;
+  std::deque<JobHandle> _main_thread_jobs;
+
+  // Used to put idle workers to sleep
+  std::mutex _sleep_mutex;
+  std::condition_variable _work_available;
+  std::atomic<int> _n_queued_jobs;
+  std::atomic<unsigned int> _next_queue;
+  std::atomic<bool> _stop;
+};
+
+//! Internal state of a scheduled job
+struct JobSystem::Job
+{
+  std::function<void()> task;
+  bool main_thread;
+  std::atomic<int> n_pending_dependencies;
+  std::atomic<bool> done;
+  // Thrown by the task or by a dependency, set before done
+  std::exception_ptr exception;
+
+  // Guards continuations and exception until the job is started
+  std::mutex mutex;
+  // Jobs waiting for this job to finish
+  std::vector<JobHandle> continuations;
+};
+
+} }
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "elk/core/bounding_box_batch.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <gl/glew.h>
+
+#include <glm/glm.hpp>
+
+namespace elk { namespace core {
+
+class PerspectiveCamera;
+struct PointLightInstance;
+
+//! Range of LightClusterGrid::lightIndices() holding the lights of a cluster
+struct LightCluster
+{
+  GLuint offset;
+  GLuint count;
+};
+
+//! Point lights binned into clusters of the view frustum.
+/*!
+  The view frustum is split into a grid of froxels, n_x by n_y tiles of
+  the screen and n_z slices of depth. The slices are spaced exponentially
+  between the near and far clipping planes so that froxels are close to
+  cubic. Each light is tested against the clusters of the slices its
+  sphere overlaps with the SIMD sphere kernel of BoundingBoxBatch.
+  Cluster (x, y, z) has index x + n_x * (y + n_y * z), x and y counted from
+  the lower left corner of the screen.
+*/
+class LightClusterGrid {
+public:
+  LightClusterGrid(GLuint n_x = 16, GLuint n_y = 9, GLuint n_z = 24);
+
+  //! Recomputes the bounds of the clusters if the projection of
+  //! \param camera changed
+  void update(const PerspectiveCamera& camera);
+  //! Bins \param lights, given in the view space of the last update
+  void assign(const std::vector<PointLightInstance>& lights);
+
+  //! Indexed by cluster
+  inline const std::vector<LightCluster>& clusters() const
+    { return _clusters; };
+  //! Indices of the lights passed to assign(), grouped by cluster
+  inline const std::vector<GLuint>& lightIndices() const
+    { return _light_indices; };
+  inline glm::uvec3 dimensions() const { return glm::uvec3(_n_x, _n_y, _n_z); };
+  inline size_t numberOfClusters() const { return _n_x * _n_y * _n_z; };
+  inline float near() const { return _near; };
+  inline float far() const { return _far; };
+  //! Slice holding view space depth \param depth, clamped to the grid
+  int slice(float depth) const;
+private:
+  GLuint _n_x, _n_y, _n_z;
+  float _near, _far;
+  glm::mat4 _projection;
+  // View space bounds of the clusters
+  BoundingBoxBatch _bounds;
+  std::vector<LightCluster> _clusters;
+  std::vector<GLuint> _light_indices;
+  // Cluster and light of every intersection found by assign()
+  std::vector<std::pair<GLuint, GLuint>> _intersections;
+  std::vector<unsigned char> _intersecting;
+};
+
+} }
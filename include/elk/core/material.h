@@ -19,10 +19,24 @@ public:
   ~Material();
 
   void use();
+  //! Uses the program taking the model matrix as instance attribute
+  void useInstanced();
   GLint programId() { return _gbuffer_program->id(); };
-  
+  GLint instancedProgramId() { return _gbuffer_instanced_program->id(); };
+  ShaderProgram& program() { return *_gbuffer_program; };
+  ShaderProgram& instancedProgram() { return *_gbuffer_instanced_program; };
+  //! Unique among all materials, used to sort draw calls
+  inline unsigned int id() const { return _id; };
+  //! Whether the geometry pass writes the compact G-buffer layout, see
+  //! shaders/deferred_shading/g_buffer.glsl
+  static void setCompactGBuffer(bool compact);
+
 private:
   void initialize();
+  void use(ShaderProgram& program);
+
+  unsigned int _id;
+  static unsigned int _n_created_materials;
 
   std::shared_ptr<Texture> _albedo_texture;
   std::shared_ptr<Texture> _roughness_texture;
@@ -31,6 +45,8 @@ private:
   std::shared_ptr<Texture> _normal_texture;
   
   static std::shared_ptr<ShaderProgram> _gbuffer_program;
+  static std::shared_ptr<ShaderProgram> _gbuffer_instanced_program;
+  static bool _compact_g_buffer;
 };
 
 } }
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "elk/core/array_buffer.h"
+#include "elk/core/streaming_buffer.h"
 #include "elk/core/vertex_array.h"
+#include "elk/core/bounding_box.h"
 
 #include <gl/glew.h>
 
@@ -9,10 +11,13 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/transform.hpp>
 
+#include <memory>
 #include <vector>
 
 namespace elk { namespace core {
 
+class GeometryPool;
+
 class Mesh
 {
 public:
@@ -25,15 +30,64 @@ public:
     std::vector<glm::vec4>* colors = nullptr,
     GLenum render_mode = GL_TRIANGLES,
     GLenum render_method = GL_STATIC_DRAW);
-  ~Mesh();
+  virtual ~Mesh();
 
-  virtual void render();
+  //! Same as bind(), draw() and unbind()
+  void render();
+  //! Binds the vertex array so that draw() can be called repeatedly
+  virtual void bind();
+  virtual void draw();
+  //! Draws \param n_instances instances between bind() and unbind()
+  /*!
+    The model matrix of instance i is read from \param instance_transforms,
+    a buffer of glm::mat4, at byte \param offset plus i matrices. The
+    matrix is given to attributes 5 to 8.
+  */
+  void drawInstanced(
+    StreamingBuffer& instance_transforms,
+    GLintptr offset,
+    GLsizei n_instances);
+  //! Draws \param n_instances instances with the instanced attributes that
+  //! were set up by the caller
+  void drawInstanced(GLsizei n_instances);
+  void unbind();
+  //! Points attributes 5 to 8 of the bound vertex array at the model
+  //! matrices of \param instance_transforms from byte \param offset on
+  /*!
+    \param instance_transforms is bound to GL_ARRAY_BUFFER through GLState
+    and stays bound, code using GL_ARRAY_BUFFER binds its own buffer first.
+  */
+  static void enableInstanceTransforms(
+    StreamingBuffer& instance_transforms, GLintptr offset);
+  static void disableInstanceTransforms();
   glm::vec3 computeMinPosition() const;
   glm::vec3 computeMaxPosition() const;
+  //! Bounds of the positions in model space, computed on construction
+  inline const BoundingBox& boundingBox() const { return _bounding_box; };
+  //! Unique among all meshes, used to sort draw calls
+  inline unsigned int id() const { return _id; };
+  //! The pool holding a copy of the mesh, nullptr if not pooled
+  inline GeometryPool* geometryPool() const { return _geometry_pool; };
+  //! Position of the mesh in the buffers of its GeometryPool
+  inline GLint poolBaseVertex() const { return _pool_base_vertex; };
+  inline GLuint poolFirstIndex() const { return _pool_first_index; };
+  inline GLuint numberOfElements() const
+    { return _elements ? static_cast<GLuint>(_elements->size()) : 0; };
 
 protected:
   VertexArray _vao;
+  BoundingBox _bounding_box;
 private:
+  friend class GeometryPool;
+
+  unsigned int _id;
+  static unsigned int _n_created_meshes;
+  GLenum _render_mode;
+
+  GeometryPool* _geometry_pool;
+  GLint _pool_base_vertex;
+  GLuint _pool_first_index;
+
   std::unique_ptr<ElementArrayBuffer> _element_buffer;
 
   // Mesh has ownership of this data!
@@ -50,9 +104,17 @@ class CPUPointCloud : public Mesh
 public:
   CPUPointCloud(std::vector<glm::vec3>* positions);
 
+  //! Streams \param positions to the GPU, without reallocating any buffer
+  //! as long as the number of points does not grow. Without positions
+  //! nothing is drawn until the next update
   void update(std::vector<glm::vec3>& positions);
-  virtual void render();
+  virtual void bind() override;
+  virtual void draw() override;
 private:
+  // Created by the first update, the positions given on construction stay
+  // in the buffer of the vertex array until then
+  std::unique_ptr<StreamingBuffer> _position_stream;
+  GLsizei _n_points;
 };
 
 } }
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace elk { namespace core {
+
+//! Refers to an object in a NodePool.
+/*!
+  The generation is incremented every time a slot is reused, so a handle to
+  a destroyed object can be detected even if the slot holds a new object.
+*/
+struct NodeHandle
+{
+  uint32_t index;
+  uint32_t generation;
+
+  inline bool operator==(const NodeHandle& other) const
+    { return index == other.index && generation == other.generation; };
+  inline bool operator!=(const NodeHandle& other) const
+    { return !(*this == other); };
+};
+
+//! Pooled storage of objects of type \param T referred to by NodeHandles.
+/*!
+  Intended for scene nodes (Object3D and subclasses) that are created and
+  destroyed often. Objects are stored in fixed size chunks so they never
+  move, pointers returned by get() can be used with the normal Object3D
+  interface (addChild(), removeChild() etc.) while the object is alive.
+  create() and destroy() are O(1), destroyed slots are reused. Destroying an
+  Object3D removes it from its parent.
+*/
+template <typename T>
+class NodePool {
+public:
+  NodePool() :
+    _free_list(invalid_index),
+    _size(0)
+  { }
+
+  //! Destroys all objects that are still alive
+  ~NodePool()
+  {
+    clear();
+  }
+
+  NodePool(const NodePool&) = delete;
+  NodePool& operator=(const NodePool&) = delete;
+
+  //! Constructs an object with \param args
+  template <typename... Args>
+  NodeHandle create(Args&&... args)
+  {
+    if (_free_list == invalid_index)
+      addChunk();
+    uint32_t index = _free_list;
+    Slot& s = slot(index);
+    _free_list = s.next_free;
+    new (&s.storage) T(std::forward<Args>(args)...);
+    s.alive = true;
+    _size++;
+    return { index, s.generation };
+  }
+
+  //! Destroys the object, does nothing if \param handle is stale
+  void destroy(NodeHandle handle)
+  {
+    if (!isValid(handle))
+      return;
+    Slot& s = slot(handle.index);
+    object(s)->~T();
+    s.alive = false;
+    s.generation++;
+    s.next_free = _free_list;
+    _free_list = handle.index;
+    _size--;
+  }
+
+  //! nullptr if \param handle is stale
+  inline T* get(NodeHandle handle) const
+  {
+    return isValid(handle) ? object(slot(handle.index)) : nullptr;
+  }
+
+  inline bool isValid(NodeHandle handle) const
+  {
+    if (handle.index >= _chunks.size() * chunk_size)
+      return false;
+    const Slot& s = slot(handle.index);
+    return s.alive && s.generation == handle.generation;
+  }
+
+  //! Destroys all objects, all handles become stale
+  void clear()
+  {
+    for (uint32_t i = 0; i < _chunks.size() * chunk_size; ++i)
+      destroy({ i, slot(i).generation });
+  }
+
+  inline size_t size() const { return _size; };
+private:
+  static const uint32_t chunk_size = 256;
+  static const uint32_t invalid_index = 0xffffffff;
+
+  struct Slot
+  {
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    uint32_t generation;
+    uint32_t next_free;
+    bool alive;
+  };
+  using Chunk = Slot[chunk_size];
+
+  inline Slot& slot(uint32_t index) const
+    { return (*_chunks[index / chunk_size])[index % chunk_size]; };
+  inline static T* object(Slot& s)
+    { return reinterpret_cast<T*>(&s.storage); };
+
+  void addChunk()
+  {
+    uint32_t first = static_cast<uint32_t>(_chunks.size()) * chunk_size;
+    _chunks.push_back(std::unique_ptr<Chunk>(new Chunk[1]));
+    // Linked in order so that slots are used from the start of the chunk
+    for (uint32_t i = 0; i < chunk_size; ++i)
+    {
+      Slot& s = slot(first + i);
+      s.generation = 0;
+      s.alive = false;
+      s.next_free = i + 1 < chunk_size ? first + i + 1 : _free_list;
+    }
+    _free_list = first;
+  }
+
+  std::vector<std::unique_ptr<Chunk>> _chunks;
+  uint32_t _free_list;
+  size_t _size;
+};
+
+} }
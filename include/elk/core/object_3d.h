@@ -1,5 +1,8 @@
 #pragma once
 
+#include "elk/core/bounding_box.h"
+
+#include <atomic>
 #include <vector>
   
 #include <glm/glm.hpp>
@@ -13,42 +16,132 @@ class PointLightSource;
 class DirectionalLightSource;
 class Renderer;
 class PerspectiveCamera;
+class TransformHierarchy;
+class SceneListener;
+class Mesh;
+class Material;
 
 //! An object positioned in 3D space.
 /*!
   This object can not be rendered by itself. It needs a child or _children in
   form of meshes (TriangleMesh or LineMesh).
   All objects inheriting from Object3D can be added as child.
+
+  Thread safety when the engine updates subtrees in parallel
+  (ElkEngine::UpdateMode::Parallel): update() of the top level children of a
+  scene may run concurrently on different threads. Within update() an object
+  may
+    - modify its own state and the state of its descendants, including
+      setTransform(),
+    - call boundsChanged(), e.g. through PointLightSource::setRadiantFlux(),
+      the scene listener is notified from the updating thread,
+    - read absoluteTransform() of any object, absolute transforms are not
+      written during the update phase.
+  It may not
+    - call addChild() or removeChild(),
+    - read or modify the relative transform or state of objects outside its
+      own subtree,
+    - make OpenGL calls.
+  Work that breaks these rules can be deferred with
+  JobSystem::scheduleOnMainThread(), it is then run at the start of the next
+  ElkEngine::update().
 */
 class Object3D {
 public:
-  Object3D() {};
+  Object3D() :
+    _parent(nullptr),
+    _index_in_parent(0),
+    _transform_dirty(true),
+    _child_transform_dirty(false),
+    _scene_listener(nullptr),
+    _transform_hierarchy(nullptr),
+    _transform_index(-1) {};
   //! Destructor
   /*!
     The _children of the Object3D is not destroyed when the Object3D is destroyed.
     The _children needs to be destroyed explicitly.
+    The object is removed from its parent and the children become roots.
   */
-  virtual ~Object3D() {};
+  virtual ~Object3D();
 
   //! Adds a child node
+  /*!
+    An object has at most one parent, \param child is removed from its
+    previous parent first. O(1).
+  */
   void addChild(Object3D& child);
   //! Removes a child from the list of pointers
   /*!
-    The call is recursive so if the parameter \param child is found among
-    _children of _children it is also removed
+    If the parameter \param child is found among _children of _children it
+    is also removed. The last child takes the place of the removed one.
+    O(1) for direct children, O(depth) otherwise.
   */
   void removeChild(Object3D& child);
+  //! Recomputes the absolute transforms of this object and all descendants
   void updateTransform(const glm::mat4& stacked_transform);
+  //! Recomputes the absolute transforms that changed since the last update
+  /*!
+    Only subtrees containing objects whose transform was set (or that were
+    added to a new parent) since the last update are visited.
+    \param stacked_transform is the absolute transform of the parent.
+    \param parent_changed forces an update of this object and its subtree.
+    \return the number of objects whose absolute transform was recomputed.
+  */
+  unsigned int updateDirtyTransforms(
+    const glm::mat4& stacked_transform, bool parent_changed = false);
   virtual void submit(Renderer& renderer);
   virtual void update(double dt);
 
   const glm::mat4& relativeTransform() const;
   const glm::mat4& absoluteTransform() const;
+  //! Sets the relative transform and marks it as changed
   void setTransform(const glm::mat4& transform);
+  inline Object3D* parent() const { return _parent; };
+  //! The children in the order they were added until one is removed
+  /*!
+    Removing or destroying a child moves the last child into its place, so
+    the order of the children, and with it the order in which update() and
+    submit() visit them, is not kept across removals.
+  */
+  inline const std::vector<Object3D*>& children() const { return _children; };
+
+  //! Sets \param listener for this object and all its descendants
+  /*!
+    The previous listener gets objectDetached() and the new one
+    objectAttached() for every object in the subtree. Objects added later
+    inherit the listener of their parent. Pass nullptr to remove it.
+  */
+  void setSceneListener(SceneListener* listener);
+  inline SceneListener* sceneListener() const { return _scene_listener; };
+protected:
+  //! Called by subclasses when the size of the object changes without a
+  //! change of transform
+  void boundsChanged();
 private:
+  friend class TransformHierarchy;
+
+  void markTransformDirty();
+  void detachChild(Object3D& child);
+  void setAbsoluteTransform(const glm::mat4& transform);
+
   std::vector<Object3D*> _children;
+  Object3D* _parent;
+  // Position in the _children of the parent
+  size_t _index_in_parent;
   glm::mat4 _relative_transform;
   glm::mat4 _absolute_transform;
+
+  // The relative transform changed since last update
+  bool _transform_dirty;
+  // Some descendant has _transform_dirty set. Atomic since descendants in
+  // different subtrees may be set concurrently
+  std::atomic<bool> _child_transform_dirty;
+
+  SceneListener* _scene_listener;
+
+  // Set when the transforms are stored in a flat TransformHierarchy
+  TransformHierarchy* _transform_hierarchy;
+  int _transform_index;
 };
 
 // Data needed when rendering
@@ -64,6 +157,18 @@ public:
   ~RenderableDeferred() {};
   virtual void submit(Renderer& renderer) override;
   virtual void render(const UsefulRenderData& render_data) = 0;
+  //! Bounds in model space, infinite if the renderable is never culled
+  virtual BoundingBox localBoundingBox() const
+    { return BoundingBox::infinite(); };
+  BoundingBox worldBoundingBox() const
+    { return localBoundingBox().transformed(absoluteTransform()); };
+  //! The mesh and material if render() only draws a mesh with a material
+  /*!
+    The renderer then draws the mesh itself, sorted together with other
+    draws using the same material and mesh, instead of calling render().
+  */
+  virtual Mesh* renderedMesh() const { return nullptr; };
+  virtual Material* renderedMaterial() const { return nullptr; };
 };
 
 class RenderableForward : public Object3D
@@ -73,6 +178,11 @@ public:
   ~RenderableForward() {};
   virtual void submit(Renderer& renderer) override;
   virtual void render(const UsefulRenderData& render_data) = 0;
+  //! Bounds in model space, infinite if the renderable is never culled
+  virtual BoundingBox localBoundingBox() const
+    { return BoundingBox::infinite(); };
+  BoundingBox worldBoundingBox() const
+    { return localBoundingBox().transformed(absoluteTransform()); };
 };
 
 } }
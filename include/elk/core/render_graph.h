@@ -0,0 +1,205 @@
+#pragma once
+
+#include "elk/core/texture.h"
+#include "elk/core/texture_unit.h"
+#include "elk/core/frame_buffer_object.h"
+#include "elk/core/shader_program.h"
+#include "elk/core/downsampler.h"
+#include "elk/core/frame_profiler.h"
+
+#include <gl/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace elk { namespace core {
+
+//! Passes of a frame declared by the textures they read and write.
+/*!
+  Textures are declared by name with addTexture() and only exist within a
+  frame. Passes are added with addPass() and declare their reads and
+  writes. compile() then
+    - orders the passes so that a texture is only read once all passes
+      writing it have run. Passes writing the same texture run in the order
+      they were added, otherwise the order they were added in is kept where
+      possible,
+    - culls the passes whose writes are not read by a pass that is needed.
+      Passes marked as output(), like drawing to the screen, are always
+      needed,
+    - generates mip maps of a texture once before the first pass reading
+      it with mip maps, and not at all if no pass does. Only the levels
+      sampled by the passes are generated, and only for the rendered part
+      of the texture set by setRenderScale() where the Downsampler is
+      supported,
+    - lets textures with the same description whose lifetimes in the
+      frame do not overlap share one OpenGL texture.
+  execute() runs the compiled passes. Each pass renders to a frame buffer
+  with the textures it writes attached, the textures it reads are bound to
+  texture units while it runs.
+  Pipeline variants are built by clearing the graph and adding the passes
+  again. The textures of the last compile are reused where they match.
+*/
+class RenderGraph {
+public:
+  //! Texture of a resource
+  struct TextureDescription
+  {
+    glm::uvec2 size;
+    Texture::Format format;
+    GLint internal_format;
+    GLenum type;
+    //! Nearest or Linear, mip maps are added if a pass reads them
+    Texture::FilterMode filter;
+  };
+
+  class Pass;
+  //! What a pass gets to see of the graph while it runs
+  class PassContext {
+  public:
+    //! Sets the samplers of the program in use to the textures read by the
+    //! pass, they are bound to texture units already
+    void bindSamplers() const;
+    //! Texture of \param resource this frame, null if the pass does not
+    //! read or write it
+    std::shared_ptr<Texture> texture(const std::string& resource) const;
+    //! Size of the textures written by the pass, zero if it writes none
+    inline glm::uvec2 size() const { return _size; };
+  private:
+    friend class RenderGraph;
+    PassContext(const RenderGraph& graph, const Pass& pass, glm::uvec2 size);
+
+    const RenderGraph& _graph;
+    const Pass& _pass;
+    glm::uvec2 _size;
+    std::vector<TextureUnit> _texture_units;
+    std::vector<GLint> _unit_numbers;
+  };
+
+  using Execute = std::function<void(const PassContext&)>;
+
+  //! Declaration of a pass, returned by addPass()
+  class Pass {
+  public:
+    //! Samples \param resource as \param sampler. \param mip_levels is the
+    //! number of levels the pass samples, the levels after level 0 are
+    //! generated before the pass
+    Pass& read(
+      const std::string& resource,
+      const UniformName& sampler,
+      int mip_levels = 1);
+    //! Renders to \param resource as \param attachment of the frame buffer
+    Pass& write(const std::string& resource, GLenum attachment);
+    //! Marks the pass as having effects outside of the graph, it is never
+    //! culled
+    Pass& output();
+
+    inline const std::string& name() const { return _name; };
+  private:
+    friend class RenderGraph;
+    friend class PassContext;
+    Pass(const std::string& name, Execute execute);
+
+    struct Read
+    {
+      std::string resource;
+      UniformName sampler;
+      int mip_levels;
+      // Resolved by compile()
+      int index;
+    };
+    struct Write
+    {
+      std::string resource;
+      GLenum attachment;
+      int index;
+    };
+
+    std::string _name;
+    Execute _execute;
+    std::vector<Read> _reads;
+    std::vector<Write> _writes;
+    bool _output;
+
+    // Set by compile()
+    std::unique_ptr<FrameBufferObject> _fbo;
+    std::vector<GLenum> _color_attachments;
+    // Resources to generate mip maps of before the pass
+    std::vector<int> _generate_mip_maps;
+  };
+
+  RenderGraph();
+  ~RenderGraph();
+
+  //! Declares the texture \param name. Replaces an earlier declaration
+  void addTexture(const std::string& name, const TextureDescription& description);
+  //! Adds a pass that runs \param execute. The reference is valid until
+  //! clear() is called
+  Pass& addPass(const std::string& name, Execute execute);
+  //! Removes all passes and textures. The OpenGL textures are kept to be
+  //! reused by the next compile()
+  void clear();
+  //! Orders and culls the passes and assigns the textures. Prints an error
+  //! and returns false if a texture is unknown or read without being
+  //! written, or if the passes depend on each other in a cycle
+  bool compile();
+  //! Runs the passes of the last successful compile(). Each pass, with the
+  //! mip maps generated for it, is a scope of \param profiler if given
+  void execute(FrameProfiler* profiler = nullptr);
+  //! Fraction of each texture the passes render to, from the origin. Mip
+  //! maps are only generated for that part where possible
+  inline void setRenderScale(const glm::vec2& scale) { _render_scale = scale; };
+
+  //! Names of the passes in the order they run, culled passes are left out
+  std::vector<std::string> executionOrder() const;
+  //! Number of OpenGL textures the resources share
+  inline size_t numberOfTextures() const { return _textures.size(); };
+private:
+  struct Resource
+  {
+    std::string name;
+    TextureDescription description;
+    // Set by compile(), -1 if no pass that runs uses the resource
+    int texture;
+    // Levels sampled by the passes that run, 1 without mip maps
+    int mip_levels;
+  };
+  //! An OpenGL texture shared by resources whose lifetimes do not overlap
+  struct PhysicalTexture
+  {
+    TextureDescription description;
+    bool mip_maps;
+    std::shared_ptr<Texture> texture;
+  };
+
+  int resourceIndex(const std::string& name) const;
+  //! Assigns the resolved indices to the reads and writes of all passes
+  bool resolveResources();
+  //! Passes needed by the output passes, in the order they can run
+  bool orderPasses(std::vector<Pass*>& order);
+  void assignTextures(const std::vector<Pass*>& order);
+  void createFramebuffers(const std::vector<Pass*>& order);
+  //! Fills the sampled levels of \param resource from level 0
+  void generateMipMaps(const Resource& resource);
+  //! Texture for \param description, taken from \param unused if one there
+  //! matches
+  static std::shared_ptr<Texture> createTexture(
+    const TextureDescription& description, bool mip_maps,
+    std::vector<PhysicalTexture>& unused);
+  static bool isCompatible(
+    const TextureDescription& a, const TextureDescription& b);
+
+  std::vector<Resource> _resources;
+  std::vector<std::unique_ptr<Pass>> _passes;
+  std::vector<PhysicalTexture> _textures;
+  // Compiled order of execution, empty if the last compile failed
+  std::vector<Pass*> _order;
+  glm::vec2 _render_scale;
+  // Created by compile() if mip maps are needed and compute is supported
+  std::unique_ptr<Downsampler> _downsampler;
+};
+
+} }
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "elk/core/object_3d.h"
+#include "elk/core/geometry_pool.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gl/glew.h>
+
+#include <glm/glm.hpp>
+
+namespace elk { namespace core {
+
+class Mesh;
+class Material;
+class PerspectiveCamera;
+class StreamingBuffer;
+
+//! Passes of a frame, packets of earlier passes are sorted first
+enum class RenderPass {
+  Geometry = 0,
+  Forward = 1
+};
+
+//! Number of state changes needed to draw the packets of the last frame
+/*!
+  A state change is a change of program, material or mesh between two
+  consecutive draws. Objects drawing themselves count as one change.
+*/
+struct RenderQueueStats
+{
+  unsigned int n_packets;
+  //! In the order the packets were pushed
+  unsigned int n_state_changes_unsorted;
+  //! In the order they were drawn
+  unsigned int n_state_changes_sorted;
+  //! Draw calls after merging packets into instanced draws
+  unsigned int n_draw_calls;
+  unsigned int n_instanced_draw_calls;
+  //! Draw calls submitted with GeometryPool::multiDraw
+  unsigned int n_multi_draw_calls;
+};
+
+//! Draws of a frame sorted by a packed 64 bit key.
+/*!
+  From the most significant bit the key holds the pass (4 bits), the shader
+  program (12 bits), the material (16 bits), the mesh (16 bits) and the
+  view space depth quantized to 16 bits. Sorting the keys groups draws that
+  use the same state and orders them front to back within each group.
+  Packets of the forward pass may blend, their key holds only the pass
+  and the order they were pushed in, so they keep that order.
+  The keys are sorted with an LSD radix sort that skips the bytes that are
+  equal for all packets.
+  Ids that do not fit in their bits only make the grouping worse, the state
+  is always compared by pointer when drawing.
+  After sorting, consecutive packets with the same mesh and material are
+  merged into one instanced draw using geometry_pass_instanced.vert, with
+  the model matrices uploaded to an instance buffer once per frame.
+  With a GeometryPool set, consecutive packets of pooled meshes with the
+  same material are merged further into one multi draw, with one indirect
+  command per mesh, regardless of which mesh they draw.
+*/
+class RenderQueue {
+public:
+  RenderQueue();
+  ~RenderQueue();
+
+  //! Removes all packets, depths are computed relative to \param camera
+  void begin(const PerspectiveCamera& camera);
+  //! \param mesh drawn with \param material, the geometry pass program
+  void push(
+    RenderPass pass,
+    Mesh& mesh,
+    Material& material,
+    const glm::mat4& transform);
+  //! Renderables that are drawn by calling their render(). They are drawn
+  //! after the mesh packets of the same pass.
+  void push(RenderPass pass, RenderableDeferred& renderable);
+  void push(RenderPass pass, RenderableForward& renderable);
+  //! Sorts the packets pushed since begin() if sorting is enabled and
+  //! merges them into draws
+  void sort();
+  //! Draws the packets of \param pass in sorted order
+  void render(RenderPass pass, const UsefulRenderData& render_data);
+
+  //! Draws in submission order if false, for comparisons. On by default
+  inline void setSorting(bool sorting) { _sorting = sorting; };
+  //! Draws each mesh packet separately if false. On by default
+  inline void setInstancing(bool instancing) { _instancing = instancing; };
+  //! Meshes in \param geometry_pool are drawn with multi draws, nullptr
+  //! to disable. Not owned
+  inline void setGeometryPool(GeometryPool* geometry_pool)
+    { _geometry_pool = geometry_pool; };
+  inline const RenderQueueStats& stats() const { return _stats; };
+private:
+  struct Packet
+  {
+    RenderPass pass;
+    // Draws of a mesh
+    Mesh* mesh;
+    Material* material;
+    GLuint program;
+    const glm::mat4* transform;
+    // Objects drawing themselves
+    Object3D* object;
+    void (*render_object)(Object3D& object, const UsefulRenderData& data);
+  };
+
+  struct SortItem
+  {
+    uint64_t key;
+    uint32_t index;
+  };
+
+  // Packets [begin, begin + n_instances) of _order, drawn instanced if
+  // n_instances > 1 with transforms from first_instance on. Multi draws of
+  // the geometry pool have n_commands > 0
+  struct Draw
+  {
+    uint32_t begin;
+    uint32_t n_instances;
+    uint32_t first_instance;
+    uint32_t first_command;
+    uint32_t n_commands;
+  };
+
+  void push(const Packet& packet, const glm::vec3& position);
+  uint64_t depthBits(const glm::vec3& position) const;
+  unsigned int countStateChanges() const;
+  //! Fills _draws and _instance_transforms from the sorted packets
+  void mergeDraws();
+  //! Merges the packets of _order from \param begin that can be drawn in
+  //! one multi draw, returns the end of the merged packets
+  uint32_t mergeMultiDraw(uint32_t begin);
+  void uploadInstanceTransforms();
+  void uploadCommands();
+  static void radixSort(
+    std::vector<SortItem>& items, std::vector<SortItem>& buffer);
+
+  bool _sorting;
+  bool _instancing;
+  RenderQueueStats _stats;
+
+  glm::mat4 _view_transform;
+  float _near, _far;
+
+  std::vector<Packet> _packets;
+  // Drawing order, sorted by key
+  std::vector<SortItem> _order;
+  std::vector<SortItem> _sort_buffer;
+  std::vector<Draw> _draws;
+
+  std::vector<glm::mat4> _instance_transforms;
+  bool _instance_transforms_uploaded;
+  // Created on first use, needs an OpenGL context
+  std::unique_ptr<StreamingBuffer> _instance_buffer;
+  // Where the transforms of this frame were written in _instance_buffer
+  GLintptr _instance_offset;
+
+  GeometryPool* _geometry_pool;
+  std::vector<DrawElementsIndirectCommand> _commands;
+  bool _commands_uploaded;
+  std::unique_ptr<StreamingBuffer> _indirect_buffer;
+  GLintptr _commands_offset;
+};
+
+} }
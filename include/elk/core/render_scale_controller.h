@@ -0,0 +1,44 @@
+#pragma once
+
+namespace elk { namespace core {
+
+//! Picks the fraction of the output resolution to render at so that frames
+//! stay within a time budget.
+/*!
+  Frame times are smoothed over a few frames. The cost of a frame is
+  assumed to grow with the number of pixels, so the scale is corrected by
+  the square root of the ratio of the budget to the smoothed frame time.
+  Small deviations are ignored and the scale only changes by a limited step
+  per frame, so that it does not oscillate.
+*/
+class RenderScaleController {
+public:
+  //! \param target_frame_time is the budget in seconds
+  RenderScaleController(
+    float target_frame_time = 1.0f / 60.0f,
+    float min_scale = 0.5f,
+    float max_scale = 1.0f);
+
+  //! Takes the time of a frame in seconds and returns the scale of the next
+  //! frame. Times that are not positive are ignored
+  float update(float frame_time);
+  //! Starts over at the maximum scale
+  void reset();
+
+  void setTargetFrameTime(float target_frame_time);
+  void setScaleRange(float min_scale, float max_scale);
+
+  inline float scale() const { return _scale; };
+  inline float targetFrameTime() const { return _target_frame_time; };
+  inline float smoothedFrameTime() const { return _smoothed_frame_time; };
+private:
+  float _target_frame_time;
+  float _min_scale, _max_scale;
+  float _scale;
+  // Exponential moving average, 0 before the first update
+  float _smoothed_frame_time;
+  // Frames to wait after a change until the average reflects it
+  int _settle_frames;
+};
+
+} }
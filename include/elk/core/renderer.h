@@ -3,6 +3,19 @@
 #include "elk/core/object_3d.h"
 #include "elk/core/camera.h"
 #include "elk/core/shader_program.h"
+#include "elk/core/frustum.h"
+#include "elk/core/bounding_volume_hierarchy.h"
+#include "elk/core/scene_listener.h"
+#include "elk/core/entity_registry.h"
+#include "elk/core/render_queue.h"
+#include "elk/core/gl_state.h"
+#include "elk/core/view_uniform_buffer.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace elk { namespace core {
 
@@ -11,25 +24,91 @@ class RenderableForward;
 class PointLightSource;
 class DirectionalLightSource;
 
-class Renderer {
+//! Number of renderables submitted and culled in the last render call
+struct CullingStats
+{
+  unsigned int n_submitted;
+  unsigned int n_culled;
+};
+
+class Renderer : public SceneListener {
 public:
   Renderer(PerspectiveCamera& camera, int window_width, int window_height);
   ~Renderer();
-  
+
   void submitRenderableDeferred(RenderableDeferred& renderable);
   void submitRenderableForward(RenderableForward& renderable);
   void submitPointLightSource(PointLightSource& light_source);
   void submitDirectionalLightSource(DirectionalLightSource& light_source);
 
   void setWindowResolution(int width, int height);
-  
+  //! Renderables outside of the camera frustum are not rendered. On by default
+  void setFrustumCulling(bool enabled);
+  inline const CullingStats& cullingStats() const { return _culling_stats; };
+  //! Sorts the draws to group them by state. On by default
+  void setSortDraws(bool sort);
+  //! Draws copies of the same mesh and material instanced. On by default
+  void setInstancedDraws(bool instanced);
+  //! Copies the meshes drawn into one GeometryPool when they are first
+  //! rendered and draws them with multi draws. Off by default
+  void setGeometryPooling(bool pooling);
+  //! State changes of the last frame with and without sorting
+  inline const RenderQueueStats& renderQueueStats() const
+    { return _render_queue.stats(); };
+  //! State calls of the last frame that were issued and skipped by GLState
+  inline const GLStateStats& glStateStats() const
+    { return GLState::lastFrameStats(); };
+  //! Keeps the objects of the scene registered instead of traversing it
+  /*!
+    The renderer becomes the SceneListener of the scene passed to render().
+    Renderables and light sources register when they are attached to the
+    scene and unregister when they are removed or destroyed. They are kept
+    in a BoundingVolumeHierarchy that is queried with the camera frustum, and
+    only objects that moved since the last frame are refitted. The per frame
+    cost depends on the number of visible and moved objects instead of on
+    the size of the scene.
+    Objects are registered by their type, overrides of Object3D::submit()
+    are not called in this mode. Off by default.
+  */
+  void setRetainedMode(bool retained);
+  //! Renderables and light sources whose bounds intersect \param box.
+  //! Only available in retained mode.
+  std::vector<Object3D*> objectsIntersecting(const BoundingBox& box) const;
+  //! The closest renderable whose bounds are hit by the ray, or nullptr.
+  //! Only available in retained mode.
+  Object3D* pick(const glm::vec3& origin, const glm::vec3& direction) const;
+  //! Entities of \param registry are rendered together with the scene
+  /*!
+    Renderable entities are counted in the culling stats. The registry is
+    not owned and must outlive the renderer or be unset with nullptr.
+    Entity meshes are drawn in the geometry pass with the G-buffer programs
+    of their material, so only deferred renderers support a registry.
+  */
+  virtual void setEntityRegistry(EntityRegistry* registry);
+
   /**
 	Should render all objects in the lists of renderables and light sources.
 	When rendering is done, all lists need to be empty.
   */
   virtual void render(Object3D& scene) = 0;
+
+  virtual void objectAttached(Object3D& object) override;
+  virtual void objectDetached(Object3D& object) override;
+  virtual void objectMoved(Object3D& object) override;
 protected:
   void checkForErrors();
+  //! Fills the lists of renderables and light sources with the objects in
+  //! \param scene that are visible. Called by render().
+  void submitScene(Object3D& scene);
+  //! Moves the renderables and entity meshes to render into _render_queue
+  //! and sorts it. Called by render() after submitScene().
+  void fillRenderQueue();
+  //! Uploads the camera data of this frame to the ViewUniforms block of all
+  //! programs. Called by render() before drawing.
+  void updateViewUniforms();
+  //! Same with the \param viewport drawn to and its size relative to the
+  //! render targets, for renderers not drawing to the whole window
+  void updateViewUniforms(const glm::vec4& viewport, const glm::vec2& render_scale);
 
   PerspectiveCamera& _camera;
   int _window_width, _window_height;
@@ -38,6 +117,67 @@ protected:
   std::vector<RenderableForward*> _renderables_forward_to_render;
   std::vector<PointLightSource*> _point_light_sources_to_render;
   std::vector<DirectionalLightSource*> _directional_light_sources_to_render;
+  RenderQueue _render_queue;
+  // Created by setGeometryPooling(true)
+  std::unique_ptr<GeometryPool> _geometry_pool;
+  ViewUniformBuffer _view_uniform_buffer;
+  std::chrono::steady_clock::time_point _start_time;
+
+  EntityRegistry* _entity_registry;
+  // Indices in the component arrays of _entity_registry, rebuilt by
+  // submitScene()
+  std::vector<size_t> _entity_meshes_to_render;
+  std::vector<size_t> _entity_point_lights_to_render;
+  std::vector<size_t> _entity_directional_lights_to_render;
+private:
+  enum class SceneObjectType {
+    RenderableDeferred,
+    RenderableForward,
+    PointLightSource,
+    DirectionalLightSource };
+
+  // A registered object of the scene
+  struct SceneObject
+  {
+    Object3D* object;
+    SceneObjectType type;
+    // -1 for objects with infinite bounds, they are always visible
+    int proxy;
+    // Index in _unbounded_scene_objects for objects without proxy
+    size_t unbounded_index;
+    bool moved;
+  };
+
+  //! Updates the frustum from the camera and resets the culling stats
+  void beginSubmission();
+  bool isCulled(const BoundingBox& world_bounding_box);
+  void submitRetainedScene(Object3D& scene);
+  void submitEntities(const EntityRegistry& registry);
+  //! Starts listening to \param scene, stops listening to the previous one
+  void retainScene(Object3D* scene);
+  //! Refits the objects that moved since the last frame
+  void refitMovedSceneObjects();
+  void addToRenderLists(const SceneObject& scene_object);
+  static BoundingBox worldBoundingBox(const SceneObject& scene_object);
+  static bool isRenderable(const SceneObject& scene_object);
+
+  Frustum _frustum;
+  bool _frustum_culling;
+  CullingStats _culling_stats;
+
+  bool _retained_mode;
+  Object3D* _retained_scene;
+  BoundingVolumeHierarchy _bounding_volume_hierarchy;
+  // Pointers to the scene objects are stored as user data in the hierarchy
+  std::unordered_map<Object3D*, std::unique_ptr<SceneObject>> _scene_objects;
+  std::vector<SceneObject*> _unbounded_scene_objects;
+  std::vector<SceneObject*> _moved_scene_objects;
+  // objectMoved() may be called from the threads of a parallel update
+  std::mutex _moved_scene_objects_mutex;
+  unsigned int _n_registered_renderables;
+  std::vector<int> _visible_proxies;
+  std::vector<unsigned char> _visible_entity_meshes;
+  std::vector<unsigned char> _visible_entity_point_lights;
 };
 
 } }
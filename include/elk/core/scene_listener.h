@@ -0,0 +1,28 @@
+#pragma once
+
+namespace elk { namespace core {
+
+class Object3D;
+
+//! Receives changes of a tree of Object3Ds.
+/*!
+  Set on the root with Object3D::setSceneListener(). The listener is passed
+  on to all objects attached below the root, a tree has at most one listener.
+*/
+class SceneListener {
+public:
+  virtual ~SceneListener() {};
+  //! \param object was added to the tree, called for each object of an
+  //! added subtree
+  virtual void objectAttached(Object3D& object) = 0;
+  //! \param object was removed from the tree or is being destroyed
+  virtual void objectDetached(Object3D& object) = 0;
+  //! The absolute transform or the bounds of \param object changed
+  /*!
+    May be called by several threads at once when objects call
+    boundsChanged() from a parallel update, the other calls are not.
+  */
+  virtual void objectMoved(Object3D& object) = 0;
+};
+
+} }
@@ -1,13 +1,67 @@
 #pragma once
 
+#include <cstdio>
 #include <iostream>
 #include <fstream>
 #include <stack>
+#include <string>
+#include <vector>
 
 #include <gl/glew.h>
 
+#include <glm/glm.hpp>
+
 namespace elk { namespace core {
 
+//! Name of a uniform interned to a small integer id.
+/*!
+  Creating a UniformName hashes the string once. Looking up an interned
+  name in a ShaderProgram is then an array access, so names used on hot
+  paths should be created once, for example as static constants.
+*/
+class UniformName {
+public:
+  UniformName(const char* name);
+  UniformName(const std::string& name);
+  inline unsigned int id() const { return _id; };
+  const std::string& str() const;
+private:
+  unsigned int _id;
+};
+
+// Uploads a uniform value to \param location of the program in use
+inline void setUniform(GLint location, int value) { glUniform1i(location, value); }
+inline void setUniform(GLint location, float value) { glUniform1f(location, value); }
+inline void setUniform(GLint location, const glm::ivec2& value)
+  { glUniform2i(location, value.x, value.y); }
+inline void setUniform(GLint location, const glm::ivec3& value)
+  { glUniform3i(location, value.x, value.y, value.z); }
+inline void setUniform(GLint location, const glm::vec2& value)
+  { glUniform2f(location, value.x, value.y); }
+inline void setUniform(GLint location, const glm::vec3& value)
+  { glUniform3f(location, value.x, value.y, value.z); }
+inline void setUniform(GLint location, const glm::vec4& value)
+  { glUniform4f(location, value.x, value.y, value.z, value.w); }
+inline void setUniform(GLint location, const glm::mat3& value)
+  { glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]); }
+inline void setUniform(GLint location, const glm::mat4& value)
+  { glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]); }
+
+//! Resolved location of a uniform of type \param T in one program.
+//! Setting an inactive uniform does nothing, like in OpenGL.
+template <typename T>
+class Uniform {
+public:
+  Uniform() : _location(-1) { };
+  explicit Uniform(GLint location) : _location(location) { };
+  //! The program needs to be in use
+  inline void set(const T& value) const { setUniform(_location, value); };
+  inline GLint location() const { return _location; };
+  inline bool isActive() const { return _location != -1; };
+private:
+  GLint _location;
+};
+
 class ShaderProgram {
 public:
   ShaderProgram(
@@ -17,6 +71,8 @@ public:
     const char* tes_src,
     const char* gs_src,
     const char* fs_src);
+  //! Compute program, needs OpenGL 4.3 or ARB_compute_shader
+  ShaderProgram(std::string name, const char* cs_src);
   ~ShaderProgram();
 
   void pushUsage();
@@ -24,18 +80,80 @@ public:
   void useNone();
 
   inline const GLuint& id() { return _id; };
-  static inline const GLuint& currentProgramId() { return _shader_stack.top(); };
+  static bool computeShadersSupported();
+  //! The program on top of the usage stack
+  static inline ShaderProgram& current() { return *_shader_stack.top(); };
+  static inline const GLuint& currentProgramId() { return current().id(); };
+
+  //! An active uniform, found when the program is linked
+  struct UniformInfo
+  {
+    std::string name;
+    GLenum type;
+    //! Number of elements of arrays, 1 otherwise
+    GLint size;
+    GLint location;
+  };
+  //! All active uniforms, including samplers. Array elements are listed
+  //! by the name of the array
+  inline const std::vector<UniformInfo>& uniforms() const { return _uniforms; };
+  //! -1 if \param name is not an active uniform of the program. Elements of
+  //! arrays are found as "name[i]"
+  inline GLint uniformLocation(const UniformName& name) const
+  {
+    return name.id() < _locations.size() ? _locations[name.id()] : -1;
+  };
+  //! Handle to set \param name without any lookup. Prints an error and
+  //! returns an inactive handle if the uniform is not of type \param T
+  template <typename T>
+  Uniform<T> uniform(const UniformName& name) const
+  {
+    GLint location = uniformLocation(name);
+    if (location != -1 && !hasType(name, uniformType(T())))
+    {
+      fprintf(stderr, "ERROR : Uniform %s of program %s has another type\n",
+        name.str().c_str(), _name.c_str());
+      return Uniform<T>();
+    }
+    return Uniform<T>(location);
+  };
+  //! Sets \param name of this program, which needs to be in use
+  template <typename T>
+  inline void setUniform(const UniformName& name, const T& value) const
+  {
+    core::setUniform(uniformLocation(name), value);
+  };
 private:
   GLuint loadShaderProgram(
     const char* vs_src,
     const char* tcs_src,
     const char* tes_src,
     const char* gs_src,
-    const char* fs_src);
+    const char* fs_src,
+    const char* cs_src);
+  //! Fills _uniforms and _locations from the linked program
+  void reflectUniforms();
+  //! Binds the uniform blocks shared by all programs to their binding points
+  void bindUniformBlocks();
+  //! Whether the uniform can be set as a value of \param type
+  bool hasType(const UniformName& name, GLenum type) const;
+
+  static GLenum uniformType(int) { return GL_INT; };
+  static GLenum uniformType(float) { return GL_FLOAT; };
+  static GLenum uniformType(const glm::ivec2&) { return GL_INT_VEC2; };
+  static GLenum uniformType(const glm::ivec3&) { return GL_INT_VEC3; };
+  static GLenum uniformType(const glm::vec2&) { return GL_FLOAT_VEC2; };
+  static GLenum uniformType(const glm::vec3&) { return GL_FLOAT_VEC3; };
+  static GLenum uniformType(const glm::vec4&) { return GL_FLOAT_VEC4; };
+  static GLenum uniformType(const glm::mat3&) { return GL_FLOAT_MAT3; };
+  static GLenum uniformType(const glm::mat4&) { return GL_FLOAT_MAT4; };
 
   std::string _name;
   GLuint _id;
-  static std::stack<GLuint> _shader_stack;
+  std::vector<UniformInfo> _uniforms;
+  // Locations indexed by UniformName::id(), -1 for inactive names
+  std::vector<GLint> _locations;
+  static std::stack<ShaderProgram*> _shader_stack;
 };
 
 } }
\ No newline at end of file
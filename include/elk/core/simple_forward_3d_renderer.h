@@ -18,6 +18,8 @@ public:
   ~SimpleForward3DRenderer();
 
   virtual void render(Object3D& scene) override;
+  //! Entities need a deferred renderer, \param registry must be nullptr
+  virtual void setEntityRegistry(EntityRegistry* registry) override;
 private:
 };
 
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+
+#include <gl/glew.h>
+
+namespace elk { namespace core {
+
+//! Buffer for data that is rewritten every frame.
+/*!
+  The buffer is split into regions, one per frame in flight. Each frame
+  writes into the next region while the GPU may still read the regions of
+  earlier frames, so writing never stalls on the draws of the last frame and
+  the storage is never reallocated.
+  With OpenGL 4.4 or ARB_buffer_storage the buffer is persistently and
+  coherently mapped, writes are plain copies and a fence per region makes
+  sure a region is only rewritten once the GPU is done with it. Otherwise
+  the buffer has a single region that is orphaned by beginFrame() and
+  written with glBufferSubData.
+  Offsets returned by write() are only valid until the next beginFrame().
+*/
+class StreamingBuffer {
+public:
+  //! \param region_size bytes that can be written per frame without growing
+  StreamingBuffer(GLenum target, GLsizeiptr region_size, int n_regions = 3);
+  ~StreamingBuffer();
+
+  //! Moves to the next region, waiting for the GPU if it is still reading it
+  /*!
+    All commands issued so far are fenced for the region that was written,
+    so draws reading it need to be issued before the next beginFrame().
+  */
+  void beginFrame();
+  //! Copies \param size bytes of \param data into the current region
+  /*!
+    Returns the offset of the data in the buffer, a multiple of
+    \param alignment. If the data does not fit in the region, the buffer is
+    reallocated with larger regions and offsets returned earlier in the
+    frame are no longer valid.
+  */
+  GLintptr write(const void* data, GLsizeiptr size, GLsizeiptr alignment = 4);
+  void bind();
+
+  inline GLuint id() const { return _id; };
+  inline GLenum target() const { return _target; };
+  inline GLsizeiptr regionSize() const { return _region_size; };
+  //! Number of times beginFrame() had to wait for the GPU
+  inline unsigned int nStalls() const { return _n_stalls; };
+  //! Number of times storage was allocated. The buffer name may be reused
+  //! when it grows, objects referring to the buffer, like buffer textures,
+  //! need to attach it again when this changes
+  inline unsigned int nAllocations() const { return _n_allocations; };
+  static bool persistentMappingSupported();
+private:
+  void allocate(GLsizeiptr region_size);
+  void release();
+
+  GLenum _target;
+  GLuint _id;
+  bool _persistent;
+  int _n_regions;
+  GLsizeiptr _region_size;
+  // Current region and write position in it
+  int _region;
+  GLsizeiptr _offset;
+  // Persistent mapping of all regions, nullptr without buffer storage
+  char* _mapping;
+  // Fence of the last frame that wrote each region, 0 if none
+  std::vector<GLsync> _fences;
+  unsigned int _n_stalls;
+  unsigned int _n_allocations;
+};
+
+} }
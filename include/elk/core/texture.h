@@ -54,6 +54,9 @@ public:
   void upload();
   void downloadTexture();
   void generateMipMap();
+  //! Generates levels 1 to \param max_level only, the levels above are not
+  //! sampled
+  void generateMipMap(int max_level);
 
   inline GLuint id() const {return _id;};
   
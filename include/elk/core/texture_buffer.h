@@ -0,0 +1,38 @@
+#pragma once
+
+#include "elk/core/streaming_buffer.h"
+
+#include <gl/glew.h>
+
+namespace elk { namespace core {
+
+//! Buffer texture over a StreamingBuffer, for arrays that shaders read with
+//! texelFetch and that are rewritten every frame.
+/*!
+  The data of a frame starts at the texel returned by update(), shaders
+  need to add it to the indices they fetch. Buffer textures are limited
+  to GL_MAX_TEXTURE_BUFFER_SIZE texels, at least 65536.
+*/
+class TextureBuffer {
+public:
+  //! \param texel_size is the size in bytes of \param internal_format
+  TextureBuffer(
+    GLenum internal_format, GLsizeiptr texel_size, GLsizeiptr region_size);
+  ~TextureBuffer();
+
+  //! Replaces the data of the last frame by \param size bytes of \param data
+  //! and returns the first texel of it
+  GLint update(const void* data, GLsizeiptr size);
+  //! Binds the texture to the active texture unit
+  void bind();
+private:
+  StreamingBuffer _buffer;
+  GLuint _texture;
+  GLenum _internal_format;
+  GLsizeiptr _texel_size;
+  // Allocation of the buffer attached to the texture. The buffer is
+  // attached again when it grows, its name may stay the same
+  unsigned int _attached_allocation;
+};
+
+} }
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace elk { namespace core {
+
+class Object3D;
+
+//! Flat storage of the transforms in a tree of Object3Ds.
+/*!
+  The tree below a root is flattened in depth first order so that a parent
+  always comes before its children. Local and world transforms are stored in
+  contiguous arrays and all world transforms are updated in one linear pass.
+  Nodes that are part of a TransformHierarchy read and write their transforms
+  from it, so Object3D::relativeTransform() and Object3D::absoluteTransform()
+  keep working as before.
+  Structural changes (adding or removing children) invalidates the hierarchy,
+  it then needs to be rebuilt before the next update.
+  Since a subtree is stored contiguously, changed local transforms are
+  propagated by recomputing only the index ranges of the changed subtrees.
+*/
+class TransformHierarchy {
+public:
+  TransformHierarchy();
+  //! Detaches all nodes, their transforms are copied back to the nodes.
+  ~TransformHierarchy();
+
+  //! Flattens the tree below \param root.
+  void build(Object3D& root);
+  //! Detaches all nodes, their transforms are copied back to the nodes.
+  void clear();
+  //! Updates all world transforms in one linear pass
+  /*!
+    Nodes with a SceneListener are reported as moved, here and in
+    updateDirty().
+  */
+  void update();
+  //! Updates the world transforms of the subtrees with changed local transforms
+  /*!
+    \return the number of world transforms that were recomputed.
+  */
+  unsigned int updateDirty();
+
+  inline bool needsRebuild() const { return !_valid; };
+  inline void invalidate() { _valid = false; };
+  inline Object3D* root() const { return _root; };
+  inline size_t size() const { return _nodes.size(); };
+
+  inline const glm::mat4& localTransform(int index) const
+    { return _local_transforms[index]; };
+  inline const glm::mat4& worldTransform(int index) const
+    { return _world_transforms[index]; };
+  void setLocalTransform(int index, const glm::mat4& transform);
+  inline void setWorldTransform(int index, const glm::mat4& transform)
+    { _world_transforms[index] = transform; };
+
+  //! Called by a node that is destroyed while being part of the hierarchy
+  void remove(Object3D& node);
+private:
+  void detach(Object3D& node);
+  void notifyMoved(int index);
+
+  Object3D* _root;
+  bool _valid;
+
+  // Sorted so that parents come before their children
+  std::vector<glm::mat4> _local_transforms;
+  std::vector<glm::mat4> _world_transforms;
+  std::vector<int> _parent_indices;
+  // One past the last index of the subtree of each node
+  std::vector<int> _subtree_ends;
+  std::vector<Object3D*> _nodes;
+
+  // Local transforms may be set from several threads during a parallel
+  // update. Bytes instead of bits so that different indices can be set
+  // concurrently
+  std::vector<int> _dirty_indices;
+  std::vector<unsigned char> _dirty;
+  std::mutex _dirty_indices_mutex;
+};
+
+} }
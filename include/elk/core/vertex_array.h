@@ -1,6 +1,7 @@
 #pragma once
 
 #include "elk/core/array_buffer.h"
+#include "elk/core/gl_state.h"
 
 #include <gl/glew.h>
 
@@ -17,8 +18,8 @@ public:
   void addBuffer(ArrayBuffer::InitData buffer_init_data, GLuint attribute_index,
     GLint n_components, GLenum type = GL_FLOAT, GLboolean normalized = GL_FALSE);
 
-  inline void bind() { glBindVertexArray(_id); };
-  inline void unbind() { glBindVertexArray(0); };
+  inline void bind() { GLState::bindVertexArray(_id); };
+  inline void unbind() { GLState::bindVertexArray(0); };
   ArrayBuffer& getBuffer(int attribute_index) { return *_buffers[attribute_index]; };
   void enableAttribArrays();
   void disableAttribArrays();
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "elk/core/streaming_buffer.h"
+
+#include <gl/glew.h>
+
+#include <glm/glm.hpp>
+
+namespace elk { namespace core {
+
+class AbstractCamera;
+
+//! Camera data shared by all shaders, in std140 layout.
+/*!
+  Shaders include shaders/view_uniforms.glsl, which declares the block as
+
+    layout(std140) uniform ViewUniforms
+    {
+      mat4 V;
+      mat4 P;
+      mat4 V_inv;
+      mat4 P_inv;
+      mat4 VP_prev;
+      vec4 viewport;
+      float time;
+      vec2 render_scale;
+    };
+
+  The members need to stay in the same order as in view_uniforms.glsl.
+*/
+struct ViewUniforms
+{
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::mat4 view_inverse;
+  glm::mat4 projection_inverse;
+  //! View projection matrix of the previous update
+  glm::mat4 previous_view_projection;
+  //! x, y, width and height in pixels
+  glm::vec4 viewport;
+  //! Seconds since the renderer was created
+  float time;
+  float padding;
+  //! Size of the viewport relative to the render targets. Texture
+  //! coordinates derived from clip space are scaled by it
+  glm::vec2 render_scale;
+};
+
+//! Uniform buffer holding the ViewUniforms of one view.
+/*!
+  Updated once per frame instead of uploading the camera matrices to every
+  program. The data is streamed through a StreamingBuffer, so an update
+  does not wait for the frames still reading the previous ones.
+  ShaderProgram binds the "ViewUniforms" block of every program to
+  ViewUniformBuffer::binding when it is linked, since GLSL 4.1 can not
+  declare the binding in the shader.
+*/
+class ViewUniformBuffer {
+public:
+  //! Uniform buffer binding point of the ViewUniforms block
+  static const GLuint binding = 0;
+  static const char* const block_name;
+
+  ViewUniformBuffer();
+
+  //! Uploads the matrices of \param camera. The previous view projection
+  //! matrix is the one of the last update, or the current one at the first
+  void update(
+    const AbstractCamera& camera,
+    const glm::vec4& viewport,
+    float time,
+    const glm::vec2& render_scale = glm::vec2(1.0f));
+  //! Binds the data of the last update to ViewUniformBuffer::binding
+  void bind();
+
+  inline const ViewUniforms& uniforms() const { return _uniforms; };
+private:
+  GLint _offset_alignment;
+  StreamingBuffer _buffer;
+  // Where the last update was written in _buffer
+  GLintptr _offset;
+  ViewUniforms _uniforms;
+  bool _updated;
+};
+
+} }
@@ -6,6 +6,7 @@
 #include "elk/core/frame_buffer_object.h"
 #include "elk/core/render_buffer_object.h"
 #include "elk/core/texture_unit.h"
+#include "elk/core/shader_program.h"
 
 #include <vector>
 #include <memory>
@@ -17,10 +18,13 @@ class FrameBufferQuad
 public:
   // Texture, attachment, name
   using RenderTexture = std::tuple<std::shared_ptr<Texture>, GLenum, std::string>;
-  using RenderTextureInfo = std::tuple<int, std::string>;
+  // Render texture index, sampler name
+  using RenderTextureInfo = std::tuple<int, UniformName>;
   
   enum class UseDepthBuffer { YES, NO };
 
+  //! A render texture with attachment GL_DEPTH_ATTACHMENT is used as depth
+  //! buffer, then \param depth_buffer needs to be NO
   FrameBufferQuad(
     int width, int height, std::vector<RenderTexture> render_textures,
     UseDepthBuffer depth_buffer = UseDepthBuffer::NO);
@@ -35,14 +39,18 @@ public:
   void render();
   void bindFBO();
   inline void unbindFBO() { _fbo.unbind(); };
-  inline int width() { return _width; };
-  inline int height() { return _height; };
+  inline int width() const { return _width; };
+  inline int height() const { return _height; };
+  inline std::shared_ptr<Texture> texture(int index)
+    { return std::get<std::shared_ptr<Texture>>(_render_textures[index]); };
 private:
 
   int _width, _height;
   std::shared_ptr<Mesh> _quad;
   FrameBufferObject _fbo;
   std::vector<RenderTexture> _render_textures;
+  // Sampler names of _render_textures
+  std::vector<UniformName> _sampler_names;
   std::unique_ptr<RenderBufferObject> _depth_buffer;
   std::vector<TextureUnit> _texture_units_in_use;
 
@@ -14,6 +14,14 @@ namespace elk { namespace core {
 
 class Renderer;
 
+//! Per light data of the instanced point light draw, attributes 5 and 6
+struct PointLightInstance
+{
+  //! Position in view space and radius of the light volume
+  glm::vec4 position_and_radius;
+  glm::vec4 color_and_radiant_flux;
+};
+
 class PointLightSource : public Object3D
 {
 public:
@@ -21,18 +29,25 @@ public:
   ~PointLightSource() {};
   virtual void submit(Renderer& renderer) override;
   virtual void update(double dt) override;
-  void render(const UsefulRenderData& render_data);
+  //! Instance data of a point light with \param transform, seen through
+  //! \param view_transform. Point lights are rendered all at once by the
+  //! renderer from their instances.
+  static PointLightInstance instance(
+    const glm::mat4& view_transform,
+    const glm::mat4& transform,
+    const glm::vec3& color,
+    float radiant_flux);
 
   void setRadiantFlux(float radiant_flux);
   void setColor(glm::vec3 color);
+  inline float radiantFlux() const { return _radiant_flux; };
+  inline const glm::vec3& color() const { return _color; };
+  //! Radius of the sphere affected by a light source of \param radiant_flux
+  static float radius(float radiant_flux);
+  //! Bounds of the sphere affected by the light source
+  BoundingBox localBoundingBox() const;
+  BoundingBox worldBoundingBox() const;
 private:
-  void renderQuad(const UsefulRenderData& render_data);
-  void renderSphere(const UsefulRenderData& render_data);
-  void setupLightSourceUniforms(const UsefulRenderData& render_data);
-
-  std::shared_ptr<Mesh> _quad_mesh;
-  std::shared_ptr<Mesh> _sphere_mesh;
-
   float _sphere_scale;
 
   glm::vec3 _color;
@@ -47,11 +62,25 @@ public:
   virtual void submit(Renderer& renderer) override;
   virtual void update(double dt) override;
   void render(const UsefulRenderData& render_data);
+  //! Renders a directional light that is not an object of a scene. The
+  //! directional light shading program needs to be in use.
+  static void render(
+    const UsefulRenderData& render_data,
+    const glm::mat4& transform,
+    const glm::vec3& color,
+    float radiance,
+    Mesh& quad_mesh);
 
   void setRadiance(float radiance);
   void setColor(glm::vec3 color);
+  inline float radiance() const { return _radiance; };
+  inline const glm::vec3& color() const { return _color; };
 private:
-  void setupLightSourceUniforms(const UsefulRenderData& render_data);
+  static void setupLightSourceUniforms(
+    const UsefulRenderData& render_data,
+    const glm::mat4& transform,
+    const glm::vec3& color,
+    float radiance);
 
   std::shared_ptr<Mesh> _quad_mesh;
   
@@ -12,6 +12,7 @@ public:
   RenderableGrid();
   ~RenderableGrid(){};
   virtual void render(const UsefulRenderData& render_data) override;
+  virtual BoundingBox localBoundingBox() const override;
 private:
   std::shared_ptr<ShaderProgram> _program;
   std::shared_ptr<Mesh> _mesh;
@@ -15,6 +15,13 @@ public:
     ~RenderableModel(){};
     virtual void render(const UsefulRenderData& render_data) override;
     virtual void update(double dt) override;
+    virtual BoundingBox localBoundingBox() const override;
+    virtual Mesh* renderedMesh() const override { return _mesh.get(); };
+    virtual Material* renderedMaterial() const override
+      { return _material.get(); };
+    inline const std::shared_ptr<Mesh>& mesh() const { return _mesh; };
+    inline const std::shared_ptr<Material>& material() const
+      { return _material; };
 private:
     std::shared_ptr<Mesh> _mesh;
     std::shared_ptr<Material> _material;
@@ -8,9 +8,7 @@ out vec3 vertex_position_worldspace;
 out vec3 vertex_position_viewspace;
 
 // Uniform data
-// Transform matrices
-uniform mat4 V = mat4(1.0f);
-uniform mat4 P = mat4(1.0f);
+#include "../view_uniforms.glsl"
 
 void main()
 {
@@ -6,10 +6,15 @@ layout(location = 0) out vec4 color;
 // Uniforms
 uniform sampler2D pixel_buffer;
 uniform ivec2 window_size;
+// Part of pixel_buffer that was rendered to, it is stretched over the window
+uniform vec2 render_scale = vec2(1.0f);
 
 void main()
 {
-  vec2 sample_point_texture_space = gl_FragCoord.xy / window_size;
+  // Bilinear upscaling, without filtering in texels outside the rendered part
+  vec2 half_texel = 0.5f / vec2(textureSize(pixel_buffer, 0));
+  vec2 sample_point_texture_space =
+    min(gl_FragCoord.xy / window_size * render_scale, render_scale - half_texel);
  
   // Material properties
   color = vec4(texture(pixel_buffer, sample_point_texture_space).rgb, 1.0f);
@@ -0,0 +1,66 @@
+// Reads the G-buffer written by geometry_pass.frag in either layout.
+// Needs the ViewUniforms block to be declared before.
+//
+// Full layout: albedo_buffer and view space position, normal and material
+// (roughness, dielectric Fresnel term, metalness) in position_buffer,
+// normal_buffer and material_buffer.
+// Compact layout: albedo_buffer, normal_material_buffer holding the
+// octahedral normal, packed roughness and metalness and the Fresnel term,
+// and depth_buffer holding linear depth that positions are reconstructed
+// from.
+// In both the alpha of albedo_buffer is zero where there is no geometry.
+
+#include "g_buffer_encoding.glsl"
+
+uniform bool compact_g_buffer = false;
+
+uniform sampler2D albedo_buffer;
+uniform sampler2D position_buffer;
+uniform sampler2D normal_buffer;
+uniform sampler2D material_buffer;
+uniform sampler2D normal_material_buffer;
+uniform sampler2D depth_buffer;
+
+// View space position on the camera ray through \param texture_coordinate.
+// The frame covers render_scale of the G-buffer textures
+vec3 reconstructPosition(vec2 texture_coordinate, float depth)
+{
+  float z = -depth * G_BUFFER_MAX_DEPTH;
+  vec2 ndc = texture_coordinate / render_scale * 2.0f - 1.0f;
+  return vec3(-z * (ndc + vec2(P[2][0], P[2][1])) / vec2(P[0][0], P[1][1]), z);
+}
+
+vec3 gBufferPosition(ivec2 raster_coord)
+{
+  if (!compact_g_buffer)
+    return texelFetch(position_buffer, raster_coord, 0).xyz;
+  vec2 texture_coordinate =
+    (vec2(raster_coord) + 0.5f) / vec2(textureSize(depth_buffer, 0));
+  return reconstructPosition(
+    texture_coordinate, texelFetch(depth_buffer, raster_coord, 0).r);
+}
+
+vec3 gBufferPosition(vec2 texture_coordinate)
+{
+  if (!compact_g_buffer)
+    return textureLod(position_buffer, texture_coordinate, 0).xyz;
+  return reconstructPosition(
+    texture_coordinate, textureLod(depth_buffer, texture_coordinate, 0).r);
+}
+
+vec3 gBufferNormal(ivec2 raster_coord)
+{
+  if (!compact_g_buffer)
+    return texelFetch(normal_buffer, raster_coord, 0).xyz;
+  return decodeNormal(texelFetch(normal_material_buffer, raster_coord, 0).xy);
+}
+
+// Roughness, dielectric Fresnel term and metalness
+vec3 gBufferMaterial(ivec2 raster_coord)
+{
+  if (!compact_g_buffer)
+    return texelFetch(material_buffer, raster_coord, 0).xyz;
+  vec4 normal_material = texelFetch(normal_material_buffer, raster_coord, 0);
+  vec2 roughness_metalness = unpackRoughnessMetalness(normal_material.z);
+  return vec3(roughness_metalness.x, normal_material.w, roughness_metalness.y);
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+// Encodings of the compact G-buffer layout, shared by geometry_pass.frag
+// and g_buffer.glsl
+
+// Depth is written as view space distance divided by this
+#define G_BUFFER_MAX_DEPTH 1000.0f
+
+vec2 signNotZero(vec2 v)
+{
+  return vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+// Octahedral encoding of a normal, in [0, 1]
+vec2 encodeNormal(vec3 n)
+{
+  n /= abs(n.x) + abs(n.y) + abs(n.z);
+  vec2 e = n.z >= 0.0f ? n.xy : (1.0f - abs(n.yx)) * signNotZero(n.xy);
+  return e * 0.5f + 0.5f;
+}
+
+vec3 decodeNormal(vec2 e)
+{
+  e = e * 2.0f - 1.0f;
+  vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+  if (n.z < 0.0f)
+    n.xy = (1.0f - abs(n.yx)) * signNotZero(n.xy);
+  return normalize(n);
+}
+
+// Roughness and metalness with 8 bits each in one channel of a 16 bit
+// normalized texture
+float packRoughnessMetalness(float roughness, float metalness)
+{
+  float r = round(clamp(roughness, 0.0f, 1.0f) * 255.0f);
+  float m = round(clamp(metalness, 0.0f, 1.0f) * 255.0f);
+  return (r * 256.0f + m) / 65535.0f;
+}
+
+vec2 unpackRoughnessMetalness(float value)
+{
+  float bits = round(value * 65535.0f);
+  return vec2(floor(bits / 256.0f), mod(bits, 256.0f)) / 255.0f;
+}
\ No newline at end of file
@@ -6,9 +6,10 @@ in vec3 vertex_normal_viewspace;
 in vec3 vertex_tangent_viewspace;
 in vec2 fs_texture_coordinate;
 
-// Out data
+// Out data, see g_buffer.glsl for the layouts. The compact layout has no
+// attachments for outputs 2 and 3, they are dropped
 layout(location = 0) out vec4 albedo;
-layout(location = 1) out vec3 position;
+layout(location = 1) out vec4 position_or_normal_material;
 layout(location = 2) out vec3 normal;
 layout(location = 3) out vec3 material; // Roughness, Fresnel Term, metalness
 
@@ -18,6 +19,9 @@ uniform sampler2D roughness_texture;
 uniform sampler2D R0_texture;
 uniform sampler2D metalness_texture;
 uniform sampler2D normal_texture;
+uniform bool compact_g_buffer = false;
+
+#include "g_buffer_encoding.glsl"
 
 // R0 is calculated from IOR as so:
 // R0 = pow((n1 - n2) / (n1 + n2), 2)
@@ -43,7 +47,7 @@ float remapRoughness(float x)
 
 void main()
 {
-  position = vertex_position_viewspace.xyz;
+  vec3 position = vertex_position_viewspace.xyz;
 
   vec3 sampled_normal = texture(normal_texture, fs_texture_coordinate).xyz;
   normal = normalize(vertex_normal_viewspace); 
@@ -71,10 +75,23 @@ void main()
   float remapped_roughness = remapRoughness(roughness);
   float fresnel_term = roughSchlick2(R0, cos_theta, remapped_roughness);
 
-  material = vec3(roughness + 0.01, fresnel_term, metalness);
+  // Clamped like the compact layout packs them, so both layouts shade the
+  // same
+  material = vec3(
+    clamp(roughness + 0.01, 0.0f, 1.0f),
+    fresnel_term,
+    clamp(metalness, 0.0f, 1.0f));
+  if (compact_g_buffer)
+  {
+    position_or_normal_material = vec4(
+      encodeNormal(normal),
+      packRoughnessMetalness(material.x, material.z),
+      fresnel_term);
+  }
+  else
+    position_or_normal_material = vec4(position, 1.0f);
 
   // Write to linear depth buffer
-  float max_dist = 1000.0f;
-  float depth = (-position.z / max_dist);
+  float depth = (-position.z / G_BUFFER_MAX_DEPTH);
   gl_FragDepth = depth;
 }
\ No newline at end of file
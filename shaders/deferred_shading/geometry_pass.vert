@@ -13,10 +13,9 @@ out vec2 fs_texture_coordinate;
 out vec3 vertex_tangent_viewspace;
 
 // Uniform data
-// Transform matrices
+#include "../view_uniforms.glsl"
+
 uniform mat4 M = mat4(1.0f);
-uniform mat4 V = mat4(1.0f);
-uniform mat4 P = mat4(1.0f);
 
 void main()
 {
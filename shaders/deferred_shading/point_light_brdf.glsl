@@ -0,0 +1,57 @@
+// BRDF of the point light shading passes, shared by the light volume,
+// clustered and tiled paths.
+
+#define PI 3.1415
+float gaussian(float x, float sigma, float mu)
+{
+  float a = 1.0f / (sigma * sqrt(2.0f * PI));
+  float x_minus_b = x - mu;
+  return a * exp(-(x_minus_b * x_minus_b) / (2.0f * sigma * sigma));
+}
+
+// Radiance reflected towards the camera from one point light. Positions
+// and vectors are in view space, \param r is the view vector reflected
+// about \param n
+vec3 shadePointLight(
+  vec3 light_position, vec3 light_color, float light_radiant_flux,
+  vec3 position, vec3 n, vec3 v, vec3 r,
+  vec3 albedo, float roughness, float R, float metalness)
+{
+  vec3 light_to_point = position - light_position;
+  float inv_dist_square = 1.0f / dot(light_to_point, light_to_point);
+  vec3 l = normalize(light_to_point);
+
+  // Form factors
+  float cos_theta = max(dot(n, -l), 0.0f);
+  float cos_beta =  max(dot(r, -l), 0.0f);
+
+  // BRDFs
+  float BRDF_diffuse = 1.0;
+  // Roughness = 1 should correspond to a cone angle of 90 degrees
+  // (PI / 2 radians). Input to gaussian 1, 1 should correspond to 90 / 2 degrees
+  // = PI / 4 radians (half cone). x = PI/4 -> 1 : x = PI/4 / (PI/4)
+  // The area under BRDF_specular_times_cos_theta should be the same as the
+  // area under BRDF_diffuse which is PI from -PI/2 to PI/2. The area under
+  // the gaussian is 1 so we need to divide by (PI / 4.0f) and multiply with PI.
+  // In other words multiply woth 4.
+  // (Some erros will occur for higher roughness since the gaussian bleeds
+  // outside of the defined region, negligable for low roughness).
+  float BRDF_specular_times_cos_theta = gaussian(acos(cos_beta) / (PI / 4.0f), roughness, 0.0f) * 4.0f;
+
+  // Irradiance measured in Watts per square meter
+  // [M * L^2 * T^-3] * [Sr^-1] * [L^-2] = [M * Sr^-1 * T^-3]
+  // Rendering equation over whole hemisphere
+  float light_source_radiance = light_radiant_flux * inv_dist_square;
+  float irradiance_diffuse =  light_source_radiance * BRDF_diffuse      * cos_theta * 2 * PI;
+  float irradiance_specular = light_source_radiance * BRDF_specular_times_cos_theta * 2 * PI;
+
+  // Different Frenel depending on if the material is metal or dielectric
+  vec3  R_metal = (albedo + (vec3(1.0f) - albedo) * vec3(R));
+  vec3  R_diffuse = vec3((1.0f - R) * (1.0f - metalness));
+  vec3  R_specular = vec3(R * (1.0f - metalness)) + R_metal * metalness;
+
+  // Filter radiance through colors and material
+  vec3 diffuse_radiance = albedo * R_diffuse  * light_color * irradiance_diffuse;
+  vec3 specular_radiance =         R_specular * light_color * irradiance_specular;
+  return diffuse_radiance + specular_radiance;
+}
\ No newline at end of file
@@ -8,18 +8,18 @@ layout(location = 2) in vec2 texture_coordinate;
 out vec3 vertex_position_viewspace_unprojected;
 
 // Uniform data
-// Transform matrices
+#include "../view_uniforms.glsl"
+
 uniform mat4 M = mat4(1.0f);
-uniform mat4 V = mat4(1.0f);
-uniform mat4 P = mat4(1.0f);
-uniform mat4 P_inv = mat4(1.0f);
+// Light volumes are placed in world space with M, other meshes are full
+// screen quads given in normalized device coordinates
+uniform bool world_space = false;
 
 void main()
 {
-	// Set camera position
-	vec4 vertex_position_viewspace = V * M * vec4(position ,1);
-	vertex_position_viewspace_unprojected = vec3(P_inv * V * M * vec4(position ,1));
-
-	// Position and size of point
-	gl_Position = P * vertex_position_viewspace;
+	if (world_space)
+		gl_Position = P * V * M * vec4(position ,1);
+	else
+		gl_Position = vec4(position, 1);
+	vertex_position_viewspace_unprojected = vec3(P_inv * gl_Position);
 }
\ No newline at end of file
@@ -0,0 +1,88 @@
+#version 410 core
+
+// Out data
+layout(location = 0) out vec4 radiance;
+
+// Uniforms
+// Two texels per light, position in view space and radius, color and
+// radiant flux
+uniform samplerBuffer light_buffer;
+// First light index and number of lights per cluster
+uniform usamplerBuffer cluster_buffer;
+// Indices into light_buffer, grouped by cluster
+uniform usamplerBuffer light_index_buffer;
+// Texels where the data of this frame starts in each buffer
+uniform int light_buffer_offset;
+uniform int cluster_buffer_offset;
+uniform int light_index_buffer_offset;
+
+// Number of tiles in x and y and of depth slices, and depth range of the
+// slices, which are spaced exponentially
+uniform ivec3 cluster_dimensions;
+uniform float cluster_near;
+uniform float cluster_far;
+
+#include "../view_uniforms.glsl"
+
+#include "g_buffer.glsl"
+#include "point_light_brdf.glsl"
+
+int clusterIndex(vec3 position)
+{
+  // Size of the part of the light buffer rendered to
+  vec2 screen_size = viewport.zw;
+  ivec2 tile = ivec2(
+    gl_FragCoord.xy / screen_size * vec2(cluster_dimensions.xy));
+  tile = clamp(tile, ivec2(0), cluster_dimensions.xy - 1);
+  float depth = max(-position.z, cluster_near);
+  int slice = int(floor(
+    log(depth / cluster_near) / log(cluster_far / cluster_near) *
+    float(cluster_dimensions.z)));
+  slice = clamp(slice, 0, cluster_dimensions.z - 1);
+  return tile.x + cluster_dimensions.x * (tile.y + cluster_dimensions.y * slice);
+}
+
+void main()
+{
+  vec3 total_radiance = vec3(0.0f);
+
+  ivec2 raster_coord = ivec2(gl_FragCoord.xy);
+
+  // Material properties
+  vec4 albedo =     texelFetch(albedo_buffer,   raster_coord, 0);
+  if (albedo.a != 0.0)
+  {
+    vec3 position =   gBufferPosition(raster_coord);
+    vec3 normal =     gBufferNormal(raster_coord);
+    vec3 material =   gBufferMaterial(raster_coord);
+
+    // Useful vectors
+    vec3 n = normalize(normal);
+    vec3 v = normalize(position - vec3(0.0f));
+    vec3 r = reflect(v, n);
+
+    uvec2 cluster = texelFetch(
+      cluster_buffer, cluster_buffer_offset + clusterIndex(position)).xy;
+    for (uint i = 0u; i < cluster.y; ++i)
+    {
+      int light = int(texelFetch(
+        light_index_buffer, light_index_buffer_offset + int(cluster.x + i)).x);
+      vec4 position_and_radius =
+        texelFetch(light_buffer, light_buffer_offset + 2 * light);
+      vec4 color_and_radiant_flux =
+        texelFetch(light_buffer, light_buffer_offset + 2 * light + 1);
+      // Same extent as the light volumes drawn without clustering
+      vec3 light_to_point = position - position_and_radius.xyz;
+      if (dot(light_to_point, light_to_point) >
+          position_and_radius.w * position_and_radius.w)
+        continue;
+      total_radiance += shadePointLight(
+        position_and_radius.xyz,
+        color_and_radiant_flux.rgb, color_and_radiant_flux.a,
+        position, n, v, r,
+        albedo.rgb, material.x, material.y, material.z);
+    }
+  }
+  // Add to final radiance
+  radiance = vec4(total_radiance, 1.0f);
+}
\ No newline at end of file
@@ -11,14 +11,11 @@ struct DirectionalLightSource
 layout(location = 0) out vec4 radiance;
 
 // Uniforms
-uniform sampler2D albedo_buffer;    // Albedo
-uniform sampler2D position_buffer;  // Position
-uniform sampler2D normal_buffer;    // Normal
-uniform sampler2D material_buffer;  // Roughness, Dielectric Fresnel term, metalness
-
 uniform DirectionalLightSource light_source;
 
-uniform mat4 P_frag;
+#include "../view_uniforms.glsl"
+
+#include "g_buffer.glsl"
 
 #define PI 3.1415
 float gaussian(float x, float sigma, float mu)
@@ -38,14 +35,15 @@ float castShadowRay(vec3 origin, vec3 direction)
   {
     vec3 position_view_space_prev = position_view_space;
     position_view_space = origin + t * direction;
-    vec4 position_clip_space = P_frag * vec4(position_view_space, 1.0f);
+    vec4 position_clip_space = P * vec4(position_view_space, 1.0f);
     vec3 position_screen_space = position_clip_space.xyz / position_clip_space.w;
-    vec2 position_texture_space = position_screen_space.xy * 0.5f + vec2(0.5f);
-    vec3 position = textureLod(position_buffer, position_texture_space, 0).xyz;
+    vec2 position_texture_space =
+      (position_screen_space.xy * 0.5f + vec2(0.5f)) * render_scale;
+    vec3 position = gBufferPosition(position_texture_space);
     float alpha = textureLod(albedo_buffer, position_texture_space, 0).a;
 
-    if (position_texture_space.x < 0 || position_texture_space.x > 1 ||
-        position_texture_space.y < 0 || position_texture_space.y > 1)
+    if (position_texture_space.x < 0 || position_texture_space.x > render_scale.x ||
+        position_texture_space.y < 0 || position_texture_space.y > render_scale.y)
     {
       return 0.0f;
     }
@@ -67,11 +65,12 @@ void main()
   vec4 albedo = texelFetch(albedo_buffer, raster_coord, 0);
   if (albedo.a != 0.0)
   {
-    vec3 position =   texelFetch(position_buffer, raster_coord, 0).xyz;
-    vec3 normal =     texelFetch(normal_buffer,   raster_coord, 0).xyz;
-    float roughness = texelFetch(material_buffer, raster_coord, 0).x;
-    float R =         texelFetch(material_buffer, raster_coord, 0).y;
-    float metalness = texelFetch(material_buffer, raster_coord, 0).z;
+    vec3 position =   gBufferPosition(raster_coord);
+    vec3 normal =     gBufferNormal(raster_coord);
+    vec3 material =   gBufferMaterial(raster_coord);
+    float roughness = material.x;
+    float R =         material.y;
+    float metalness = material.z;
 
     // Useful vectors
     vec3 n = normalize(normal);
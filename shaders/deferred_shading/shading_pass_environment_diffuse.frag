@@ -4,19 +4,16 @@
 layout(location = 0) out vec4 radiance;
 
 // Uniforms
-uniform sampler2D albedo_buffer; // Albedo
-uniform sampler2D position_buffer; // Position
-uniform sampler2D normal_buffer; // Normal
-uniform sampler2D material_buffer; // Roughness, Dielectric Fresnel term, metalness
-
 uniform samplerCube cube_map;
 uniform int cube_map_size;
-uniform mat3 V_inv;
+#include "../view_uniforms.glsl"
+
+#include "g_buffer.glsl"
 
 vec3 environment(vec3 dir_view_space, float roughness)
 {
   float level = clamp(log2(roughness * cube_map_size), 0, 10);
-  vec3 dir_world_space = V_inv * dir_view_space;
+  vec3 dir_world_space = mat3(V_inv) * dir_view_space;
   vec3 color = textureLod(cube_map, dir_world_space, level).rgb;
   return color;
 }
@@ -30,11 +27,12 @@ void main()
   vec4 albedo =     texelFetch(albedo_buffer,   raster_coord, 0);
   if (albedo.a > 0.5)
   {
-    vec3 position =   texelFetch(position_buffer, raster_coord, 0).xyz;
-    vec3 normal =     texelFetch(normal_buffer,   raster_coord, 0).xyz;
-    float roughness = texelFetch(material_buffer, raster_coord, 0).x;
-    float R =         texelFetch(material_buffer, raster_coord, 0).y;
-    float metalness = texelFetch(material_buffer, raster_coord, 0).z;
+    vec3 position =   gBufferPosition(raster_coord);
+    vec3 normal =     gBufferNormal(raster_coord);
+    vec3 material =   gBufferMaterial(raster_coord);
+    float roughness = material.x;
+    float R =         material.y;
+    float metalness = material.z;
 
     // Useful vectors
     vec3 n = normalize(normal);
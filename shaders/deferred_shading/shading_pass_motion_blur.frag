@@ -7,10 +7,10 @@ in vec3 vertex_position_viewspace_unprojected;
 
 // Uniforms
 uniform sampler2D irradiance_buffer;
-uniform sampler2D position_buffer;
-uniform sampler2D albedo_buffer;
 
-uniform mat4 transform_view_to_prev_screen;
+#include "../view_uniforms.glsl"
+
+#include "g_buffer.glsl"
 
 uniform ivec2 window_size;
 
@@ -44,24 +44,27 @@ void main()
   vec3 prev_irradiance;
   if (!infinite_dist)
   {
-    position = texelFetch(position_buffer, raster_coord, 0).xyz;
+    position = gBufferPosition(raster_coord);
   }
   else
   {
     position = vertex_position_viewspace_unprojected * 10000000000.0f;
   }
-  vec4 prev_screen = transform_view_to_prev_screen * vec4(position, 1.0);
+  vec4 prev_screen = VP_prev * V_inv * vec4(position, 1.0);
   prev_screen = prev_screen * (1.0f / prev_screen.w);
 
-  vec2 prev_texture_space = prev_screen.xy * 0.5f + vec2(0.5f);
+  vec2 prev_texture_space = (prev_screen.xy * 0.5f + vec2(0.5f)) * render_scale;
   vec2 diff_tex_space = prev_texture_space - sample_point_texture_space;
   
   int n_samples = 0;
   float blur_amount = 2.0f;
   for (float t = -1.0f; t < 1.0f; t += 0.2)
   {
-    irradiance += textureLod(
-      irradiance_buffer, sample_point_texture_space + diff_tex_space * t * blur_amount, 0).rgb;
+    // Stay within the part of the buffer rendered this frame
+    vec2 sample_point = clamp(
+      sample_point_texture_space + diff_tex_space * t * blur_amount,
+      vec2(0.0f), render_scale);
+    irradiance += textureLod(irradiance_buffer, sample_point, 0).rgb;
     n_samples++;
   }
   irradiance /= n_samples;
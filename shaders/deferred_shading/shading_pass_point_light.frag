@@ -7,26 +7,18 @@ struct PointLightSource
   float radiant_flux; // Given in Watt [M * L^2 * T^-3]
 };
 
+// In data, per light
+flat in vec3 light_position;
+flat in vec3 light_color;
+flat in float light_radiant_flux;
+
 // Out data
 layout(location = 0) out vec4 radiance;
 
-// Uniforms
-uniform sampler2D albedo_buffer;    // Albedo
-uniform sampler2D position_buffer;  // Position
-uniform sampler2D normal_buffer;    // Normal
-uniform sampler2D material_buffer;  // Roughness, Dielectric Fresnel term, metalness
-
-uniform PointLightSource light_source;
-
-uniform mat4 P_frag;
+#include "../view_uniforms.glsl"
 
-#define PI 3.1415
-float gaussian(float x, float sigma, float mu)
-{
-  float a = 1.0f / (sigma * sqrt(2.0f * PI));
-  float x_minus_b = x - mu;
-  return a * exp(-(x_minus_b * x_minus_b) / (2.0f * sigma * sigma));
-}
+#include "g_buffer.glsl"
+#include "point_light_brdf.glsl"
 
 float castShadowRay(vec3 origin, vec3 direction)
 {
@@ -38,14 +30,15 @@ float castShadowRay(vec3 origin, vec3 direction)
   {
     vec3 position_view_space_prev = position_view_space;
     position_view_space = origin + t * direction;
-    vec4 position_clip_space = P_frag * vec4(position_view_space, 1.0f);
+    vec4 position_clip_space = P * vec4(position_view_space, 1.0f);
     vec3 position_screen_space = position_clip_space.xyz / position_clip_space.w;
-    vec2 position_texture_space = position_screen_space.xy * 0.5f + vec2(0.5f);
-    vec3 position = textureLod(position_buffer, position_texture_space, 0).xyz;
+    vec2 position_texture_space =
+      (position_screen_space.xy * 0.5f + vec2(0.5f)) * render_scale;
+    vec3 position = gBufferPosition(position_texture_space);
     float alpha = textureLod(albedo_buffer, position_texture_space, 0).a;
 
-    if (position_texture_space.x < 0 || position_texture_space.x > 1 ||
-        position_texture_space.y < 0 || position_texture_space.y > 1)
+    if (position_texture_space.x < 0 || position_texture_space.x > render_scale.x ||
+        position_texture_space.y < 0 || position_texture_space.y > render_scale.y)
     {
       return 0.0f;
     }
@@ -62,6 +55,8 @@ float castShadowRay(vec3 origin, vec3 direction)
 
 void main()
 {
+  PointLightSource light_source =
+    PointLightSource(light_position, light_color, light_radiant_flux);
   vec3 total_radiance;
   
   ivec2 raster_coord = ivec2(gl_FragCoord.xy);
@@ -70,59 +65,24 @@ void main()
   vec4 albedo =     texelFetch(albedo_buffer,   raster_coord, 0);
   if (albedo.a != 0.0)
   {
-    vec3 position =   texelFetch(position_buffer, raster_coord, 0).xyz;
-    vec3 normal =     texelFetch(normal_buffer,   raster_coord, 0).xyz;
-    float roughness = texelFetch(material_buffer, raster_coord, 0).x;
-    float R =         texelFetch(material_buffer, raster_coord, 0).y;
-    float metalness = texelFetch(material_buffer, raster_coord, 0).z;
+    vec3 position =   gBufferPosition(raster_coord);
+    vec3 normal =     gBufferNormal(raster_coord);
+    vec3 material =   gBufferMaterial(raster_coord);
+    float roughness = material.x;
+    float R =         material.y;
+    float metalness = material.z;
 
     // Useful vectors
     vec3 n = normalize(normal);
-    vec3 light_to_point = position - light_source.position;
-    float inv_dist_square = 1.0f / pow(length(light_to_point), 2.0f);
-    vec3 l = normalize(light_to_point);
     vec3 v = normalize(position - vec3(0.0f));
     vec3 r = reflect(v, n);
 
-    // Form factors
-    float cos_theta = max(dot(n, -l), 0.0f);
-    float cos_beta =  max(dot(r, -l), 0.0f);
-    float cos_alpha = max(dot(-v, n), 0.0f);
-
-    // BRDFs
-    float BRDF_diffuse = 1.0;
-    // Roughness = 1 should correspond to a cone angle of 90 degrees
-    // (PI / 2 radians). Input to gaussian 1, 1 should correspond to 90 / 2 degrees
-    // = PI / 4 radians (half cone). x = PI/4 -> 1 : x = PI/4 / (PI/4)
-    // The area under BRDF_specular_times_cos_theta should be the same as the
-    // area under BRDF_diffuse which is PI from -PI/2 to PI/2. The area under
-    // the gaussian is 1 so we need to divide by (PI / 4.0f) and multiply with PI.
-    // In other words multiply woth 4.
-    // (Some erros will occur for higher roughness since the gaussian bleeds
-    // outside of the defined region, negligable for low roughness).
-    float BRDF_specular_times_cos_theta = gaussian(acos(cos_beta) / (PI / 4.0f), roughness, 0.0f) * 4.0f;
-
-    // Irradiance measured in Watts per square meter
-    // [M * L^2 * T^-3] * [Sr^-1] * [L^-2] = [M * Sr^-1 * T^-3]
-    // Rendering equation over whole hemisphere
-    float light_source_radiance = light_source.radiant_flux * inv_dist_square;
-    float irradiance_diffuse =  light_source_radiance * BRDF_diffuse      * cos_theta * 2 * PI;
-    float irradiance_specular = light_source_radiance * BRDF_specular_times_cos_theta * 2 * PI;
-
-    float hit = 0;// castShadowRay(position + n * 0.01f, -l);
-
-    // Different Frenel depending on if the material is metal or dielectric
-    vec3  R_metal = (albedo.rgb + (vec3(1.0f) - albedo.rgb) * vec3(R));
-    vec3  R_diffuse = vec3((1.0f - R) * (1.0f - metalness));
-    vec3  R_specular = vec3(R * (1.0f - metalness)) + R_metal * metalness;
-
-    // Filter radiance through colors and material
-    vec3 diffuse_radiance = albedo.rgb * R_diffuse  * light_source.color * irradiance_diffuse * (1 - hit);
-    vec3 specular_radiance =             R_specular * light_source.color * irradiance_specular * (1 - hit);
-
-
+    float hit = 0;// castShadowRay(position + n * 0.01f, -normalize(position - light_source.position));
 
-    total_radiance = diffuse_radiance + specular_radiance;
+    total_radiance = shadePointLight(
+      light_source.position, light_source.color, light_source.radiant_flux,
+      position, n, v, r,
+      albedo.rgb, roughness, R, metalness) * (1 - hit);
   }
   // Add to final radiance
   radiance = vec4(total_radiance, 1.0f);
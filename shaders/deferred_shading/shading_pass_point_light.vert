@@ -0,0 +1,35 @@
+#version 410 core
+
+// In data
+layout(location = 0) in vec3 position;
+// Per light, position in view space and radius of the light volume
+layout(location = 5) in vec4 light_position_and_radius;
+// Per light, color and radiant flux
+layout(location = 6) in vec4 light_color_and_radiant_flux;
+
+// Out data
+flat out vec3 light_position;
+flat out vec3 light_color;
+flat out float light_radiant_flux;
+
+#include "../view_uniforms.glsl"
+
+// Lights are drawn as spheres around their position, or as full screen
+// quads given in normalized device coordinates if the camera is inside
+uniform bool light_volume = false;
+
+void main()
+{
+  light_position = light_position_and_radius.xyz;
+  light_color = light_color_and_radiant_flux.rgb;
+  light_radiant_flux = light_color_and_radiant_flux.a;
+
+  if (light_volume)
+  {
+    vec3 position_view_space =
+      light_position + position * light_position_and_radius.w;
+    gl_Position = P * vec4(position_view_space, 1.0f);
+  }
+  else
+    gl_Position = vec4(position, 1.0f);
+}
\ No newline at end of file
@@ -5,10 +5,12 @@ layout(location = 0) out vec4 color;
 
 in vec3 vertex_position_viewspace_unprojected;
 
+#include "../view_uniforms.glsl"
+
+#include "g_buffer.glsl"
+
 // Uniforms
 uniform sampler2D irradiance_buffer;
-uniform sampler2D position_buffer;
-uniform sampler2D albedo_buffer;
 uniform sampler2D bloom_buffer;
 
 uniform ivec2 window_size;
@@ -96,7 +98,7 @@ void main()
   ivec2 raster_coord = ivec2(gl_FragCoord.xy);
 
   // Material properties
-  vec3 position = texelFetch(position_buffer, raster_coord, 0).xyz;
+  vec3 position = gBufferPosition(raster_coord);
   float alpha = texelFetch(albedo_buffer, raster_coord, 0).a;
   bool infinite_dist = alpha == 0.0f;
   
@@ -4,17 +4,14 @@
 layout(location = 0) out vec4 final_irradiance;
 
 // Uniforms
-uniform sampler2D albedo_buffer; // Albedo
-uniform sampler2D position_buffer; // Position
-uniform sampler2D normal_buffer; // Normal
-uniform sampler2D material_buffer; // Roughness, Dielectric Fresnel term, metalness
 uniform sampler2D irradiance_buffer; // Irradiance
 
-uniform mat4 P_frag;
+#include "../view_uniforms.glsl"
+
+#include "g_buffer.glsl"
 
 uniform samplerCube cube_map;
 uniform int cube_map_size;
-uniform mat3 V_inv;
 
 
 
@@ -126,10 +123,10 @@ float castReflectionRay(vec3 origin, vec3 direction, out vec3 radiance, float ro
   float t = 0.0f;
   //origin += step * direction * rand(vec2(direction.x, direction.y));
   vec3 position_view_space = origin;
-  vec4 position_clip_space = P_frag * vec4(position_view_space, 1.0f);
+  vec4 position_clip_space = P * vec4(position_view_space, 1.0f);
   vec3 position_screen_space = position_clip_space.xyz / position_clip_space.w;
 
-  vec3 scale = vec3(P_frag[0][0], P_frag[1][1], P_frag[2][2] + P_frag[3][2]);
+  vec3 scale = vec3(P[0][0], P[1][1], P[2][2] + P[3][2]);
   vec3 one_over_scale = vec3(1.0f) / scale;
   
 /*
@@ -145,10 +142,10 @@ float castReflectionRay(vec3 origin, vec3 direction, out vec3 radiance, float ro
     float y_prim = position_screen_space.y;
     float z_prim = position_screen_space.z;
 
-    float a = P_frag[0][0];
-    float b = P_frag[1][1];
-    float c = P_frag[2][2];
-    float d = P_frag[3][2];
+    float a = P[0][0];
+    float b = P[1][1];
+    float c = P[2][2];
+    float d = P[3][2];
     
     vec3 minus_z_vec = vec3(-z, -z, -1);
     vec3 one_over_minus_z_vec = vec3(1.0f) / minus_z_vec;
@@ -181,16 +178,17 @@ float castReflectionRay(vec3 origin, vec3 direction, out vec3 radiance, float ro
   
     position_view_space += diff_view_space;
     position_screen_space += diff_screen_space;
-    //vec4 position_clip_space = P_frag * vec4(position_view_space, 1.0f);
+    //vec4 position_clip_space = P * vec4(position_view_space, 1.0f);
     //vec3 position_screen_space = position_clip_space.xyz / position_clip_space.w;
   
     
-    vec2 position_texture_space = position_screen_space.xy * 0.5f + vec2(0.5f);
-    vec3 position = textureLod(position_buffer, position_texture_space, 0).xyz;
+    vec2 position_texture_space =
+      (position_screen_space.xy * 0.5f + vec2(0.5f)) * render_scale;
+    vec3 position = gBufferPosition(position_texture_space);
     float alpha = textureLod(albedo_buffer, position_texture_space, 0).a;
 
-    if (position_texture_space.x < 0 || position_texture_space.x > 1 ||
-        position_texture_space.y < 0 || position_texture_space.y > 1)
+    if (position_texture_space.x < 0 || position_texture_space.x > render_scale.x ||
+        position_texture_space.y < 0 || position_texture_space.y > render_scale.y)
     {
       return 0.0f;
     }
@@ -212,14 +210,15 @@ float castReflectionRay(vec3 origin, vec3 direction, out vec3 radiance, float ro
   {
     vec3 position_view_space_prev = position_view_space;
     position_view_space = origin + t * direction;
-    vec4 position_clip_space = P_frag * vec4(position_view_space, 1.0f);
+    vec4 position_clip_space = P * vec4(position_view_space, 1.0f);
     vec3 position_screen_space = position_clip_space.xyz / position_clip_space.w;
-    vec2 position_texture_space = position_screen_space.xy * 0.5f + vec2(0.5f);
-    vec3 position = textureLod(position_buffer, position_texture_space, 0).xyz;
+    vec2 position_texture_space =
+      (position_screen_space.xy * 0.5f + vec2(0.5f)) * render_scale;
+    vec3 position = gBufferPosition(position_texture_space);
     float alpha = textureLod(albedo_buffer, position_texture_space, 0).a;
 
-    if (position_texture_space.x < 0 || position_texture_space.x > 1 ||
-        position_texture_space.y < 0 || position_texture_space.y > 1)
+    if (position_texture_space.x < 0 || position_texture_space.x > render_scale.x ||
+        position_texture_space.y < 0 || position_texture_space.y > render_scale.y)
     {
       return 0.0f;
     }
@@ -256,14 +255,15 @@ float castReflectionRay2(vec3 origin, vec3 direction, out vec3 radiance, float r
     step *= 1 + 0.2 * (rand(vec2(direction.x, direction.y)) - 0.5);
     vec3 position_view_space_prev = position_view_space;
     position_view_space = origin + t * direction;
-    vec4 position_clip_space = P_frag * vec4(position_view_space, 1.0f);
+    vec4 position_clip_space = P * vec4(position_view_space, 1.0f);
     vec3 position_screen_space = position_clip_space.xyz / position_clip_space.w;
-    position_texture_space = position_screen_space.xy * 0.5f + vec2(0.5f);
-    position = textureLod(position_buffer, position_texture_space, 0).xyz;
+    position_texture_space =
+      (position_screen_space.xy * 0.5f + vec2(0.5f)) * render_scale;
+    position = gBufferPosition(position_texture_space);
     float alpha = textureLod(albedo_buffer, position_texture_space, 0).a;
 
-    if (position_texture_space.x < 0 || position_texture_space.x > 1 ||
-        position_texture_space.y < 0 || position_texture_space.y > 1)
+    if (position_texture_space.x < 0 || position_texture_space.x > render_scale.x ||
+        position_texture_space.y < 0 || position_texture_space.y > render_scale.y)
     {
       return 0.0f;
     }
@@ -302,7 +302,7 @@ float castReflectionRay2(vec3 origin, vec3 direction, out vec3 radiance, float r
 vec3 environment(vec3 dir_view_space, float roughness)
 {
   float level = clamp(log2(roughness * cube_map_size), 0, 10);
-  vec3 dir_world_space = V_inv * dir_view_space;
+  vec3 dir_world_space = mat3(V_inv) * dir_view_space;
   vec3 color = textureLod(cube_map, dir_world_space, level).rgb;
   return color;
 }
@@ -314,15 +314,16 @@ void main()
  
   // Material properties
   vec3 irradiance = texelFetch(irradiance_buffer, raster_coord, 0).rgb;
-  vec3 position =   texelFetch(position_buffer,   raster_coord, 0).xyz;
+  vec3 position =   gBufferPosition(raster_coord);
   vec4 albedo =     texelFetch(albedo_buffer,     raster_coord, 0);
   
   if (albedo.a > 0.5)
   {
-    vec3 normal =     texelFetch(normal_buffer,   raster_coord, 0).xyz;
-    float roughness = texelFetch(material_buffer, raster_coord, 0).x;
-    float R =         texelFetch(material_buffer, raster_coord, 0).y;
-    float metalness = texelFetch(material_buffer, raster_coord, 0).z;
+    vec3 normal =     gBufferNormal(raster_coord);
+    vec3 material =   gBufferMaterial(raster_coord);
+    float roughness = material.x;
+    float R =         material.y;
+    float metalness = material.z;
 
     // Useful vectors
     vec3 n = normalize(normal);
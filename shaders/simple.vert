@@ -11,10 +11,9 @@ out vec4 vertex_position_viewspace;
 out vec2 fs_texture_coordinate;
 
 // Uniform data
-// Transform matrices
+#include "view_uniforms.glsl"
+
 uniform mat4 M = mat4(1.0f);
-uniform mat4 V = mat4(1.0f);
-uniform mat4 P = mat4(1.0f);
 
 void main()
 {
@@ -7,10 +7,9 @@ layout(location = 0) in vec3 position;
 out vec3 position_viewspace_vert;
 
 // Uniform data
-// Transform matrices
+#include "view_uniforms.glsl"
+
 uniform mat4 M = mat4(1.0f);
-uniform mat4 V = mat4(1.0f);
-uniform mat4 P = mat4(1.0f);
 
 void main()
 {
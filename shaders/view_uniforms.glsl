@@ -0,0 +1,13 @@
+// Camera transforms, shared by all programs. Matches struct ViewUniforms
+// in view_uniform_buffer.h, which fills the block.
+layout(std140) uniform ViewUniforms
+{
+  mat4 V;
+  mat4 P;
+  mat4 V_inv;
+  mat4 P_inv;
+  mat4 VP_prev;
+  vec4 viewport;
+  float time;
+  vec2 render_scale;
+};
\ No newline at end of file
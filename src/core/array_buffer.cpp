@@ -11,7 +11,7 @@ ArrayBuffer::ArrayBuffer(InitData init_data) :
 
 ArrayBuffer::~ArrayBuffer()
 {
-  glDeleteBuffers(1, &_id);
+  GLState::deleteBuffer(_id);
 }
 
 void ArrayBuffer::render()
@@ -19,6 +19,12 @@ void ArrayBuffer::render()
   glDrawArrays(_init_data.render_mode, 0, _init_data.n_elements);
 }
 
+void ArrayBuffer::renderInstanced(GLsizei n_instances)
+{
+  glDrawArraysInstanced(
+    _init_data.render_mode, 0, _init_data.n_elements, n_instances);
+}
+
 void ArrayBuffer::update(InitData init_data)
 {
   memcpy(&_init_data, &init_data, sizeof(InitData));
@@ -48,4 +54,11 @@ void ElementArrayBuffer::render()
     static_cast<void*>(0));
 }
 
-} }
+void ElementArrayBuffer::renderInstanced(GLsizei n_instances)
+{
+  glDrawElementsInstanced(
+    _init_data.render_mode, _init_data.n_elements, _init_data.type,
+    static_cast<void*>(0), n_instances);
+}
+
+} }
\ No newline at end of file
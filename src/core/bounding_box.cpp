@@ -1,5 +1,7 @@
 #include "elk/core/bounding_box.h"
 
+#include <limits>
+
 namespace elk { namespace core {
 
 BoundingBox::BoundingBox(glm::vec3 min, glm::vec3 max) :
@@ -14,6 +16,45 @@ BoundingBox::~BoundingBox()
   
 }
 
+BoundingBox BoundingBox::infinite()
+{
+  float inf = std::numeric_limits<float>::infinity();
+  return BoundingBox(glm::vec3(-inf), glm::vec3(inf));
+}
+
+bool BoundingBox::isInfinite() const
+{
+  float inf = std::numeric_limits<float>::infinity();
+  return (_min.x == -inf || _min.y == -inf || _min.z == -inf ||
+          _max.x == inf || _max.y == inf || _max.z == inf);
+}
+
+float BoundingBox::surfaceArea() const
+{
+  glm::vec3 size = _max - _min;
+  return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+bool BoundingBox::contains(const BoundingBox& other) const
+{
+  return (other._min.x >= _min.x &&
+          other._min.y >= _min.y &&
+          other._min.z >= _min.z &&
+          other._max.x <= _max.x &&
+          other._max.y <= _max.y &&
+          other._max.z <= _max.z);
+}
+
+bool BoundingBox::intersects(const BoundingBox& other) const
+{
+  return (other._min.x <= _max.x &&
+          other._min.y <= _max.y &&
+          other._min.z <= _max.z &&
+          other._max.x >= _min.x &&
+          other._max.y >= _min.y &&
+          other._max.z >= _min.z);
+}
+
 bool BoundingBox::intersects(const glm::vec3& point) const
 {
   return (point.x > _min.x &&
@@ -61,4 +102,29 @@ std::pair<bool, float> BoundingBox::intersects(
     return {true, tmin};
 }
 
+BoundingBox BoundingBox::transformed(const glm::mat4& transform) const
+{
+  if (isInfinite())
+    return *this;
+
+  // Arvo's method, each column of the rotation and scale part contributes
+  // with its smallest and largest value
+  glm::vec3 translation(transform[3]);
+  glm::vec3 min = translation;
+  glm::vec3 max = translation;
+  for (int i = 0; i < 3; ++i)
+  {
+    glm::vec3 a = glm::vec3(transform[i]) * _min[i];
+    glm::vec3 b = glm::vec3(transform[i]) * _max[i];
+    min += glm::min(a, b);
+    max += glm::max(a, b);
+  }
+  return BoundingBox(min, max);
+}
+
+BoundingBox BoundingBox::merged(const BoundingBox& other) const
+{
+  return BoundingBox(glm::min(_min, other._min), glm::max(_max, other._max));
+}
+
 } }
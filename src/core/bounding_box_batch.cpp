@@ -0,0 +1,465 @@
+#include "elk/core/bounding_box_batch.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(ELK_USE_AVX2) && defined(__AVX2__)
+  #include <immintrin.h>
+  #define ELK_BOUNDING_BOX_BATCH_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+  #include <emmintrin.h>
+  #define ELK_BOUNDING_BOX_BATCH_SSE
+#endif
+
+namespace elk { namespace core {
+
+namespace {
+  const size_t padding = 8;
+
+  // A plane with pointers to the corner coordinates furthest along its
+  // normal, the choice only depends on the signs of the normal
+  struct PlaneTest
+  {
+    float normal[3];
+    float distance;
+    const float* positive_vertex[3];
+  };
+
+  // Same operand order as _mm_min_ps and _mm_max_ps so that NaNs propagate
+  // the same way in all kernels
+  inline float minimum(float a, float b) { return (b < a) ? b : a; }
+  inline float maximum(float a, float b) { return (a < b) ? b : a; }
+
+  void frustumScalar(
+    const PlaneTest* planes, size_t begin, size_t end, unsigned char* visible)
+  {
+    for (size_t i = begin; i < end; ++i)
+    {
+      unsigned char inside = 1;
+      for (int p = 0; p < 6; ++p)
+      {
+        float d =
+          planes[p].normal[0] * planes[p].positive_vertex[0][i] +
+          planes[p].normal[1] * planes[p].positive_vertex[1][i] +
+          planes[p].normal[2] * planes[p].positive_vertex[2][i];
+        if (d + planes[p].distance < 0)
+          inside = 0;
+      }
+      visible[i] = inside;
+    }
+  }
+
+  // Ray data shared by the kernels. The distances of the boxes in
+  // [begin, end) are written to distances[0, end - begin)
+  struct RayTest
+  {
+    float origin[3];
+    float inverse_direction[3];
+    const float* min[3];
+    const float* max[3];
+  };
+
+  void rayScalar(const RayTest& ray, size_t begin, size_t end, float* distances)
+  {
+    const float infinity = std::numeric_limits<float>::infinity();
+    for (size_t i = begin; i < end; ++i)
+    {
+      float t_near[3], t_far[3];
+      for (int a = 0; a < 3; ++a)
+      {
+        float t1 = (ray.min[a][i] - ray.origin[a]) * ray.inverse_direction[a];
+        float t2 = (ray.max[a][i] - ray.origin[a]) * ray.inverse_direction[a];
+        t_near[a] = minimum(t1, t2);
+        t_far[a] = maximum(t1, t2);
+      }
+      float t_min = maximum(maximum(t_near[0], t_near[1]), t_near[2]);
+      float t_max = minimum(minimum(t_far[0], t_far[1]), t_far[2]);
+      // Ordered comparisons, NaN from rays in the plane of a side is a miss
+      bool hit = t_max >= 0 && t_min <= t_max;
+      distances[i - begin] = hit ? t_min : infinity;
+    }
+  }
+
+  // Sphere data shared by the kernels. The results of the boxes in
+  // [begin, end) are written to intersecting[0, end - begin)
+  struct SphereTest
+  {
+    float center[3];
+    float radius_squared;
+    const float* min[3];
+    const float* max[3];
+  };
+
+  void sphereScalar(
+    const SphereTest& sphere, size_t begin, size_t end,
+    unsigned char* intersecting)
+  {
+    for (size_t i = begin; i < end; ++i)
+    {
+      // Squared distance from the center to the closest point of the box
+      float distance_squared = 0.0f;
+      for (int a = 0; a < 3; ++a)
+      {
+        float d = maximum(maximum(
+          sphere.min[a][i] - sphere.center[a],
+          sphere.center[a] - sphere.max[a][i]), 0.0f);
+        distance_squared += d * d;
+      }
+      intersecting[i - begin] = distance_squared <= sphere.radius_squared;
+    }
+  }
+
+#if defined(ELK_BOUNDING_BOX_BATCH_AVX2)
+  const size_t simd_width = 8;
+
+  void frustumSimd(
+    const PlaneTest* planes, size_t begin, size_t end, unsigned char* visible)
+  {
+    const __m256 zero = _mm256_setzero_ps();
+    for (size_t i = begin; i < end; i += simd_width)
+    {
+      __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+      for (int p = 0; p < 6; ++p)
+      {
+        __m256 d = _mm256_add_ps(
+          _mm256_add_ps(
+            _mm256_mul_ps(_mm256_set1_ps(planes[p].normal[0]),
+              _mm256_loadu_ps(planes[p].positive_vertex[0] + i)),
+            _mm256_mul_ps(_mm256_set1_ps(planes[p].normal[1]),
+              _mm256_loadu_ps(planes[p].positive_vertex[1] + i))),
+          _mm256_mul_ps(_mm256_set1_ps(planes[p].normal[2]),
+            _mm256_loadu_ps(planes[p].positive_vertex[2] + i)));
+        d = _mm256_add_ps(d, _mm256_set1_ps(planes[p].distance));
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, zero, _CMP_NLT_UQ));
+      }
+      int mask = _mm256_movemask_ps(inside);
+      for (size_t j = 0; j < simd_width; ++j)
+        visible[i + j] = (mask >> j) & 1;
+    }
+  }
+
+  void raySimd(const RayTest& ray, size_t begin, size_t end, float* distances)
+  {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 infinity =
+      _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    __m256 origin[3], inverse_direction[3];
+    for (int a = 0; a < 3; ++a)
+    {
+      origin[a] = _mm256_set1_ps(ray.origin[a]);
+      inverse_direction[a] = _mm256_set1_ps(ray.inverse_direction[a]);
+    }
+    for (size_t i = begin; i < end; i += simd_width)
+    {
+      __m256 t_min, t_max;
+      for (int a = 0; a < 3; ++a)
+      {
+        __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(
+          _mm256_loadu_ps(ray.min[a] + i), origin[a]), inverse_direction[a]);
+        __m256 t2 = _mm256_mul_ps(_mm256_sub_ps(
+          _mm256_loadu_ps(ray.max[a] + i), origin[a]), inverse_direction[a]);
+        __m256 t_near = _mm256_min_ps(t2, t1);
+        __m256 t_far = _mm256_max_ps(t2, t1);
+        t_min = a == 0 ? t_near : _mm256_max_ps(t_near, t_min);
+        t_max = a == 0 ? t_far : _mm256_min_ps(t_far, t_max);
+      }
+      __m256 hit = _mm256_and_ps(
+        _mm256_cmp_ps(t_max, zero, _CMP_GE_OQ),
+        _mm256_cmp_ps(t_min, t_max, _CMP_LE_OQ));
+      _mm256_storeu_ps(
+        distances + i - begin, _mm256_blendv_ps(infinity, t_min, hit));
+    }
+  }
+  void sphereSimd(
+    const SphereTest& sphere, size_t begin, size_t end,
+    unsigned char* intersecting)
+  {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 radius_squared = _mm256_set1_ps(sphere.radius_squared);
+    __m256 center[3];
+    for (int a = 0; a < 3; ++a)
+      center[a] = _mm256_set1_ps(sphere.center[a]);
+    for (size_t i = begin; i < end; i += simd_width)
+    {
+      __m256 distance_squared = zero;
+      for (int a = 0; a < 3; ++a)
+      {
+        __m256 d = _mm256_max_ps(_mm256_max_ps(
+          _mm256_sub_ps(_mm256_loadu_ps(sphere.min[a] + i), center[a]),
+          _mm256_sub_ps(center[a], _mm256_loadu_ps(sphere.max[a] + i))),
+          zero);
+        distance_squared =
+          _mm256_add_ps(distance_squared, _mm256_mul_ps(d, d));
+      }
+      int mask = _mm256_movemask_ps(
+        _mm256_cmp_ps(distance_squared, radius_squared, _CMP_LE_OQ));
+      for (size_t j = 0; j < simd_width; ++j)
+        intersecting[i - begin + j] = (mask >> j) & 1;
+    }
+  }
+#elif defined(ELK_BOUNDING_BOX_BATCH_SSE)
+  const size_t simd_width = 4;
+
+  void frustumSimd(
+    const PlaneTest* planes, size_t begin, size_t end, unsigned char* visible)
+  {
+    const __m128 zero = _mm_setzero_ps();
+    for (size_t i = begin; i < end; i += simd_width)
+    {
+      __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+      for (int p = 0; p < 6; ++p)
+      {
+        __m128 d = _mm_add_ps(
+          _mm_add_ps(
+            _mm_mul_ps(_mm_set1_ps(planes[p].normal[0]),
+              _mm_loadu_ps(planes[p].positive_vertex[0] + i)),
+            _mm_mul_ps(_mm_set1_ps(planes[p].normal[1]),
+              _mm_loadu_ps(planes[p].positive_vertex[1] + i))),
+          _mm_mul_ps(_mm_set1_ps(planes[p].normal[2]),
+            _mm_loadu_ps(planes[p].positive_vertex[2] + i)));
+        d = _mm_add_ps(d, _mm_set1_ps(planes[p].distance));
+        inside = _mm_and_ps(inside, _mm_cmpnlt_ps(d, zero));
+      }
+      int mask = _mm_movemask_ps(inside);
+      for (size_t j = 0; j < simd_width; ++j)
+        visible[i + j] = (mask >> j) & 1;
+    }
+  }
+
+  void raySimd(const RayTest& ray, size_t begin, size_t end, float* distances)
+  {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 infinity = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    __m128 origin[3], inverse_direction[3];
+    for (int a = 0; a < 3; ++a)
+    {
+      origin[a] = _mm_set1_ps(ray.origin[a]);
+      inverse_direction[a] = _mm_set1_ps(ray.inverse_direction[a]);
+    }
+    for (size_t i = begin; i < end; i += simd_width)
+    {
+      __m128 t_min, t_max;
+      for (int a = 0; a < 3; ++a)
+      {
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(
+          _mm_loadu_ps(ray.min[a] + i), origin[a]), inverse_direction[a]);
+        __m128 t2 = _mm_mul_ps(_mm_sub_ps(
+          _mm_loadu_ps(ray.max[a] + i), origin[a]), inverse_direction[a]);
+        __m128 t_near = _mm_min_ps(t2, t1);
+        __m128 t_far = _mm_max_ps(t2, t1);
+        t_min = a == 0 ? t_near : _mm_max_ps(t_near, t_min);
+        t_max = a == 0 ? t_far : _mm_min_ps(t_far, t_max);
+      }
+      __m128 hit = _mm_and_ps(
+        _mm_cmpge_ps(t_max, zero), _mm_cmple_ps(t_min, t_max));
+      // No blendv before SSE4.1
+      _mm_storeu_ps(distances + i - begin, _mm_or_ps(
+        _mm_and_ps(hit, t_min), _mm_andnot_ps(hit, infinity)));
+    }
+  }
+  void sphereSimd(
+    const SphereTest& sphere, size_t begin, size_t end,
+    unsigned char* intersecting)
+  {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 radius_squared = _mm_set1_ps(sphere.radius_squared);
+    __m128 center[3];
+    for (int a = 0; a < 3; ++a)
+      center[a] = _mm_set1_ps(sphere.center[a]);
+    for (size_t i = begin; i < end; i += simd_width)
+    {
+      __m128 distance_squared = zero;
+      for (int a = 0; a < 3; ++a)
+      {
+        __m128 d = _mm_max_ps(_mm_max_ps(
+          _mm_sub_ps(_mm_loadu_ps(sphere.min[a] + i), center[a]),
+          _mm_sub_ps(center[a], _mm_loadu_ps(sphere.max[a] + i))),
+          zero);
+        distance_squared = _mm_add_ps(distance_squared, _mm_mul_ps(d, d));
+      }
+      int mask = _mm_movemask_ps(_mm_cmple_ps(distance_squared, radius_squared));
+      for (size_t j = 0; j < simd_width; ++j)
+        intersecting[i - begin + j] = (mask >> j) & 1;
+    }
+  }
+#endif
+}
+
+BoundingBoxBatch::BoundingBoxBatch() :
+  _size(0),
+  _use_simd(true)
+{ }
+
+BoundingBoxBatch::~BoundingBoxBatch()
+{ }
+
+size_t BoundingBoxBatch::add(const BoundingBox& box)
+{
+  size_t index = _size++;
+  if (_size > _min_x.size())
+  {
+    // Padding boxes are points at the origin, their results are ignored
+    size_t padded_size = _min_x.size() + padding;
+    for (auto array : { &_min_x, &_min_y, &_min_z, &_max_x, &_max_y, &_max_z })
+      array->resize(padded_size, 0.0f);
+  }
+  set(index, box);
+  return index;
+}
+
+void BoundingBoxBatch::set(size_t index, const BoundingBox& box)
+{
+  _min_x[index] = box.min().x;
+  _min_y[index] = box.min().y;
+  _min_z[index] = box.min().z;
+  _max_x[index] = box.max().x;
+  _max_y[index] = box.max().y;
+  _max_z[index] = box.max().z;
+}
+
+BoundingBox BoundingBoxBatch::get(size_t index) const
+{
+  return BoundingBox(
+    glm::vec3(_min_x[index], _min_y[index], _min_z[index]),
+    glm::vec3(_max_x[index], _max_y[index], _max_z[index]));
+}
+
+void BoundingBoxBatch::clear()
+{
+  _size = 0;
+  for (auto array : { &_min_x, &_min_y, &_min_z, &_max_x, &_max_y, &_max_z })
+    array->clear();
+}
+
+void BoundingBoxBatch::intersects(
+  const Frustum& frustum, std::vector<unsigned char>& visible) const
+{
+  PlaneTest planes[6];
+  const float* min[3] = { _min_x.data(), _min_y.data(), _min_z.data() };
+  const float* max[3] = { _max_x.data(), _max_y.data(), _max_z.data() };
+  for (int p = 0; p < 6; ++p)
+  {
+    const glm::vec4& plane = frustum.plane(p);
+    for (int a = 0; a < 3; ++a)
+    {
+      planes[p].normal[a] = plane[a];
+      planes[p].positive_vertex[a] = plane[a] > 0 ? max[a] : min[a];
+    }
+    planes[p].distance = plane.w;
+  }
+
+  // Written with padding, then shrunk to the number of boxes
+  visible.resize(_min_x.size());
+#if defined(ELK_BOUNDING_BOX_BATCH_AVX2) || defined(ELK_BOUNDING_BOX_BATCH_SSE)
+  if (_use_simd)
+    frustumSimd(planes, 0, _min_x.size(), visible.data());
+  else
+#endif
+    frustumScalar(planes, 0, _min_x.size(), visible.data());
+  visible.resize(_size);
+}
+
+void BoundingBoxBatch::intersects(
+  const glm::vec3& origin,
+  const glm::vec3& direction,
+  std::vector<float>& distances) const
+{
+  distances.resize(_min_x.size());
+  intersects(origin, direction, 0, _min_x.size(), distances.data());
+  distances.resize(_size);
+}
+
+int BoundingBoxBatch::closestHit(
+  const glm::vec3& origin, const glm::vec3& direction, float* distance) const
+{
+  // Chunks that stay in the L1 cache instead of one array for all boxes
+  const size_t chunk_size = 256;
+  float distances[chunk_size];
+  float closest_distance = std::numeric_limits<float>::infinity();
+  int closest = -1;
+  for (size_t begin = 0; begin < _min_x.size(); begin += chunk_size)
+  {
+    size_t end = std::min(begin + chunk_size, _min_x.size());
+    intersects(origin, direction, begin, end, distances);
+    end = std::min(end, _size);
+    for (size_t i = begin; i < end; ++i)
+    {
+      if (distances[i - begin] < closest_distance)
+      {
+        closest_distance = distances[i - begin];
+        closest = static_cast<int>(i);
+      }
+    }
+  }
+  if (distance && closest >= 0)
+    *distance = closest_distance;
+  return closest;
+}
+
+void BoundingBoxBatch::intersects(
+  const glm::vec3& origin,
+  const glm::vec3& direction,
+  size_t begin,
+  size_t end,
+  float* distances) const
+{
+  RayTest ray;
+  const float* min[3] = { _min_x.data(), _min_y.data(), _min_z.data() };
+  const float* max[3] = { _max_x.data(), _max_y.data(), _max_z.data() };
+  for (int a = 0; a < 3; ++a)
+  {
+    ray.origin[a] = origin[a];
+    // One division per ray instead of per box
+    ray.inverse_direction[a] = 1.0f / direction[a];
+    ray.min[a] = min[a];
+    ray.max[a] = max[a];
+  }
+
+#if defined(ELK_BOUNDING_BOX_BATCH_AVX2) || defined(ELK_BOUNDING_BOX_BATCH_SSE)
+  if (_use_simd)
+    raySimd(ray, begin, end, distances);
+  else
+#endif
+    rayScalar(ray, begin, end, distances);
+}
+
+void BoundingBoxBatch::intersects(
+  const glm::vec3& center,
+  float radius,
+  size_t begin,
+  size_t end,
+  unsigned char* intersecting) const
+{
+  SphereTest sphere;
+  const float* min[3] = { _min_x.data(), _min_y.data(), _min_z.data() };
+  const float* max[3] = { _max_x.data(), _max_y.data(), _max_z.data() };
+  for (int a = 0; a < 3; ++a)
+  {
+    sphere.center[a] = center[a];
+    sphere.min[a] = min[a];
+    sphere.max[a] = max[a];
+  }
+  sphere.radius_squared = radius * radius;
+
+  // Whole SIMD widths, the padding makes this stay inside the arrays
+  end = begin + (end - begin + padding - 1) / padding * padding;
+#if defined(ELK_BOUNDING_BOX_BATCH_AVX2) || defined(ELK_BOUNDING_BOX_BATCH_SSE)
+  if (_use_simd)
+    sphereSimd(sphere, begin, end, intersecting);
+  else
+#endif
+    sphereScalar(sphere, begin, end, intersecting);
+}
+
+const char* BoundingBoxBatch::instructionSet()
+{
+#if defined(ELK_BOUNDING_BOX_BATCH_AVX2)
+  return "AVX2";
+#elif defined(ELK_BOUNDING_BOX_BATCH_SSE)
+  return "SSE";
+#else
+  return "scalar";
+#endif
+}
+
+} }
@@ -0,0 +1,328 @@
+#include "elk/core/bounding_volume_hierarchy.h"
+
+#include <algorithm>
+
+namespace elk { namespace core {
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy(float fat_margin) :
+  _root(null_node),
+  _free_list(null_node),
+  _n_proxies(0),
+  _fat_margin(fat_margin)
+{ }
+
+BoundingVolumeHierarchy::~BoundingVolumeHierarchy()
+{ }
+
+int BoundingVolumeHierarchy::insert(const BoundingBox& box, void* user_data)
+{
+  int proxy = allocateNode();
+  _nodes[proxy].box = enlarged(box);
+  _nodes[proxy].tight_box = box;
+  _nodes[proxy].user_data = user_data;
+  _nodes[proxy].height = 0;
+  insertLeaf(proxy);
+  _n_proxies++;
+  return proxy;
+}
+
+void BoundingVolumeHierarchy::remove(int proxy)
+{
+  removeLeaf(proxy);
+  freeNode(proxy);
+  _n_proxies--;
+}
+
+bool BoundingVolumeHierarchy::move(int proxy, const BoundingBox& box)
+{
+  _nodes[proxy].tight_box = box;
+  if (_nodes[proxy].box.contains(box))
+    return false;
+
+  removeLeaf(proxy);
+  _nodes[proxy].box = enlarged(box);
+  insertLeaf(proxy);
+  return true;
+}
+
+void BoundingVolumeHierarchy::clear()
+{
+  _nodes.clear();
+  _root = null_node;
+  _free_list = null_node;
+  _n_proxies = 0;
+}
+
+void BoundingVolumeHierarchy::query(
+  const Frustum& frustum, std::vector<int>& proxies) const
+{
+  if (_root == null_node)
+    return;
+  // Node and whether it is known to be completely inside the frustum
+  std::vector<std::pair<int, bool>> stack;
+  stack.push_back({ _root, false });
+  while (!stack.empty())
+  {
+    int index = stack.back().first;
+    bool inside = stack.back().second;
+    stack.pop_back();
+    const Node& node = _nodes[index];
+
+    if (!inside)
+    {
+      Frustum::Intersection intersection = frustum.classify(node.box);
+      if (intersection == Frustum::Intersection::Outside)
+        continue;
+      inside = intersection == Frustum::Intersection::Inside;
+    }
+    if (node.isLeaf())
+    {
+      if (inside || frustum.intersects(node.tight_box))
+        proxies.push_back(index);
+      continue;
+    }
+    stack.push_back({ node.children[0], inside });
+    stack.push_back({ node.children[1], inside });
+  }
+}
+
+void BoundingVolumeHierarchy::query(
+  const BoundingBox& box, std::vector<int>& proxies) const
+{
+  if (_root == null_node)
+    return;
+  std::vector<int> stack;
+  stack.push_back(_root);
+  while (!stack.empty())
+  {
+    const Node& node = _nodes[stack.back()];
+    int index = stack.back();
+    stack.pop_back();
+    if (!node.box.intersects(box))
+      continue;
+    if (node.isLeaf())
+    {
+      if (node.tight_box.intersects(box))
+        proxies.push_back(index);
+      continue;
+    }
+    stack.push_back(node.children[0]);
+    stack.push_back(node.children[1]);
+  }
+}
+
+void BoundingVolumeHierarchy::raycast(
+  const glm::vec3& origin,
+  const glm::vec3& direction,
+  std::vector<std::pair<int, float>>& hits) const
+{
+  if (_root == null_node)
+    return;
+  size_t first_hit = hits.size();
+  std::vector<int> stack;
+  stack.push_back(_root);
+  while (!stack.empty())
+  {
+    const Node& node = _nodes[stack.back()];
+    int index = stack.back();
+    stack.pop_back();
+    if (!node.box.intersects(origin, direction).first)
+      continue;
+    if (node.isLeaf())
+    {
+      auto hit = node.tight_box.intersects(origin, direction);
+      if (hit.first)
+        hits.push_back({ index, hit.second });
+      continue;
+    }
+    stack.push_back(node.children[0]);
+    stack.push_back(node.children[1]);
+  }
+  std::sort(hits.begin() + first_hit, hits.end(),
+    [](const std::pair<int, float>& a, const std::pair<int, float>& b) {
+      return a.second < b.second;
+    });
+}
+
+int BoundingVolumeHierarchy::height() const
+{
+  return _root == null_node ? 0 : _nodes[_root].height;
+}
+
+int BoundingVolumeHierarchy::allocateNode()
+{
+  if (_free_list == null_node)
+  {
+    _nodes.emplace_back();
+    return static_cast<int>(_nodes.size()) - 1;
+  }
+  int node = _free_list;
+  _free_list = _nodes[node].parent;
+  _nodes[node] = Node();
+  return node;
+}
+
+void BoundingVolumeHierarchy::freeNode(int node)
+{
+  _nodes[node].parent = _free_list;
+  _nodes[node].height = -1;
+  _nodes[node].user_data = nullptr;
+  _free_list = node;
+}
+
+void BoundingVolumeHierarchy::insertLeaf(int leaf)
+{
+  if (_root == null_node)
+  {
+    _root = leaf;
+    _nodes[leaf].parent = null_node;
+    return;
+  }
+
+  // Walk down towards the sibling that gives the smallest increase in
+  // surface area of the tree
+  BoundingBox leaf_box = _nodes[leaf].box;
+  int index = _root;
+  while (!_nodes[index].isLeaf())
+  {
+    const Node& node = _nodes[index];
+    float area = node.box.surfaceArea();
+    float combined_area = node.box.merged(leaf_box).surfaceArea();
+
+    // Cost of making a new parent for this node and the leaf
+    float cost = 2.0f * combined_area;
+    // Cost that all boxes below this node grow by when descending
+    float inheritance_cost = 2.0f * (combined_area - area);
+
+    float child_costs[2];
+    for (int i = 0; i < 2; ++i)
+    {
+      const Node& child = _nodes[node.children[i]];
+      float merged_area = child.box.merged(leaf_box).surfaceArea();
+      child_costs[i] = inheritance_cost + (child.isLeaf() ?
+        merged_area : merged_area - child.box.surfaceArea());
+    }
+
+    if (cost < child_costs[0] && cost < child_costs[1])
+      break;
+    index = child_costs[0] < child_costs[1] ?
+      node.children[0] : node.children[1];
+  }
+
+  int sibling = index;
+  int old_parent = _nodes[sibling].parent;
+  int new_parent = allocateNode();
+  _nodes[new_parent].parent = old_parent;
+  _nodes[new_parent].box = leaf_box.merged(_nodes[sibling].box);
+  _nodes[new_parent].height = _nodes[sibling].height + 1;
+  _nodes[new_parent].children[0] = sibling;
+  _nodes[new_parent].children[1] = leaf;
+  _nodes[sibling].parent = new_parent;
+  _nodes[leaf].parent = new_parent;
+
+  if (old_parent == null_node)
+    _root = new_parent;
+  else if (_nodes[old_parent].children[0] == sibling)
+    _nodes[old_parent].children[0] = new_parent;
+  else
+    _nodes[old_parent].children[1] = new_parent;
+
+  refitAncestors(new_parent);
+}
+
+void BoundingVolumeHierarchy::removeLeaf(int leaf)
+{
+  if (leaf == _root)
+  {
+    _root = null_node;
+    return;
+  }
+
+  int parent = _nodes[leaf].parent;
+  int grand_parent = _nodes[parent].parent;
+  int sibling = _nodes[parent].children[0] == leaf ?
+    _nodes[parent].children[1] : _nodes[parent].children[0];
+
+  // The sibling takes the place of the parent
+  _nodes[sibling].parent = grand_parent;
+  freeNode(parent);
+  if (grand_parent == null_node)
+  {
+    _root = sibling;
+    return;
+  }
+  if (_nodes[grand_parent].children[0] == parent)
+    _nodes[grand_parent].children[0] = sibling;
+  else
+    _nodes[grand_parent].children[1] = sibling;
+  refitAncestors(grand_parent);
+}
+
+void BoundingVolumeHierarchy::refitAncestors(int node)
+{
+  while (node != null_node)
+  {
+    node = balance(node);
+    Node& n = _nodes[node];
+    const Node& child0 = _nodes[n.children[0]];
+    const Node& child1 = _nodes[n.children[1]];
+    n.height = 1 + std::max(child0.height, child1.height);
+    n.box = child0.box.merged(child1.box);
+    node = n.parent;
+  }
+}
+
+int BoundingVolumeHierarchy::balance(int a)
+{
+  Node& node_a = _nodes[a];
+  if (node_a.isLeaf() || node_a.height < 2)
+    return a;
+
+  int b = node_a.children[0];
+  int c = node_a.children[1];
+  int difference = _nodes[c].height - _nodes[b].height;
+  if (difference >= -1 && difference <= 1)
+    return a;
+
+  // The higher child is rotated up and takes the place of a. Its higher
+  // child stays below it and its lower child is moved to a.
+  int up = difference > 1 ? c : b;
+  int stay = difference > 1 ? b : c;
+  int up_side = difference > 1 ? 1 : 0;
+  Node& node_up = _nodes[up];
+  int f = node_up.children[0];
+  int g = node_up.children[1];
+
+  node_up.children[0] = a;
+  node_up.parent = node_a.parent;
+  node_a.parent = up;
+  if (node_up.parent == null_node)
+    _root = up;
+  else if (_nodes[node_up.parent].children[0] == a)
+    _nodes[node_up.parent].children[0] = up;
+  else
+    _nodes[node_up.parent].children[1] = up;
+
+  int keep = _nodes[f].height > _nodes[g].height ? f : g;
+  int move = keep == f ? g : f;
+  node_up.children[1] = keep;
+  node_a.children[up_side] = move;
+  _nodes[move].parent = a;
+
+  node_a.box = _nodes[stay].box.merged(_nodes[move].box);
+  node_a.height = 1 + std::max(_nodes[stay].height, _nodes[move].height);
+  node_up.box = node_a.box.merged(_nodes[keep].box);
+  node_up.height = 1 + std::max(node_a.height, _nodes[keep].height);
+  return up;
+}
+
+BoundingBox BoundingVolumeHierarchy::enlarged(
+  const BoundingBox& box) const
+{
+  // Based on the longest side so that flat boxes get a margin too
+  glm::vec3 size = box.max() - box.min();
+  glm::vec3 margin(_fat_margin * std::max(size.x, std::max(size.y, size.z)));
+  return BoundingBox(box.min() - margin, box.max() + margin);
+}
+
+} }
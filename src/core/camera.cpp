@@ -6,7 +6,9 @@
 
 namespace elk { namespace core {
 
-AbstractCamera::AbstractCamera()
+AbstractCamera::AbstractCamera() :
+  _view_transform(1.0f),
+  _view_transform_source(1.0f)
 {
 
 }
@@ -21,9 +23,14 @@ glm::mat4 AbstractCamera::projectionTransform() const
   return _projection_transform;
 }
 
-glm::mat4 AbstractCamera::viewTransform() const
+const glm::mat4& AbstractCamera::viewTransform() const
 {
-  return glm::inverse(absoluteTransform());
+  if (absoluteTransform() != _view_transform_source)
+  {
+    _view_transform_source = absoluteTransform();
+    _view_transform = glm::inverse(_view_transform_source);
+  }
+  return _view_transform;
 }
 
 std::pair<glm::vec3, glm::vec3> AbstractCamera::unproject(
@@ -33,7 +40,7 @@ std::pair<glm::vec3, glm::vec3> AbstractCamera::unproject(
   glm::vec2 position = position_ndc / 2.0f + glm::vec2(0.5);
   float w = 1, h = 1;
 
-  const glm::mat4& V = glm::inverse(absoluteTransform());
+  const glm::mat4& V = viewTransform();
   const glm::mat4& P = _projection_transform;
   
   glm::vec3 from =
@@ -1,6 +1,7 @@
 #include "elk/core/create_texture.h"
 
 #include <glm/glm.hpp>
+#include <string>
 #include <vector>
 
 #if ELK_USE_FREEIMAGE
@@ -15,6 +16,8 @@ std::shared_ptr<Texture> CreateTexture::load(const char* path)
 #if ELK_USE_FREEIMAGE
 
 auto texture_data = loadTexture_freeimage(path);
+if (!texture_data.first)
+  return nullptr;
 
 std::shared_ptr<Texture> tex = std::make_shared<Texture>(
   texture_data.first, glm::uvec3(texture_data.second,1),
@@ -28,6 +31,42 @@ return nullptr;
 #endif
 };
 
+JobSystem::JobHandle CreateTexture::loadAsync(
+  JobSystem& job_system, const char* path,
+  std::function<void(std::shared_ptr<Texture>)> on_loaded)
+{
+#if ELK_USE_FREEIMAGE
+
+auto texture_data = std::make_shared<std::pair<void*, glm::uvec2>>();
+std::string path_string(path);
+
+auto decode = job_system.schedule([texture_data, path_string]() {
+  *texture_data = loadTexture_freeimage(path_string.c_str());
+});
+
+// Creating the texture needs the OpenGL context. The decode job has no
+// exception handling of its own, if it throws this job is not run and wait()
+// on the returned handle rethrows
+return job_system.scheduleOnMainThread([texture_data, on_loaded]() {
+  if (!texture_data->first)
+  {
+    on_loaded(nullptr);
+    return;
+  }
+  std::shared_ptr<Texture> tex = std::make_shared<Texture>(
+    texture_data->first, glm::uvec3(texture_data->second,1),
+    Texture::Format::RGBA, GL_RGBA, GL_UNSIGNED_BYTE,
+    Texture::FilterMode::LinearMipMap, Texture::WrappingMode::Repeat);
+  on_loaded(tex);
+}, { decode });
+#else
+printf("ERROR : No image library to load textures!");
+return job_system.scheduleOnMainThread([on_loaded]() {
+  on_loaded(nullptr);
+});
+#endif
+}
+
 std::shared_ptr<CubeMapTexture> CreateTexture::loadCubeMap(
   const char* path_positive_x, const char* path_negative_x,
   const char* path_positive_y, const char* path_negative_y,
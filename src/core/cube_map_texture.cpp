@@ -1,4 +1,5 @@
 #include "elk/core/cube_map_texture.h"
+#include "elk/core/gl_state.h"
 #include <cassert>
 #include <cstring>
 
@@ -55,7 +56,7 @@ CubeMapTexture::CubeMapTexture(
 CubeMapTexture::~CubeMapTexture()
 {
   if (_id) {
-    glDeleteTextures(1, &_id);
+    GLState::deleteTexture(_id);
   }
 
   if (_has_ownership_of_data) {
@@ -124,7 +125,7 @@ void CubeMapTexture::disable() const
 
 void CubeMapTexture::bind() const
 {
-  glBindTexture(_type, _id);
+  GLState::bindTexture(_type, _id);
 }
 
 void CubeMapTexture::applyFilter()
@@ -145,7 +146,7 @@ void CubeMapTexture::applyFilter()
       glTexParameteri(_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
       upload();
       glGenerateMipmap(_type);
-      glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+      GLState::enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
       break;
     case FilterMode::AnisotropicMipMap:
     {
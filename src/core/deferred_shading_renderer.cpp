@@ -1,72 +1,192 @@
 #include "elk/core/deferred_shading_renderer.h"
 
 #include "elk/core/texture_unit.h"
+#include "elk/core/gl_state.h"
 #include "elk/core/create_texture.h"
 #include "elk/object_extensions/light_source.h"
 #include "elk/core/debug_input.h"
+#include "elk/core/create_mesh.h"
+#include "elk/core/material.h"
+
+#include <algorithm>
+#include <cmath>
 
 namespace elk { namespace core {
 
-DeferredShadingRenderer::DeferredShadingRenderer(
-  PerspectiveCamera& camera, int framebuffer_width, int framebuffer_height) :
-  Renderer(camera, framebuffer_width, framebuffer_height)
-{
-  initializeShaders();
-  initializeFramebuffers(framebuffer_width, framebuffer_height);
+namespace {
+  // Mip levels 0 to 7 are sampled by reflections, depth of field and bloom
+  const int sampled_mip_levels = 8;
+  // Attributes 0 to 4 are used by the vertex buffers of the light meshes
+  const GLuint first_point_light_attribute = 5;
+  // Work group size of shading_pass_tiled_point_lights.comp
+  const GLuint light_tile_size = 16;
+  const UniformName uniform_light_volume("light_volume");
+  const UniformName uniform_compact_g_buffer("compact_g_buffer");
+  const UniformName uniform_light_buffer("light_buffer");
+  const UniformName uniform_cluster_buffer("cluster_buffer");
+  const UniformName uniform_light_index_buffer("light_index_buffer");
+  const UniformName uniform_light_buffer_offset("light_buffer_offset");
+  const UniformName uniform_n_lights("n_lights");
+  const UniformName uniform_radiance_image("radiance_image");
+  const UniformName uniform_cluster_buffer_offset("cluster_buffer_offset");
+  const UniformName uniform_light_index_buffer_offset("light_index_buffer_offset");
+  const UniformName uniform_cluster_dimensions("cluster_dimensions");
+  const UniformName uniform_cluster_near("cluster_near");
+  const UniformName uniform_cluster_far("cluster_far");
+  const UniformName uniform_window_size("window_size");
+  const UniformName uniform_bloom_buffer_base_size("bloom_buffer_base_size");
+  const UniformName uniform_focal_length("focal_length");
+  const UniformName uniform_focus("focus");
+  const UniformName uniform_inv_focal_ratio_in_pixels("inv_focal_ratio_in_pixels");
+  const UniformName uniform_cube_map_size("cube_map_size");
+  const UniformName uniform_pixel_buffer("pixel_buffer");
+  const UniformName uniform_albedo_buffer("albedo_buffer");
+  const UniformName uniform_position_buffer("position_buffer");
+  const UniformName uniform_normal_buffer("normal_buffer");
+  const UniformName uniform_material_buffer("material_buffer");
+  const UniformName uniform_normal_material_buffer("normal_material_buffer");
+  const UniformName uniform_depth_buffer("depth_buffer");
+  const UniformName uniform_irradiance_buffer("irradiance_buffer");
+  const UniformName uniform_bloom_buffer("bloom_buffer");
+  const UniformName uniform_render_scale("render_scale");
 }
 
-DeferredShadingRenderer::~DeferredShadingRenderer()
+DeferredShadingRenderer::DeferredShadingRenderer(
+  PerspectiveCamera& camera, int framebuffer_width, int framebuffer_height,
+  GBufferLayout g_buffer_layout) :
+  Renderer(camera, framebuffer_width, framebuffer_height),
+  _g_buffer_layout(g_buffer_layout),
+  _framebuffer_size(framebuffer_width, framebuffer_height),
+  _render_graph_dirty(true),
+  _point_light_shading(PointLightShading::LightVolumes),
+  _render_scale(1.0f),
+  _fixed_render_scale(1.0f),
+  _dynamic_resolution(false)
 {
-
+  initializeShaders();
+  _quad_mesh = CreateMesh::quad();
+  _light_sphere_mesh = CreateMesh::lonLatSphere(16, 8);
+  _point_light_buffer = std::make_unique<StreamingBuffer>(
+    GL_ARRAY_BUFFER, 256 * sizeof(PointLightInstance));
+  _light_texture_buffer = std::make_unique<TextureBuffer>(
+    GL_RGBA32F, sizeof(glm::vec4), 256 * sizeof(PointLightInstance));
+  _cluster_buffer = std::make_unique<TextureBuffer>(
+    GL_RG32UI, sizeof(LightCluster),
+    _light_cluster_grid.numberOfClusters() * sizeof(LightCluster));
+  _cluster_light_index_buffer = std::make_unique<TextureBuffer>(
+    GL_R32UI, sizeof(GLuint), 4096 * sizeof(GLuint));
 }
 
 void DeferredShadingRenderer::setSkyBox(std::shared_ptr<RenderableCubeMap> sky_box)
 {
+  // Reflections are only rendered with a sky box
+  if (static_cast<bool>(_sky_box) != static_cast<bool>(sky_box))
+    _render_graph_dirty = true;
   _sky_box = sky_box;
 }
 
 void DeferredShadingRenderer::render(Object3D& scene)
 {
+  GLState::beginFrame();
+  _profiler.beginFrame();
+  updateRenderScale();
+  if (_render_graph_dirty)
+    buildRenderGraph();
   // Submit all objects in the scene to the lists of renderable objects
-  scene.submit(*this);
+  _profiler.beginScope("submit");
+  submitScene(scene);
+  fillRenderQueue();
+  _profiler.endScope();
+  glm::ivec2 render_size = renderSize(_framebuffer_size);
+  updateViewUniforms(
+    glm::vec4(0.0f, 0.0f, render_size.x, render_size.y),
+    glm::vec2(render_size) / glm::vec2(_framebuffer_size));
+
+  _render_graph.setRenderScale(
+    glm::vec2(render_size) / glm::vec2(_framebuffer_size));
+  _render_graph.execute(&_profiler);
+  _profiler.endFrame();
 
-  renderGeometryBuffer(*_geometry_fbo_quad);
-  renderLightSources(*_irradiance_fbo_quad1);
-
-  // This will allow reflections to have roughness by sampling from mip-map
-  _irradiance_fbo_quad1->generateMipMaps();
-  _geometry_fbo_quad->generateMipMaps();
-
-  renderReflections(*_irradiance_fbo_quad1, *_irradiance_fbo_quad2);
-
-  // This will allow depth of field by sampling from mip-map
-  _irradiance_fbo_quad2->generateMipMaps();
+  checkForErrors();
+}
 
-  renderHighlights(*_irradiance_fbo_quad2, *_post_process_fbo_quad);
+void DeferredShadingRenderer::setPointLightShading(PointLightShading shading)
+{
+  if (shading == PointLightShading::TiledCompute &&
+      !_shading_program_tiled_point_lights)
+  {
+    fprintf(stderr, "ERROR : Tiled point light shading needs compute shaders "
+      "(OpenGL 4.3 or ARB_compute_shader)\n");
+    return;
+  }
+  _point_light_shading = shading;
+}
 
-  // This will allow smooth blooming by sampling from mip-map
-  _post_process_fbo_quad->generateMipMaps();
+void DeferredShadingRenderer::setDynamicResolution(
+  bool enabled, float target_frame_time, float min_scale)
+{
+  _dynamic_resolution = enabled;
+  _render_scale_controller.setTargetFrameTime(target_frame_time);
+  _render_scale_controller.setScaleRange(min_scale, 1.0f);
+  _render_scale_controller.reset();
+}
 
-  renderPostProcess(*_irradiance_fbo_quad2, *_irradiance_fbo_quad1);
+void DeferredShadingRenderer::setRenderScale(float scale)
+{
+  if (scale <= 0.0f || scale > 1.0f)
+  {
+    fprintf(stderr, "ERROR : Render scale %f is not in (0, 1]\n", scale);
+    return;
+  }
+  _fixed_render_scale = scale;
+}
 
-  renderPostProcessMotionBlur(*_irradiance_fbo_quad1, *_irradiance_fbo_quad2);
-  forwardRenderIndependentRenderables(*_irradiance_fbo_quad2);
+void DeferredShadingRenderer::updateRenderScale()
+{
+  if (_dynamic_resolution)
+  {
+    for (float frame_time : _profiler.gpuFrameTimes())
+      _render_scale_controller.update(frame_time);
+  }
+  _render_scale = _dynamic_resolution ?
+    _render_scale_controller.scale() : _fixed_render_scale;
+}
 
-  // Render the first attachment of the final fbo to screen
-  renderToScreen(*_irradiance_fbo_quad2, 0);
+glm::ivec2 DeferredShadingRenderer::renderSize(const glm::uvec2& size) const
+{
+  return glm::ivec2(
+    std::max(1, static_cast<int>(std::round(size.x * _render_scale))),
+    std::max(1, static_cast<int>(std::round(size.y * _render_scale))));
+}
 
-  checkForErrors();
+void DeferredShadingRenderer::setRenderViewport(const glm::uvec2& size)
+{
+  glm::ivec2 render_size = renderSize(size);
+  GLState::viewport(0, 0, render_size.x, render_size.y);
 }
 
 void DeferredShadingRenderer::initializeShaders()
 {
   _shading_program_point_lights = std::make_shared<ShaderProgram>(
     "shading_program_point_lights",
-    (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass.vert").c_str(),
+    (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass_point_light.vert").c_str(),
     nullptr,
     nullptr,
     nullptr,
     (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass_point_light.frag").c_str());
+  _shading_program_clustered_point_lights = std::make_shared<ShaderProgram>(
+    "shading_program_clustered_point_lights",
+    (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass.vert").c_str(),
+    nullptr,
+    nullptr,
+    nullptr,
+    (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass_clustered_point_lights.frag").c_str());
+  if (ShaderProgram::computeShadersSupported())
+  {
+    _shading_program_tiled_point_lights = std::make_shared<ShaderProgram>(
+      "shading_program_tiled_point_lights",
+      (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass_tiled_point_lights.comp").c_str());
+  }
   _shading_program_directional_lights = std::make_shared<ShaderProgram>(
     "shading_program_directional_lights",
     (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass.vert").c_str(),
@@ -130,434 +250,527 @@ void DeferredShadingRenderer::initializeShaders()
     nullptr,
     nullptr,
     (std::string(ELK_DIR) + "/shaders/deferred_shading/final_pass_through.frag").c_str());
+
+  // Programs reading the G-buffer through g_buffer.glsl
+  for (auto program : {
+    _shading_program_point_lights,
+    _shading_program_clustered_point_lights,
+    _shading_program_tiled_point_lights,
+    _shading_program_directional_lights,
+    _shading_program_environment_diffuse,
+    _shading_program_reflections,
+    _post_process_program,
+    _motion_blur_program })
+  {
+    if (!program)
+      continue;
+    program->pushUsage();
+    ShaderProgram::current().setUniform(uniform_compact_g_buffer,
+      _g_buffer_layout == GBufferLayout::Compact ? 1 : 0);
+    program->popUsage();
+  }
 }
 
-void DeferredShadingRenderer::initializeFramebuffers(
-  int framebuffer_width, int framebuffer_height)
+void DeferredShadingRenderer::buildRenderGraph()
 {
-  // Create render textures to be used in G-Buffer
-  FrameBufferQuad::RenderTexture albedo_render_tex =
-  {
-    std::make_shared<Texture>(
-      glm::uvec3(framebuffer_width, framebuffer_height, 1),
-      Texture::Format::RGBA, GL_RGBA, GL_UNSIGNED_BYTE,
-      Texture::FilterMode::LinearMipMap,
-      Texture::WrappingMode::ClampToEdge),
-      GL_COLOR_ATTACHMENT0,
-      "albedo_buffer"
-  };
-  FrameBufferQuad::RenderTexture position_render_tex =
-  {
-    std::make_shared<Texture>(
-      glm::uvec3(framebuffer_width, framebuffer_height, 1),
-      Texture::Format::RGB, GL_RGB16F, GL_HALF_FLOAT,
-      Texture::FilterMode::Nearest,
-      Texture::WrappingMode::ClampToEdge),
-      GL_COLOR_ATTACHMENT1,
-      "position_buffer"
+  using Format = Texture::Format;
+  using Filter = Texture::FilterMode;
+  auto pass = [this](
+    const char* name, void (DeferredShadingRenderer::*render)(
+      const RenderGraph::PassContext&)) -> RenderGraph::Pass& {
+    return _render_graph.addPass(name,
+      [this, render](const RenderGraph::PassContext& context) {
+        (this->*render)(context);
+      });
   };
-  FrameBufferQuad::RenderTexture normal_render_tex =
+  const glm::uvec2 size = _framebuffer_size;
+  _render_graph.clear();
+
+  // The depth texture is only read with the compact layout, otherwise it
+  // is shared with later passes
+  _render_graph.addTexture("albedo",
+    { size, Format::RGBA, GL_RGBA8, GL_UNSIGNED_BYTE, Filter::Linear });
+  _render_graph.addTexture("depth",
+    { size, Format::DepthComponent, GL_DEPTH_COMPONENT32F, GL_FLOAT,
+      Filter::Nearest });
+  RenderGraph::Pass& geometry =
+    pass("geometry", &DeferredShadingRenderer::renderGeometryBuffer)
+    .write("albedo", GL_COLOR_ATTACHMENT0)
+    .write("depth", GL_DEPTH_ATTACHMENT);
+  if (_g_buffer_layout == GBufferLayout::Compact)
   {
-    std::make_shared<Texture>(
-      glm::uvec3(framebuffer_width, framebuffer_height, 1),
-      Texture::Format::RGB, GL_RGB16F, GL_HALF_FLOAT,
-      Texture::FilterMode::Nearest,
-      Texture::WrappingMode::ClampToEdge),
-      GL_COLOR_ATTACHMENT2,
-      "normal_buffer"
-  };
-  FrameBufferQuad::RenderTexture material_render_tex =
-  {
-    std::make_shared<Texture>(
-      glm::uvec3(framebuffer_width, framebuffer_height, 1),
-      Texture::Format::RGB, GL_RGB16F, GL_HALF_FLOAT,
-      Texture::FilterMode::Nearest,
-      Texture::WrappingMode::ClampToEdge),
-      GL_COLOR_ATTACHMENT3,
-      "material_buffer"
-  };
-  
-  // Create render textures to be used in Irradiance-Buffer
-  FrameBufferQuad::RenderTexture irradiance_render_tex1 =
+    _render_graph.addTexture("normal_material",
+      { size, Format::RGBA, GL_RGBA16, GL_UNSIGNED_SHORT, Filter::Nearest });
+    geometry.write("normal_material", GL_COLOR_ATTACHMENT1);
+  }
+  else
   {
-    std::make_shared<Texture>(
-      glm::uvec3(framebuffer_width, framebuffer_height, 1),
-      Texture::Format::RGBA, GL_RGBA16F, GL_HALF_FLOAT,
-      Texture::FilterMode::LinearMipMap,
-      Texture::WrappingMode::ClampToEdge),
-      GL_COLOR_ATTACHMENT0,
-      "irradiance_buffer"
-  };
+    for (auto name : { "position", "normal", "material" })
+    {
+      _render_graph.addTexture(name,
+        { size, Format::RGB, GL_RGB16F, GL_HALF_FLOAT, Filter::Nearest });
+    }
+    geometry
+      .write("position", GL_COLOR_ATTACHMENT1)
+      .write("normal", GL_COLOR_ATTACHMENT2)
+      .write("material", GL_COLOR_ATTACHMENT3);
+  }
 
-  FrameBufferQuad::RenderTexture irradiance_render_tex2 =
-  {
-    std::make_shared<Texture>(
-      glm::uvec3(framebuffer_width, framebuffer_height, 1),
-      Texture::Format::RGB, GL_RGB16F, GL_HALF_FLOAT,
-      Texture::FilterMode::LinearMipMap,
-      Texture::WrappingMode::ClampToEdge),
-      GL_COLOR_ATTACHMENT0,
-      "irradiance_buffer"
-  };
+  _render_graph.addTexture("irradiance",
+    { size, Format::RGBA, GL_RGBA16F, GL_HALF_FLOAT, Filter::Linear });
+  readGeometryBuffer(
+    pass("lights", &DeferredShadingRenderer::renderLightSources)
+    .write("irradiance", GL_COLOR_ATTACHMENT0));
+
+  // Reflections sample mip maps for rough surfaces. They need the sky box,
+  // without one the later passes read the light buffer and the pass is
+  // culled. Textures with mip maps have four channels so that the
+  // downsampler can write them as images
+  _render_graph.addTexture("reflected",
+    { size, Format::RGBA, GL_RGBA16F, GL_HALF_FLOAT, Filter::Linear });
+  readGeometryBuffer(
+    pass("reflections", &DeferredShadingRenderer::renderReflections)
+    .read("irradiance", uniform_irradiance_buffer, sampled_mip_levels)
+    .write("reflected", GL_COLOR_ATTACHMENT0), sampled_mip_levels);
+  const char* shaded = _sky_box ? "reflected" : "irradiance";
+
+  _render_graph.addTexture("bloom",
+    { size / 2u, Format::RGBA, GL_RGBA16F, GL_HALF_FLOAT, Filter::Linear });
+  pass("highlights", &DeferredShadingRenderer::renderHighlights)
+    .read(shaded, uniform_irradiance_buffer)
+    .write("bloom", GL_COLOR_ATTACHMENT0);
+
+  // Depth of field and bloom sample mip maps
+  _render_graph.addTexture("post_processed",
+    { size, Format::RGBA, GL_RGBA16F, GL_HALF_FLOAT, Filter::Linear });
+  readGeometryBuffer(
+    pass("post_process", &DeferredShadingRenderer::renderPostProcess)
+    .read(shaded, uniform_irradiance_buffer, sampled_mip_levels)
+    .read("bloom", uniform_bloom_buffer, sampled_mip_levels)
+    .write("post_processed", GL_COLOR_ATTACHMENT0));
+
+  // Motion blur writes the depth the forward renderables are tested against.
+  // The final image shares a texture with the reflections
+  _render_graph.addTexture("final",
+    { size, Format::RGBA, GL_RGBA16F, GL_HALF_FLOAT, Filter::Linear });
+  _render_graph.addTexture("final_depth",
+    { size, Format::DepthComponent, GL_DEPTH_COMPONENT32F, GL_FLOAT,
+      Filter::Nearest });
+  readGeometryBuffer(
+    pass("motion_blur", &DeferredShadingRenderer::renderPostProcessMotionBlur)
+    .read("post_processed", uniform_irradiance_buffer)
+    .write("final", GL_COLOR_ATTACHMENT0)
+    .write("final_depth", GL_DEPTH_ATTACHMENT));
+  pass("forward", &DeferredShadingRenderer::forwardRenderIndependentRenderables)
+    .write("final", GL_COLOR_ATTACHMENT0)
+    .write("final_depth", GL_DEPTH_ATTACHMENT);
+
+  pass("screen", &DeferredShadingRenderer::renderToScreen)
+    .read("final", uniform_pixel_buffer)
+    .output();
+
+  _render_graph.compile();
+  _render_graph_dirty = false;
+}
 
-  // Render textures for post processing
-  FrameBufferQuad::RenderTexture bloom_render_tex =
+void DeferredShadingRenderer::readGeometryBuffer(
+  RenderGraph::Pass& pass, int albedo_mip_levels)
+{
+  pass.read("albedo", uniform_albedo_buffer, albedo_mip_levels);
+  if (_g_buffer_layout == GBufferLayout::Compact)
   {
-    std::make_shared<Texture>(
-      glm::uvec3(framebuffer_width / 2, framebuffer_height / 2, 1),
-      Texture::Format::RGB, GL_RGB16F, GL_HALF_FLOAT,
-      Texture::FilterMode::LinearMipMap,
-      Texture::WrappingMode::ClampToEdge),
-      GL_COLOR_ATTACHMENT0,
-      "bloom_buffer"
-  };
-
-  // Generate the framebuffer quads
-  _geometry_fbo_quad = std::make_unique<FrameBufferQuad>(
-    framebuffer_width, framebuffer_height,
-    std::vector<FrameBufferQuad::RenderTexture>{
-      albedo_render_tex,
-      position_render_tex,
-      normal_render_tex,
-      material_render_tex },
-      FrameBufferQuad::UseDepthBuffer::YES);
-
-  _irradiance_fbo_quad1 = std::make_unique<FrameBufferQuad>(
-    framebuffer_width, framebuffer_height,
-    std::vector<FrameBufferQuad::RenderTexture>{
-      irradiance_render_tex1},
-      FrameBufferQuad::UseDepthBuffer::YES);
-
-  _irradiance_fbo_quad2 = std::make_unique<FrameBufferQuad>(
-    framebuffer_width, framebuffer_height,
-    std::vector<FrameBufferQuad::RenderTexture>{
-      irradiance_render_tex2},
-      FrameBufferQuad::UseDepthBuffer::YES);
-
-  _post_process_fbo_quad = std::make_unique<FrameBufferQuad>(
-    framebuffer_width / 2, framebuffer_height / 2,
-    std::vector<FrameBufferQuad::RenderTexture>{bloom_render_tex});
+    pass
+      .read("normal_material", uniform_normal_material_buffer)
+      .read("depth", uniform_depth_buffer);
+  }
+  else
+  {
+    pass
+      .read("position", uniform_position_buffer)
+      .read("normal", uniform_normal_buffer)
+      .read("material", uniform_material_buffer);
+  }
 }
 
-void DeferredShadingRenderer::renderGeometryBuffer(FrameBufferQuad& geometry_buffer)
+void DeferredShadingRenderer::renderGeometryBuffer(
+  const RenderGraph::PassContext& context)
 {
-  geometry_buffer.bindFBO();
-  glViewport(0,0, geometry_buffer.width(), geometry_buffer.height());
+  setRenderViewport(context.size());
+  Material::setCompactGBuffer(_g_buffer_layout == GBufferLayout::Compact);
   glClearColor(0.0, 0.0, 0.0, 0.0);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  glEnable(GL_DEPTH_TEST);
-  glDisable(GL_BLEND);
-  glDepthMask(GL_TRUE);
-
-  for (auto renderable : _renderables_deferred_to_render)
-    renderable->render({ _camera });
-  _renderables_deferred_to_render.clear();
+  GLState::enable(GL_DEPTH_TEST);
+  GLState::disable(GL_BLEND);
+  GLState::depthMask(GL_TRUE);
 
-  geometry_buffer.unbindFBO();
+  _render_queue.render(RenderPass::Geometry, { _camera });
 }
 
-void DeferredShadingRenderer::renderLightSources(FrameBufferQuad& light_buffer)
+void DeferredShadingRenderer::renderLightSources(
+  const RenderGraph::PassContext& context)
 {
-  // Render to irradiance buffer
-  light_buffer.bindFBO();
-  // Setup for rendering light sources to the light_buffer.rame buffer
-  glViewport(0,0, light_buffer.width(), light_buffer.height());
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glDisable(GL_DEPTH_TEST);
-  glBlendFunc(GL_ONE, GL_ONE);
-  glEnable(GL_BLEND);
+  // Setup for rendering light sources to the light buffer
+  setRenderViewport(context.size());
+  glClear(GL_COLOR_BUFFER_BIT);
+  GLState::disable(GL_DEPTH_TEST);
+  GLState::blendFunc(GL_ONE, GL_ONE);
+  GLState::enable(GL_BLEND);
   
   // Render light sources
-  renderPointLights();
-  renderDirectionalLights();
+  renderPointLights(context);
+  renderDirectionalLights(context);
 
   if (_sky_box)
   {
-    renderDiffuseEnvironmentLights();
-    renderSkyBox();
+    renderDiffuseEnvironmentLights(context);
+    renderSkyBox(context);
   }
-  light_buffer.unbindFBO();
 }
 
 void DeferredShadingRenderer::renderReflections(
-  FrameBufferQuad& sample_buffer, FrameBufferQuad& output_buffer)
+  const RenderGraph::PassContext& context)
 {
-  // Render to final irradiance buffer (reflections)
-  output_buffer.bindFBO();
-  glViewport(0,0,
-    output_buffer.width(),
-    output_buffer.height());
-  glDisable(GL_BLEND);
+  setRenderViewport(context.size());
+  GLState::disable(GL_BLEND);
   
-  renderScreenSpaceReflections(sample_buffer);
-  output_buffer.unbindFBO();
+  renderScreenSpaceReflections(context);
 }
 
 void DeferredShadingRenderer::renderHighlights(
-  FrameBufferQuad& sample_buffer, FrameBufferQuad& output_buffer)
+  const RenderGraph::PassContext& context)
 {
-  output_buffer.bindFBO();
-  glViewport(0,0,
-    output_buffer.width(),
-    output_buffer.height());
+  setRenderViewport(context.size());
   glClear(GL_COLOR_BUFFER_BIT);
 
   _output_highlights_program->pushUsage();
-  glUniform2i(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "window_size"),
-    output_buffer.width(), output_buffer.height());
-  sample_buffer.bindTextures();
-  sample_buffer.render();
-  sample_buffer.freeTextureUnits();
+  ShaderProgram::current().setUniform(uniform_window_size,
+    glm::ivec2(context.size()));
+  context.bindSamplers();
+  _quad_mesh->render();
   _output_highlights_program->popUsage();
-  output_buffer.unbindFBO();
 }
 
 void DeferredShadingRenderer::renderPostProcess(
-  FrameBufferQuad& sample_buffer, FrameBufferQuad& output_buffer)
+  const RenderGraph::PassContext& context)
 {
-  // Perform post processing, rendering to final buffer
-  output_buffer.bindFBO();
-  glViewport(0,0,
-    output_buffer.width(),
-    output_buffer.height());
+  setRenderViewport(context.size());
   
   _post_process_program->pushUsage();
-  glUniform2i(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "window_size"),
-    output_buffer.width(),
-    output_buffer.height());
-  glUniform2i(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "bloom_buffer_base_size"),
-    _post_process_fbo_quad->width(),
-    _post_process_fbo_quad->height());
-  glUniform1f(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "focal_length"),
+  ShaderProgram::current().setUniform(uniform_window_size,
+    glm::ivec2(context.size()));
+  ShaderProgram::current().setUniform(uniform_bloom_buffer_base_size,
+    glm::ivec2(_framebuffer_size / 2u));
+  ShaderProgram::current().setUniform(uniform_focal_length,
     _camera.focalLength() / 1000.0f); // Convert from mm to m
-  glUniform1f(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "focus"),
+  ShaderProgram::current().setUniform(uniform_focus,
     _camera.focus() / 1000.0f); // Convert from mm to m
 
   float diagonal = _camera.diagonal() / 1000.0f;
+  // In rendered pixels, the blur is upscaled with the frame
+  glm::ivec2 render_size = renderSize(context.size());
   float window_diagonal =
-    sqrt(pow(output_buffer.width(), 2) + pow(output_buffer.height(), 2));  
+    sqrt(pow(render_size.x, 2) + pow(render_size.y, 2));
   float inv_focal_ratio_in_pixels =
     1.0f / (diagonal * _camera.focalRatio()) * window_diagonal;
 
-  glUniform1f(
-    glGetUniformLocation(ShaderProgram::currentProgramId(),
-      "inv_focal_ratio_in_pixels"),
+  ShaderProgram::current().setUniform(uniform_inv_focal_ratio_in_pixels,
     inv_focal_ratio_in_pixels);
 
-  sample_buffer.bindTextures();
-  _post_process_fbo_quad->bindTextures();
-  _geometry_fbo_quad->bindTextures();
-
-  sample_buffer.render();
-  
-  sample_buffer.freeTextureUnits();
-  _post_process_fbo_quad->freeTextureUnits();
-  _geometry_fbo_quad->freeTextureUnits();
+  context.bindSamplers();
+  _quad_mesh->render();
 
   _post_process_program->popUsage();
-
-  output_buffer.unbindFBO();
 }
 
 
 void DeferredShadingRenderer::renderPostProcessMotionBlur(
-  FrameBufferQuad& sample_fbo_quad, FrameBufferQuad& output_buffer)
+  const RenderGraph::PassContext& context)
 {
-  // Perform post processing, rendering to final buffer
-  output_buffer.bindFBO();
-  glViewport(0,0,
-    output_buffer.width(),
-    output_buffer.height());
-  glEnable(GL_DEPTH_TEST);
-  glDepthMask(GL_TRUE);
-  glDepthFunc(GL_LEQUAL);
+  setRenderViewport(context.size());
+  GLState::enable(GL_DEPTH_TEST);
+  GLState::depthMask(GL_TRUE);
+  GLState::depthFunc(GL_LEQUAL);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
   _motion_blur_program->pushUsage();
 
-  glUniform2i(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "window_size"),
-    output_buffer.width(),
-    output_buffer.height());
-
-  glm::mat4 P_inv = glm::inverse(_camera.projectionTransform());
-  glUniformMatrix4fv(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "P_inv"), 1, GL_FALSE,
-    &P_inv[0][0]);
-
-  glm::mat4 transform_view_to_prev_screen =
-    _camera.projectionTransform() *
-    _camera_previous_view_transform *
-    glm::inverse(_camera.viewTransform());
+  ShaderProgram::current().setUniform(uniform_window_size,
+    glm::ivec2(context.size()));
 
-  glUniformMatrix4fv(
-    glGetUniformLocation(ShaderProgram::currentProgramId(),
-      "transform_view_to_prev_screen"), 1, GL_FALSE,
-    &transform_view_to_prev_screen[0][0]);
-
-  _camera_previous_view_transform = _camera.viewTransform();
-  
-  sample_fbo_quad.bindTextures();
-  _geometry_fbo_quad->bindTextures();
-
-  sample_fbo_quad.render();
-  
-  sample_fbo_quad.freeTextureUnits();
-  _geometry_fbo_quad->freeTextureUnits();
+  context.bindSamplers();
+  _quad_mesh->render();
   
   _motion_blur_program->popUsage();
   
   // Back to default
-  glDepthFunc(GL_LESS);
-  output_buffer.unbindFBO();
+  GLState::depthFunc(GL_LESS);
 }
 
 void DeferredShadingRenderer::renderToScreen(
-  FrameBufferQuad& sample_fbo_quad, int attachment)
+  const RenderGraph::PassContext& context)
 {
-  glViewport(0,0, _window_width, _window_height);
-  glDisable(GL_BLEND);
-  glDisable(GL_DEPTH_TEST);
+  GLState::viewport(0,0, _window_width, _window_height);
+  GLState::disable(GL_BLEND);
+  GLState::disable(GL_DEPTH_TEST);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   _final_pass_through_program->pushUsage();
-  glUniform2i(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "window_size"),
-    _window_width, _window_height);
+  ShaderProgram::current().setUniform(uniform_window_size,
+    glm::ivec2(_window_width, _window_height));
+  ShaderProgram::current().setUniform(uniform_render_scale,
+    glm::vec2(renderSize(_framebuffer_size)) / glm::vec2(_framebuffer_size));
   
-  std::vector<FrameBufferQuad::RenderTextureInfo> render_texture_info;
-  render_texture_info.push_back(
-  {
-    attachment, // Attachment 
-    "pixel_buffer" // Shader name
-  });
-  sample_fbo_quad.bindTextures(render_texture_info);
-  sample_fbo_quad.render();
-  sample_fbo_quad.freeTextureUnits();
+  context.bindSamplers();
+  _quad_mesh->render();
   _final_pass_through_program->popUsage();
 }
 
 void DeferredShadingRenderer::forwardRenderIndependentRenderables(
-  FrameBufferQuad& final_buffer)
+  const RenderGraph::PassContext& context)
 {
-  final_buffer.bindFBO();
-  glViewport(0,0,
-    final_buffer.width(),
-    final_buffer.height());
-  glEnable(GL_DEPTH_TEST);
-  glDepthMask(GL_TRUE);
-  glDisable(GL_BLEND);
-
-  for (auto renderable : _renderables_forward_to_render)
-    renderable->render({ _camera });
-  _renderables_forward_to_render.clear();  
-  
-  final_buffer.unbindFBO();
+  setRenderViewport(context.size());
+  GLState::enable(GL_DEPTH_TEST);
+  GLState::depthMask(GL_TRUE);
+  GLState::disable(GL_BLEND);
+
+  _render_queue.render(RenderPass::Forward, { _camera });
 }
 
-void DeferredShadingRenderer::renderPointLights()
+void DeferredShadingRenderer::renderPointLights(
+  const RenderGraph::PassContext& context)
 {
+  gatherPointLights();
+  if (_point_light_instances.empty())
+    return;
+  if (_point_light_shading == PointLightShading::Clustered)
+  {
+    renderClusteredPointLights(context);
+    return;
+  }
+  if (_point_light_shading == PointLightShading::TiledCompute)
+  {
+    renderTiledPointLights(context);
+    return;
+  }
+
+  // If the camera is inside the volume of a light, render a full quad for
+  // it. Otherwise just render the light sphere
+  auto first_outside = std::partition(
+    _point_light_instances.begin(), _point_light_instances.end(),
+    [](const PointLightInstance& light) {
+      return glm::length(glm::vec3(light.position_and_radius)) <
+        light.position_and_radius.w;
+    });
+  GLsizei n_inside =
+    static_cast<GLsizei>(first_outside - _point_light_instances.begin());
+  GLsizei n_outside =
+    static_cast<GLsizei>(_point_light_instances.size()) - n_inside;
+
+  _point_light_buffer->beginFrame();
+  GLintptr offset = _point_light_buffer->write(
+    _point_light_instances.data(),
+    sizeof(PointLightInstance) * _point_light_instances.size(),
+    sizeof(glm::vec4));
+
   _shading_program_point_lights->pushUsage();
-  glUniformMatrix4fv(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "P_frag"), 1, GL_FALSE,
-    &_camera.projectionTransform()[0][0]);
-  
-  _geometry_fbo_quad->bindTextures();
+  context.bindSamplers();
+  drawPointLightInstances(*_quad_mesh, false, offset, n_inside);
+  drawPointLightInstances(*_light_sphere_mesh, true,
+    offset + n_inside * sizeof(PointLightInstance), n_outside);
+  _shading_program_point_lights->popUsage();
+}
+
+void DeferredShadingRenderer::gatherPointLights()
+{
+  // Positions in view space and volumes of all lights, in one pass
+  const glm::mat4& view_transform = _camera.viewTransform();
+  _point_light_instances.clear();
   for (auto it : _point_light_sources_to_render)
   {
-    it->render({ _camera });
+    _point_light_instances.push_back(PointLightSource::instance(
+      view_transform, it->absoluteTransform(), it->color(), it->radiantFlux()));
   }
-  _geometry_fbo_quad->freeTextureUnits();
   _point_light_sources_to_render.clear();
-  _shading_program_point_lights->popUsage();
+  if (_entity_registry)
+  {
+    const auto& lights = _entity_registry->pointLights();
+    for (auto i : _entity_point_lights_to_render)
+    {
+      _point_light_instances.push_back(PointLightSource::instance(
+        view_transform, _entity_registry->worldTransform(lights, i),
+        lights[i].color, lights[i].radiant_flux));
+    }
+  }
+  _entity_point_lights_to_render.clear();
+}
+
+void DeferredShadingRenderer::renderClusteredPointLights(
+  const RenderGraph::PassContext& context)
+{
+  _light_cluster_grid.update(_camera);
+  _light_cluster_grid.assign(_point_light_instances);
+  const auto& clusters = _light_cluster_grid.clusters();
+  const auto& light_indices = _light_cluster_grid.lightIndices();
+
+  GLint light_offset = _light_texture_buffer->update(
+    _point_light_instances.data(),
+    sizeof(PointLightInstance) * _point_light_instances.size());
+  GLint cluster_offset = _cluster_buffer->update(
+    clusters.data(), sizeof(LightCluster) * clusters.size());
+  // Buffer textures can not be empty
+  GLuint no_lights = 0;
+  GLint light_index_offset = light_indices.empty() ?
+    _cluster_light_index_buffer->update(&no_lights, sizeof(GLuint)) :
+    _cluster_light_index_buffer->update(
+      light_indices.data(), sizeof(GLuint) * light_indices.size());
+
+  _shading_program_clustered_point_lights->pushUsage();
+  context.bindSamplers();
+  TextureUnit light_unit, cluster_unit, light_index_unit;
+  light_unit.activate();
+  _light_texture_buffer->bind();
+  cluster_unit.activate();
+  _cluster_buffer->bind();
+  light_index_unit.activate();
+  _cluster_light_index_buffer->bind();
+
+  ShaderProgram& program = ShaderProgram::current();
+  program.setUniform(uniform_light_buffer, light_unit.unitNumber());
+  program.setUniform(uniform_cluster_buffer, cluster_unit.unitNumber());
+  program.setUniform(uniform_light_index_buffer, light_index_unit.unitNumber());
+  program.setUniform(uniform_light_buffer_offset, light_offset);
+  program.setUniform(uniform_cluster_buffer_offset, cluster_offset);
+  program.setUniform(uniform_light_index_buffer_offset, light_index_offset);
+  program.setUniform(uniform_cluster_dimensions,
+    glm::ivec3(_light_cluster_grid.dimensions()));
+  program.setUniform(uniform_cluster_near, _light_cluster_grid.near());
+  program.setUniform(uniform_cluster_far, _light_cluster_grid.far());
+
+  _quad_mesh->render();
+  _shading_program_clustered_point_lights->popUsage();
+}
+
+void DeferredShadingRenderer::renderTiledPointLights(
+  const RenderGraph::PassContext& context)
+{
+  GLint light_offset = _light_texture_buffer->update(
+    _point_light_instances.data(),
+    sizeof(PointLightInstance) * _point_light_instances.size());
+
+  _shading_program_tiled_point_lights->pushUsage();
+  context.bindSamplers();
+  TextureUnit light_unit;
+  light_unit.activate();
+  _light_texture_buffer->bind();
+
+  ShaderProgram& program = ShaderProgram::current();
+  program.setUniform(uniform_light_buffer, light_unit.unitNumber());
+  program.setUniform(uniform_light_buffer_offset, light_offset);
+  program.setUniform(uniform_n_lights,
+    static_cast<int>(_point_light_instances.size()));
+  // The light buffer is read and written as image, its format is fixed in
+  // the shader
+  glBindImageTexture(0, context.texture("irradiance")->id(),
+    0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+  program.setUniform(uniform_radiance_image, 0);
+
+  glm::ivec2 render_size = renderSize(context.size());
+  glDispatchCompute(
+    (render_size.x + light_tile_size - 1) / light_tile_size,
+    (render_size.y + light_tile_size - 1) / light_tile_size,
+    1);
+  // The following light passes blend into the light buffer and later
+  // passes sample it
+  glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+  _shading_program_tiled_point_lights->popUsage();
 }
 
-void DeferredShadingRenderer::renderDirectionalLights()
+void DeferredShadingRenderer::drawPointLightInstances(
+  Mesh& mesh, bool light_volume, GLintptr offset, GLsizei n_lights)
+{
+  if (n_lights == 0)
+    return;
+  ShaderProgram::current().setUniform(
+    uniform_light_volume, light_volume ? 1 : 0);
+  mesh.bind();
+  _point_light_buffer->bind();
+  for (GLuint i = 0; i < 2; ++i)
+  {
+    glEnableVertexAttribArray(first_point_light_attribute + i);
+    glVertexAttribPointer(
+      first_point_light_attribute + i,
+      4,
+      GL_FLOAT,
+      GL_FALSE,
+      sizeof(PointLightInstance),
+      reinterpret_cast<void*>(offset + i * sizeof(glm::vec4)));
+    glVertexAttribDivisor(first_point_light_attribute + i, 1);
+  }
+  mesh.drawInstanced(n_lights);
+  // The meshes are also drawn without instancing
+  for (GLuint i = 0; i < 2; ++i)
+    glDisableVertexAttribArray(first_point_light_attribute + i);
+  mesh.unbind();
+}
+
+void DeferredShadingRenderer::renderDirectionalLights(
+  const RenderGraph::PassContext& context)
 {
   _shading_program_directional_lights->pushUsage();
-  glUniformMatrix4fv(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "P_frag"), 1, GL_FALSE,
-    &_camera.projectionTransform()[0][0]);
-  _geometry_fbo_quad->bindTextures();
+  context.bindSamplers();
   for (auto it : _directional_light_sources_to_render)
   {
     it->render({ _camera });
   }
-  _geometry_fbo_quad->freeTextureUnits();
+  if (_entity_registry)
+  {
+    const auto& lights = _entity_registry->directionalLights();
+    for (auto i : _entity_directional_lights_to_render)
+    {
+      DirectionalLightSource::render({ _camera },
+        _entity_registry->worldTransform(lights, i),
+        lights[i].color, lights[i].radiance, *_quad_mesh);
+    }
+  }
+  _entity_directional_lights_to_render.clear();
   _directional_light_sources_to_render.clear();
   _shading_program_directional_lights->popUsage();
 }
 
-void DeferredShadingRenderer::renderDiffuseEnvironmentLights()
+void DeferredShadingRenderer::renderDiffuseEnvironmentLights(
+  const RenderGraph::PassContext& context)
 {
   _shading_program_environment_diffuse->pushUsage();
-  glm::mat3 V_inv = glm::mat3(_camera.absoluteTransform());
-  glUniformMatrix3fv(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "V_inv"),
-    1,
-    GL_FALSE,
-    &V_inv[0][0]);
-  glUniform1i(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "cube_map_size"),
+  ShaderProgram::current().setUniform(uniform_cube_map_size,
     _sky_box->textureSize());
 
-  _geometry_fbo_quad->bindTextures();
+  context.bindSamplers();
   _sky_box->render();
-  _geometry_fbo_quad->freeTextureUnits();
   _shading_program_environment_diffuse->popUsage();
 }
 
-void DeferredShadingRenderer::renderSkyBox()
+void DeferredShadingRenderer::renderSkyBox(
+  const RenderGraph::PassContext& context)
 {
   _cube_map_program->pushUsage();
-  _geometry_fbo_quad->bindTextures();
-    glDisable(GL_CULL_FACE);
-
-  glUniformMatrix4fv(
-      glGetUniformLocation(ShaderProgram::currentProgramId(), "V"),
-      1,
-      GL_FALSE,
-      &_camera.viewTransform()[0][0]);
-  glUniformMatrix4fv(
-      glGetUniformLocation(ShaderProgram::currentProgramId(), "P"),
-      1,
-      GL_FALSE,
-      &_camera.projectionTransform()[0][0]);
+  context.bindSamplers();
+    GLState::disable(GL_CULL_FACE);
 
   _sky_box->render();
-  _geometry_fbo_quad->freeTextureUnits();
-  glEnable(GL_CULL_FACE);
+  GLState::enable(GL_CULL_FACE);
   _cube_map_program->popUsage();
 }
 
 void DeferredShadingRenderer::renderScreenSpaceReflections(
-  FrameBufferQuad& sample_buffer)
+  const RenderGraph::PassContext& context)
 {
   _shading_program_reflections->pushUsage();
-  glUniformMatrix4fv(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "P_frag"), 1, GL_FALSE,
-    &_camera.projectionTransform()[0][0]);
-
-  glm::mat3 V_inv = glm::mat3(_camera.absoluteTransform());
-  glUniformMatrix3fv(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "V_inv"),
-    1,
-    GL_FALSE,
-    &V_inv[0][0]);
-  glUniform1i(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "cube_map_size"),
+  ShaderProgram::current().setUniform(uniform_cube_map_size,
     _sky_box->textureSize());
 
-  sample_buffer.bindTextures();
-  _geometry_fbo_quad->bindTextures();
+  context.bindSamplers();
   _sky_box->render();
-  sample_buffer.freeTextureUnits();
-  _geometry_fbo_quad->freeTextureUnits();
   _shading_program_reflections->popUsage();
 }
 
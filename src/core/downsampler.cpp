@@ -0,0 +1,108 @@
+#include "elk/core/downsampler.h"
+
+#include "elk/core/gl_state.h"
+#include "elk/core/texture_unit.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace elk { namespace core {
+
+namespace {
+  const UniformName uniform_source("source");
+  const UniformName uniform_n_levels("n_levels");
+
+  // Texels of level 0 reduced by one work group, in each dimension
+  const GLuint tile_size = 64;
+  // Counter of finished work groups before the tile texels
+  const GLsizeiptr buffer_header_size = 4 * sizeof(GLuint);
+}
+
+Downsampler::Downsampler() :
+  _program(new ShaderProgram(
+    "downsampler",
+    (std::string(ELK_DIR) + "/shaders/downsample.comp").c_str())),
+  _tile_buffer(0),
+  _tile_capacity(0)
+{
+  glGenBuffers(1, &_tile_buffer);
+}
+
+Downsampler::~Downsampler()
+{
+  GLState::deleteBuffer(_tile_buffer);
+}
+
+void Downsampler::generate(
+  const Texture& texture,
+  GLenum internal_format,
+  glm::uvec2 region,
+  int levels)
+{
+  levels = std::min(levels, max_levels);
+  if (levels < 1 || region.x == 0 || region.y == 0)
+    return;
+  glm::uvec2 n_groups = (region + tile_size - 1u) / tile_size;
+  reserveTiles(static_cast<GLsizeiptr>(n_groups.x) * n_groups.y);
+
+  _program->pushUsage();
+  TextureUnit unit;
+  unit.activate();
+  texture.bind();
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels);
+  ShaderProgram::current().setUniform(uniform_source, unit.unitNumber());
+  ShaderProgram::current().setUniform(uniform_n_levels, levels);
+
+  // Image units 0 to levels - 1 are fixed in the shader
+  for (int i = 0; i < levels; ++i)
+  {
+    glBindImageTexture(static_cast<GLuint>(i), texture.id(),
+      i + 1, GL_FALSE, 0, GL_WRITE_ONLY, internal_format);
+  }
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _tile_buffer);
+
+  glDispatchCompute(n_groups.x, n_groups.y, 1);
+  // Later passes sample the levels, the next dispatch reuses the counter
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+  _program->popUsage();
+}
+
+bool Downsampler::supported()
+{
+  return ShaderProgram::computeShadersSupported();
+}
+
+bool Downsampler::supportsFormat(GLenum internal_format)
+{
+  // Formats of the image load store table with four channels. Three channel
+  // formats can not be bound as image
+  switch (internal_format)
+  {
+  case GL_RGBA8:
+  case GL_RGBA16:
+  case GL_RGBA16F:
+  case GL_RGBA32F:
+    return true;
+  default:
+    return false;
+  }
+}
+
+void Downsampler::reserveTiles(GLsizeiptr n_tiles)
+{
+  if (n_tiles <= _tile_capacity)
+    return;
+  _tile_capacity = n_tiles;
+  // The last work group alternates between two levels of tile texels. The
+  // counter has to start at zero
+  std::vector<GLfloat> zeros(
+    (buffer_header_size + 2 * n_tiles * 4 * sizeof(GLfloat)) / sizeof(GLfloat),
+    0.0f);
+  GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, _tile_buffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,
+    zeros.size() * sizeof(GLfloat), zeros.data(), GL_DYNAMIC_COPY);
+}
+
+} }
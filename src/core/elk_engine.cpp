@@ -1,10 +1,15 @@
 #include "elk/core/elk_engine.h"
 
+#include <algorithm>
+
 namespace elk { namespace core {
 
 ElkEngine::ElkEngine() :
   perspective_camera(1.0, 0.01, 100),
-  viewspace_ortho_camera(-1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f)
+  viewspace_ortho_camera(-1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f),
+  _use_flat_transform_hierarchy(false),
+  _n_updated_transforms(0),
+  _update_mode(UpdateMode::Serial)
 {
   if (!_initializeGL())
   {
@@ -33,18 +38,85 @@ bool ElkEngine::_initializeGL()
 
 void ElkEngine::update(double dt)
 {
+  // Jobs that need the OpenGL context
+  _job_system.runMainThreadJobs();
+
   // Call update for all objects
-  scene.update(dt);
-  view_space.update(dt);
-  background_space.update(dt);
+  updateObjects(scene, dt);
+  updateObjects(view_space, dt);
+  updateObjects(background_space, dt);
 
-  // Update all transforms
-  perspective_camera.updateTransform(glm::mat4());
-  viewspace_ortho_camera.updateTransform(glm::mat4());
+  // Update all transforms that changed since last frame. Cameras that are
+  // part of a scene are updated together with it
+  _n_updated_transforms = 0;
+  if (!perspective_camera.parent())
+    _n_updated_transforms += perspective_camera.updateDirtyTransforms(glm::mat4());
+  if (!viewspace_ortho_camera.parent())
+    _n_updated_transforms += viewspace_ortho_camera.updateDirtyTransforms(glm::mat4());
+
+  if (_use_flat_transform_hierarchy)
+  {
+    _n_updated_transforms += updateFlatTransforms(scene, _scene_transforms);
+    _n_updated_transforms += updateFlatTransforms(view_space, _view_space_transforms);
+    _n_updated_transforms +=
+      updateFlatTransforms(background_space, _background_space_transforms);
+  }
+  else
+  {
+    _n_updated_transforms += scene.updateDirtyTransforms(glm::mat4());
+    _n_updated_transforms += view_space.updateDirtyTransforms(glm::mat4());
+    _n_updated_transforms += background_space.updateDirtyTransforms(glm::mat4());
+  }
 
-  scene.updateTransform(glm::mat4());
-  view_space.updateTransform(glm::mat4());
-  background_space.updateTransform(glm::mat4());
+  // Entities attached to nodes follow the absolute transforms updated above
+  entities.updateTransforms();
+}
+
+unsigned int ElkEngine::updateFlatTransforms(
+  Object3D& root, TransformHierarchy& hierarchy)
+{
+  if (hierarchy.needsRebuild() || hierarchy.root() != &root)
+  {
+    hierarchy.build(root);
+    hierarchy.update();
+    return hierarchy.size();
+  }
+  return hierarchy.updateDirty();
+}
+
+void ElkEngine::updateObjects(Object3D& root, double dt)
+{
+  const std::vector<Object3D*>& subtrees = root.children();
+  if (_update_mode == UpdateMode::Serial || subtrees.size() < 2)
+  {
+    root.update(dt);
+    return;
+  }
+
+  // Batch the subtrees so that there are a few batches per thread
+  size_t n_threads = _job_system.numberOfWorkers() + 1;
+  size_t batch_size = std::max(subtrees.size() / (4 * n_threads), size_t(1));
+  _job_system.parallelFor(0, subtrees.size(), batch_size,
+    [&subtrees, dt](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        subtrees[i]->update(dt);
+    });
+}
+
+void ElkEngine::setUpdateMode(UpdateMode mode)
+{
+  _update_mode = mode;
+}
+
+void ElkEngine::setUseFlatTransformHierarchy(bool use)
+{
+  _use_flat_transform_hierarchy = use;
+  if (!use)
+  {
+    _scene_transforms.clear();
+    _view_space_transforms.clear();
+    _background_space_transforms.clear();
+  }
 }
 
 PerspectiveCamera& ElkEngine::camera()
@@ -57,4 +129,9 @@ OrthoCamera& ElkEngine::viewSpaceCamera()
   return viewspace_ortho_camera;
 }
 
+JobSystem& ElkEngine::jobSystem()
+{
+  return _job_system;
+}
+
 } }
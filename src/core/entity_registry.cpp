@@ -0,0 +1,186 @@
+#include "elk/core/entity_registry.h"
+
+#include "elk/core/object_3d.h"
+#include "elk/core/mesh.h"
+#include "elk/core/material.h"
+#include "elk/object_extensions/light_source.h"
+#include "elk/object_extensions/renderable_model.h"
+
+namespace elk { namespace core {
+
+EntityRegistry::EntityRegistry() :
+  _structure_version(0),
+  _bounds_structure_version(0)
+{ }
+
+EntityRegistry::~EntityRegistry()
+{ }
+
+Entity EntityRegistry::create()
+{
+  uint32_t index;
+  if (_free_indices.empty())
+  {
+    index = static_cast<uint32_t>(_generations.size());
+    _generations.push_back(0);
+  }
+  else
+  {
+    index = _free_indices.back();
+    _free_indices.pop_back();
+  }
+  _transforms.insert(index, { glm::mat4() });
+  return { index, _generations[index] };
+}
+
+Entity EntityRegistry::create(const RenderableModel& model)
+{
+  Entity entity = create();
+  setTransform(entity, model.absoluteTransform());
+  setMesh(entity, model.mesh());
+  setMaterial(entity, model.material());
+  return entity;
+}
+
+Entity EntityRegistry::create(const PointLightSource& light_source)
+{
+  Entity entity = create();
+  setTransform(entity, light_source.absoluteTransform());
+  setPointLight(entity, light_source.color(), light_source.radiantFlux());
+  return entity;
+}
+
+Entity EntityRegistry::create(const DirectionalLightSource& light_source)
+{
+  Entity entity = create();
+  setTransform(entity, light_source.absoluteTransform());
+  setDirectionalLight(entity, light_source.color(), light_source.radiance());
+  return entity;
+}
+
+void EntityRegistry::destroy(Entity entity)
+{
+  if (!isAlive(entity))
+    return;
+  if (_meshes.contains(entity.index) || _point_lights.contains(entity.index))
+    _structure_version++;
+  _transforms.erase(entity.index);
+  _meshes.erase(entity.index);
+  _materials.erase(entity.index);
+  _point_lights.erase(entity.index);
+  _directional_lights.erase(entity.index);
+  _scene_nodes.erase(entity.index);
+  _generations[entity.index]++;
+  _free_indices.push_back(entity.index);
+}
+
+bool EntityRegistry::isAlive(Entity entity) const
+{
+  return
+    entity.index < _generations.size() &&
+    _generations[entity.index] == entity.generation &&
+    _transforms.contains(entity.index);
+}
+
+void EntityRegistry::clear()
+{
+  for (uint32_t i = 0; i < _generations.size(); ++i)
+    destroy({ i, _generations[i] });
+}
+
+void EntityRegistry::setTransform(Entity entity, const glm::mat4& world)
+{
+  if (!isAlive(entity))
+    return;
+  _transforms.find(entity.index)->world = world;
+}
+
+void EntityRegistry::setMesh(Entity entity, std::shared_ptr<Mesh> mesh)
+{
+  if (!isAlive(entity))
+    return;
+  _meshes.insert(entity.index, { mesh, mesh->boundingBox() });
+  _structure_version++;
+}
+
+void EntityRegistry::setMaterial(
+  Entity entity, std::shared_ptr<Material> material)
+{
+  if (!isAlive(entity))
+    return;
+  _materials.insert(entity.index, { material });
+}
+
+void EntityRegistry::setPointLight(
+  Entity entity, const glm::vec3& color, float radiant_flux)
+{
+  if (!isAlive(entity))
+    return;
+  _point_lights.insert(entity.index, { color, radiant_flux });
+  _structure_version++;
+}
+
+void EntityRegistry::setDirectionalLight(
+  Entity entity, const glm::vec3& color, float radiance)
+{
+  if (!isAlive(entity))
+    return;
+  _directional_lights.insert(entity.index, { color, radiance });
+}
+
+void EntityRegistry::attachToNode(Entity entity, Object3D& node)
+{
+  if (!isAlive(entity))
+    return;
+  _scene_nodes.insert(entity.index, { &node });
+}
+
+void EntityRegistry::detachFromNode(Entity entity)
+{
+  if (!isAlive(entity))
+    return;
+  _scene_nodes.erase(entity.index);
+}
+
+void EntityRegistry::updateTransforms()
+{
+  for (size_t i = 0; i < _scene_nodes.size(); ++i)
+  {
+    _transforms.find(_scene_nodes.entity(i))->world =
+      _scene_nodes[i].node->absoluteTransform();
+  }
+
+  // Rebuilt every frame, the dense arrays may have been reordered
+  _mesh_world_bounding_boxes.clear();
+  for (size_t i = 0; i < _meshes.size(); ++i)
+  {
+    _mesh_world_bounding_boxes.add(_meshes[i].local_bounding_box.transformed(
+      worldTransform(_meshes, i)));
+  }
+  _point_light_world_bounding_boxes.clear();
+  for (size_t i = 0; i < _point_lights.size(); ++i)
+  {
+    float radius = PointLightSource::radius(_point_lights[i].radiant_flux);
+    _point_light_world_bounding_boxes.add(
+      BoundingBox(glm::vec3(-radius), glm::vec3(radius)).transformed(
+        worldTransform(_point_lights, i)));
+  }
+  _bounds_structure_version = _structure_version;
+}
+
+void EntityRegistry::cull(
+  const Frustum& frustum,
+  std::vector<unsigned char>& visible_meshes,
+  std::vector<unsigned char>& visible_point_lights) const
+{
+  if (_bounds_structure_version != _structure_version)
+  {
+    visible_meshes.assign(_meshes.size(), 1);
+    visible_point_lights.assign(_point_lights.size(), 1);
+    return;
+  }
+  _mesh_world_bounding_boxes.intersects(frustum, visible_meshes);
+  _point_light_world_bounding_boxes.intersects(frustum, visible_point_lights);
+}
+
+} }
@@ -1,5 +1,7 @@
 #include "elk/core/frame_buffer_object.h"
 
+#include "elk/core/gl_state.h"
+
 #include <gl/glew.h>
 
 #include <iostream>
@@ -13,22 +15,24 @@ FrameBufferObject::FrameBufferObject()
 
 FrameBufferObject::~FrameBufferObject()
 {
-  glDeleteFramebuffers(1, &_id);
+  GLState::deleteFramebuffer(_id);
 }
 
 void FrameBufferObject::bind()
 {
-  glBindFramebuffer(GL_FRAMEBUFFER, _id);
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, _id);
 }
 
 void FrameBufferObject::unbind()
 {
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void FrameBufferObject::attach2DTexture(
   GLuint texture_id, GLint attachment, GLint level)
 {
+  // Restores the frame buffer bound before
+  GLuint previous = GLState::framebuffer();
   bind();
   glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture_id, level);
   GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
@@ -36,11 +40,12 @@ void FrameBufferObject::attach2DTexture(
   {
     std::cout << "ERROR: Framebuffer not complete! Was texture uploaded?" << std::endl;
   }
-  unbind();
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, previous);
 }
 
 void FrameBufferObject::attachRenderBuffer(GLuint render_buffer_id, GLint attachment)
 {
+  GLuint previous = GLState::framebuffer();
   bind();
   glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, render_buffer_id);
   GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
@@ -48,7 +53,7 @@ void FrameBufferObject::attachRenderBuffer(GLuint render_buffer_id, GLint attach
   {
     std::cout << "ERROR: Framebuffer not complete!" << std::endl;
   }
-  unbind();
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, previous);
 }
 
 } }
@@ -0,0 +1,273 @@
+#include "elk/core/frame_profiler.h"
+
+#include <cstdio>
+#include <utility>
+
+namespace elk { namespace core {
+
+namespace {
+  // Writes \param name as a JSON string
+  void writeJsonString(FILE* file, const std::string& name)
+  {
+    fputc('"', file);
+    for (char c : name)
+    {
+      if (c == '"' || c == '\\')
+        fputc('\\', file);
+      fputc(c, file);
+    }
+    fputc('"', file);
+  }
+
+  // Writes a complete event after the previous one, times in seconds
+  void writeTraceEvent(
+    FILE* file, const std::string& name, const char* category, int thread,
+    double begin, double duration)
+  {
+    fprintf(file, ",\n  {\"name\": ");
+    writeJsonString(file, name);
+    fprintf(file,
+      ", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, "
+      "\"ts\": %.3f, \"dur\": %.3f}",
+      category, thread, begin * 1e6, duration * 1e6);
+  }
+
+  float average(const std::vector<float>& samples)
+  {
+    if (samples.empty())
+      return 0.0f;
+    float sum = 0.0f;
+    for (float sample : samples)
+      sum += sample;
+    return sum / samples.size();
+  }
+}
+
+FrameProfiler::FrameProfiler() :
+  _start_time(std::chrono::steady_clock::now()),
+  _recording(false),
+  _gpu_scope(-1),
+  _gpu_frame_time(0.0f)
+{
+  _frame.cpu_begin = 0.0;
+  _frame.cpu_end = 0.0;
+  _frame.n_queries = 0;
+}
+
+FrameProfiler::~FrameProfiler()
+{
+  releaseQueries(_frame);
+  for (auto& frame : _pending_frames)
+    releaseQueries(frame);
+  for (auto& queries : _free_queries)
+  {
+    if (!queries.empty())
+      glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+  }
+}
+
+bool FrameProfiler::beginFrame()
+{
+  if (_recording)
+    endFrame();
+  // Frames are read in the order they were recorded, the first one that
+  // is not done ends the reading
+  _gpu_frame_times.clear();
+  while (!_pending_frames.empty() && readBack(_pending_frames.front()))
+  {
+    Frame& frame = _pending_frames.front();
+    addToStatistics(frame);
+    _gpu_frame_times.push_back(_gpu_frame_time);
+    releaseQueries(frame);
+    _traced_frames.push_back(std::move(frame));
+    if (_traced_frames.size() > n_traced_frames)
+      _traced_frames.pop_front();
+    _pending_frames.pop_front();
+  }
+  // Only if the GPU does not catch up, the results are given up on
+  while (_pending_frames.size() >= max_pending_frames)
+  {
+    releaseQueries(_pending_frames.front());
+    _pending_frames.pop_front();
+  }
+
+  _frame.scopes.clear();
+  _frame.n_queries = 0;
+  if (!_free_queries.empty())
+  {
+    _frame.queries = std::move(_free_queries.back());
+    _free_queries.pop_back();
+  }
+  _frame.cpu_begin = now();
+  _open_scopes.clear();
+  _gpu_scope = -1;
+  _recording = true;
+  return !_gpu_frame_times.empty();
+}
+
+void FrameProfiler::endFrame()
+{
+  if (!_recording)
+    return;
+  while (!_open_scopes.empty())
+    endScope();
+  _frame.cpu_end = now();
+  _pending_frames.push_back(std::move(_frame));
+  _frame.queries.clear();
+  _frame.scopes.clear();
+  _frame.n_queries = 0;
+  _recording = false;
+}
+
+void FrameProfiler::beginScope(const std::string& name)
+{
+  if (!_recording)
+    return;
+  Frame& frame = _frame;
+  Scope scope = { name, static_cast<int>(_open_scopes.size()),
+    now(), 0.0, -1, 0.0 };
+  if (_gpu_scope == -1)
+  {
+    if (frame.n_queries == frame.queries.size())
+    {
+      GLuint query;
+      glGenQueries(1, &query);
+      frame.queries.push_back(query);
+    }
+    scope.query = static_cast<int>(frame.n_queries++);
+    glBeginQuery(GL_TIME_ELAPSED, frame.queries[scope.query]);
+    _gpu_scope = static_cast<int>(frame.scopes.size());
+  }
+  _open_scopes.push_back(frame.scopes.size());
+  frame.scopes.push_back(scope);
+}
+
+void FrameProfiler::endScope()
+{
+  if (!_recording || _open_scopes.empty())
+    return;
+  Frame& frame = _frame;
+  size_t index = _open_scopes.back();
+  _open_scopes.pop_back();
+  if (static_cast<int>(index) == _gpu_scope)
+  {
+    glEndQuery(GL_TIME_ELAPSED);
+    _gpu_scope = -1;
+  }
+  frame.scopes[index].cpu_end = now();
+}
+
+std::vector<FrameProfiler::ScopeTimes> FrameProfiler::averageTimes() const
+{
+  std::vector<ScopeTimes> times;
+  for (const auto& statistics : _statistics)
+  {
+    times.push_back({ statistics.name,
+      average(statistics.cpu_times), average(statistics.gpu_times) });
+  }
+  return times;
+}
+
+bool FrameProfiler::writeChromeTrace(const std::string& path) const
+{
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file)
+  {
+    fprintf(stderr, "ERROR : Could not write trace file %s\n", path.c_str());
+    return false;
+  }
+  // Names of the CPU and GPU rows
+  fprintf(file, "{\"traceEvents\": [");
+  fprintf(file, "\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, "
+    "\"tid\": 0, \"args\": {\"name\": \"CPU\"}},");
+  fprintf(file, "\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, "
+    "\"tid\": 1, \"args\": {\"name\": \"GPU\"}}");
+  for (const auto& frame : _traced_frames)
+  {
+    writeTraceEvent(file, "frame", "cpu", 0,
+      frame.cpu_begin, frame.cpu_end - frame.cpu_begin);
+    double gpu_time = frame.cpu_begin;
+    for (const auto& scope : frame.scopes)
+    {
+      writeTraceEvent(file, scope.name, "cpu", 0,
+        scope.cpu_begin, scope.cpu_end - scope.cpu_begin);
+      if (scope.query != -1)
+      {
+        writeTraceEvent(file, scope.name, "gpu", 1,
+          gpu_time, scope.gpu_time);
+        gpu_time += scope.gpu_time;
+      }
+    }
+  }
+  fprintf(file, "\n], \"displayTimeUnit\": \"ms\"}\n");
+  fclose(file);
+  return true;
+}
+
+double FrameProfiler::now() const
+{
+  std::chrono::duration<double> time =
+    std::chrono::steady_clock::now() - _start_time;
+  return time.count();
+}
+
+bool FrameProfiler::readBack(Frame& frame)
+{
+  for (size_t i = 0; i < frame.n_queries; ++i)
+  {
+    GLint available = 0;
+    glGetQueryObjectiv(frame.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+      return false;
+  }
+  _gpu_frame_time = 0.0f;
+  for (auto& scope : frame.scopes)
+  {
+    if (scope.query == -1)
+      continue;
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(frame.queries[scope.query], GL_QUERY_RESULT, &elapsed);
+    scope.gpu_time = elapsed * 1e-9;
+    _gpu_frame_time += static_cast<float>(scope.gpu_time);
+  }
+  return true;
+}
+
+void FrameProfiler::releaseQueries(Frame& frame)
+{
+  if (!frame.queries.empty())
+    _free_queries.push_back(std::move(frame.queries));
+  frame.queries.clear();
+  frame.n_queries = 0;
+}
+
+void FrameProfiler::addToStatistics(const Frame& frame)
+{
+  for (const auto& scope : frame.scopes)
+  {
+    auto statistics = _statistics.begin();
+    while (statistics != _statistics.end() && statistics->name != scope.name)
+      ++statistics;
+    if (statistics == _statistics.end())
+    {
+      _statistics.push_back({ scope.name, {}, {}, 0 });
+      statistics = _statistics.end() - 1;
+    }
+    float cpu_time = static_cast<float>(scope.cpu_end - scope.cpu_begin);
+    float gpu_time = static_cast<float>(scope.gpu_time);
+    // Replaces the oldest sample once the window is full
+    if (statistics->cpu_times.size() < n_averaged_frames)
+    {
+      statistics->cpu_times.push_back(cpu_time);
+      statistics->gpu_times.push_back(gpu_time);
+    }
+    else
+    {
+      statistics->cpu_times[statistics->next] = cpu_time;
+      statistics->gpu_times[statistics->next] = gpu_time;
+      statistics->next = (statistics->next + 1) % n_averaged_frames;
+    }
+  }
+}
+
+} }
@@ -0,0 +1,94 @@
+#include "elk/core/frustum.h"
+
+#include "elk/core/camera.h"
+
+namespace elk { namespace core {
+
+Frustum::Frustum()
+{
+  for (int i = 0; i < 6; ++i)
+    _planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+Frustum::Frustum(const glm::mat4& view_projection)
+{
+  // Gribb and Hartmann. glm matrices are column major so row i is
+  // (m[0][i], m[1][i], m[2][i], m[3][i])
+  const glm::mat4& m = view_projection;
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; ++i)
+    rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+  _planes[0] = rows[3] + rows[0];
+  _planes[1] = rows[3] - rows[0];
+  _planes[2] = rows[3] + rows[1];
+  _planes[3] = rows[3] - rows[1];
+  _planes[4] = rows[3] + rows[2];
+  _planes[5] = rows[3] - rows[2];
+
+  // Normalized so that sphere radii can be compared with the distances
+  for (int i = 0; i < 6; ++i)
+    _planes[i] /= glm::length(glm::vec3(_planes[i]));
+}
+
+Frustum::Frustum(const AbstractCamera& camera) :
+  Frustum(camera.projectionTransform() * camera.viewTransform())
+{ }
+
+bool Frustum::intersects(const BoundingBox& box) const
+{
+  if (box.isInfinite())
+    return true;
+  glm::vec3 min = box.min();
+  glm::vec3 max = box.max();
+  for (int i = 0; i < 6; ++i)
+  {
+    // The corner furthest along the plane normal
+    glm::vec3 positive_vertex(
+      _planes[i].x > 0 ? max.x : min.x,
+      _planes[i].y > 0 ? max.y : min.y,
+      _planes[i].z > 0 ? max.z : min.z);
+    if (glm::dot(glm::vec3(_planes[i]), positive_vertex) + _planes[i].w < 0)
+      return false;
+  }
+  return true;
+}
+
+Frustum::Intersection Frustum::classify(const BoundingBox& box) const
+{
+  if (box.isInfinite())
+    return Intersection::Intersecting;
+  glm::vec3 min = box.min();
+  glm::vec3 max = box.max();
+  Intersection result = Intersection::Inside;
+  for (int i = 0; i < 6; ++i)
+  {
+    glm::vec3 normal(_planes[i]);
+    glm::vec3 positive_vertex(
+      normal.x > 0 ? max.x : min.x,
+      normal.y > 0 ? max.y : min.y,
+      normal.z > 0 ? max.z : min.z);
+    if (glm::dot(normal, positive_vertex) + _planes[i].w < 0)
+      return Intersection::Outside;
+    // The closest corner is behind the plane, the box crosses it
+    glm::vec3 negative_vertex(
+      normal.x > 0 ? min.x : max.x,
+      normal.y > 0 ? min.y : max.y,
+      normal.z > 0 ? min.z : max.z);
+    if (glm::dot(normal, negative_vertex) + _planes[i].w < 0)
+      result = Intersection::Intersecting;
+  }
+  return result;
+}
+
+bool Frustum::intersects(const glm::vec3& center, float radius) const
+{
+  for (int i = 0; i < 6; ++i)
+  {
+    if (glm::dot(glm::vec3(_planes[i]), center) + _planes[i].w < -radius)
+      return false;
+  }
+  return true;
+}
+
+} }
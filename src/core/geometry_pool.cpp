@@ -0,0 +1,290 @@
+#include "elk/core/geometry_pool.h"
+
+#include "elk/core/mesh.h"
+#include "elk/core/streaming_buffer.h"
+#include "elk/core/gl_state.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace elk { namespace core {
+
+namespace {
+  // Floats per vertex of the position, normal, uv and tangent buffers
+  const GLint attribute_sizes[4] = { 3, 3, 2, 3 };
+
+  // Replaces the buffer \param buffer by one of \param new_size bytes holding
+  // the first \param old_size bytes of the old one
+  void reallocateBuffer(GLuint& buffer, GLsizeiptr old_size, GLsizeiptr new_size)
+  {
+    GLuint new_buffer;
+    glGenBuffers(1, &new_buffer);
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, new_size, nullptr, GL_STATIC_DRAW);
+    if (buffer)
+    {
+      GLState::bindBuffer(GL_COPY_READ_BUFFER, buffer);
+      glCopyBufferSubData(
+        GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_size);
+      GLState::deleteBuffer(buffer);
+    }
+    buffer = new_buffer;
+  }
+
+  // Uploads \param n_vertices vertices of \param data, or zeros if nullptr
+  template <typename T>
+  void uploadVertices(
+    GLuint buffer, GLuint first_vertex, size_t n_vertices,
+    const std::vector<T>* data)
+  {
+    std::vector<T> zeros;
+    if (!data)
+    {
+      zeros.resize(n_vertices, T(0));
+      data = &zeros;
+    }
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferSubData(
+      GL_COPY_WRITE_BUFFER,
+      first_vertex * sizeof(T),
+      n_vertices * sizeof(T),
+      data->data());
+  }
+}
+
+GeometryPool::RangeAllocator::RangeAllocator(GLuint capacity) :
+  _capacity(capacity)
+{
+  if (capacity > 0)
+    _free_ranges[0] = capacity;
+}
+
+bool GeometryPool::RangeAllocator::allocate(GLuint size, GLuint& offset)
+{
+  for (auto it = _free_ranges.begin(); it != _free_ranges.end(); ++it)
+  {
+    if (it->second < size)
+      continue;
+    offset = it->first;
+    GLuint remaining = it->second - size;
+    _free_ranges.erase(it);
+    if (remaining > 0)
+      _free_ranges[offset + size] = remaining;
+    return true;
+  }
+  return false;
+}
+
+void GeometryPool::RangeAllocator::free(GLuint offset, GLuint size)
+{
+  if (size == 0)
+    return;
+  auto next = _free_ranges.lower_bound(offset);
+  if (next != _free_ranges.end() && offset + size == next->first)
+  {
+    size += next->second;
+    next = _free_ranges.erase(next);
+  }
+  if (next != _free_ranges.begin())
+  {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == offset)
+    {
+      previous->second += size;
+      return;
+    }
+  }
+  _free_ranges[offset] = size;
+}
+
+void GeometryPool::RangeAllocator::grow(GLuint capacity)
+{
+  if (capacity <= _capacity)
+    return;
+  free(_capacity, capacity - _capacity);
+  _capacity = capacity;
+}
+
+GeometryPool::GeometryPool(GLuint vertex_capacity, GLuint index_capacity) :
+  _vertices(vertex_capacity),
+  _indices(index_capacity),
+  _vertex_array(0),
+  _vertex_buffers{ 0, 0, 0, 0 },
+  _index_buffer(0)
+{
+  glGenVertexArrays(1, &_vertex_array);
+  allocateVertexBuffers(vertex_capacity);
+  allocateIndexBuffer(index_capacity);
+  setupVertexArray();
+}
+
+GeometryPool::~GeometryPool()
+{
+  for (auto mesh : _meshes)
+    mesh->_geometry_pool = nullptr;
+  GLState::deleteVertexArray(_vertex_array);
+  for (auto buffer : _vertex_buffers)
+    GLState::deleteBuffer(buffer);
+  GLState::deleteBuffer(_index_buffer);
+}
+
+bool GeometryPool::add(Mesh& mesh)
+{
+  if (mesh._geometry_pool)
+    return mesh._geometry_pool == this;
+  // Unindexed meshes, other primitives and meshes with vertex colors keep
+  // their own buffers
+  if (!mesh._elements || mesh._elements->empty() ||
+      mesh._render_mode != GL_TRIANGLES || mesh._colors)
+    return false;
+
+  GLuint n_vertices = static_cast<GLuint>(mesh._positions->size());
+  GLuint n_indices = static_cast<GLuint>(mesh._elements->size());
+  GLuint base_vertex, first_index;
+  if (!_vertices.allocate(n_vertices, base_vertex))
+  {
+    GLuint capacity = std::max(
+      2 * _vertices.capacity(), _vertices.capacity() + n_vertices);
+    allocateVertexBuffers(capacity);
+    _vertices.grow(capacity);
+    setupVertexArray();
+    _vertices.allocate(n_vertices, base_vertex);
+  }
+  if (!_indices.allocate(n_indices, first_index))
+  {
+    GLuint capacity = std::max(
+      2 * _indices.capacity(), _indices.capacity() + n_indices);
+    allocateIndexBuffer(capacity);
+    _indices.grow(capacity);
+    setupVertexArray();
+    _indices.allocate(n_indices, first_index);
+  }
+
+  uploadVertices(_vertex_buffers[0], base_vertex, n_vertices, mesh._positions);
+  uploadVertices(_vertex_buffers[1], base_vertex, n_vertices, mesh._normals);
+  uploadVertices(
+    _vertex_buffers[2], base_vertex, n_vertices, mesh._texture_coordinates);
+  uploadVertices(_vertex_buffers[3], base_vertex, n_vertices, mesh._tangents);
+  // Elements stay relative to the mesh, the base vertex is added when drawing
+  GLState::bindBuffer(GL_COPY_WRITE_BUFFER, _index_buffer);
+  glBufferSubData(
+    GL_COPY_WRITE_BUFFER,
+    first_index * sizeof(GLushort),
+    n_indices * sizeof(GLushort),
+    mesh._elements->data());
+
+  mesh._geometry_pool = this;
+  mesh._pool_base_vertex = static_cast<GLint>(base_vertex);
+  mesh._pool_first_index = first_index;
+  _meshes.insert(&mesh);
+  return true;
+}
+
+void GeometryPool::remove(Mesh& mesh)
+{
+  if (mesh._geometry_pool != this)
+    return;
+  _vertices.free(
+    static_cast<GLuint>(mesh._pool_base_vertex),
+    static_cast<GLuint>(mesh._positions->size()));
+  _indices.free(
+    mesh._pool_first_index, static_cast<GLuint>(mesh._elements->size()));
+  mesh._geometry_pool = nullptr;
+  mesh._pool_base_vertex = 0;
+  mesh._pool_first_index = 0;
+  _meshes.erase(&mesh);
+}
+
+void GeometryPool::bind()
+{
+  GLState::bindVertexArray(_vertex_array);
+}
+
+void GeometryPool::unbind()
+{
+  GLState::bindVertexArray(0);
+}
+
+void GeometryPool::multiDraw(
+  const std::vector<DrawElementsIndirectCommand>& commands,
+  StreamingBuffer& indirect_buffer,
+  GLintptr commands_offset,
+  size_t first_command,
+  GLsizei n_commands,
+  StreamingBuffer& instance_transforms,
+  GLintptr instances_offset)
+{
+  if (multiDrawIndirectSupported())
+  {
+    // The base instance of each command offsets the instanced attributes
+    Mesh::enableInstanceTransforms(instance_transforms, instances_offset);
+    indirect_buffer.bind();
+    glMultiDrawElementsIndirect(
+      GL_TRIANGLES,
+      GL_UNSIGNED_SHORT,
+      reinterpret_cast<void*>(commands_offset +
+        first_command * sizeof(DrawElementsIndirectCommand)),
+      n_commands,
+      0);
+  }
+  else
+  {
+    for (size_t i = first_command; i < first_command + n_commands; ++i)
+    {
+      const DrawElementsIndirectCommand& command = commands[i];
+      Mesh::enableInstanceTransforms(instance_transforms,
+        instances_offset + command.base_instance * sizeof(glm::mat4));
+      glDrawElementsInstancedBaseVertex(
+        GL_TRIANGLES,
+        command.count,
+        GL_UNSIGNED_SHORT,
+        reinterpret_cast<void*>(command.first_index * sizeof(GLushort)),
+        command.instance_count,
+        command.base_vertex);
+    }
+  }
+  Mesh::disableInstanceTransforms();
+}
+
+bool GeometryPool::multiDrawIndirectSupported()
+{
+  return
+    GLEW_VERSION_4_3 ||
+    (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+}
+
+void GeometryPool::allocateVertexBuffers(GLuint capacity)
+{
+  for (int i = 0; i < 4; ++i)
+  {
+    GLsizeiptr vertex_size = attribute_sizes[i] * sizeof(GLfloat);
+    reallocateBuffer(
+      _vertex_buffers[i],
+      _vertices.capacity() * vertex_size,
+      capacity * vertex_size);
+  }
+}
+
+void GeometryPool::allocateIndexBuffer(GLuint capacity)
+{
+  reallocateBuffer(
+    _index_buffer,
+    _indices.capacity() * sizeof(GLushort),
+    capacity * sizeof(GLushort));
+}
+
+void GeometryPool::setupVertexArray()
+{
+  GLState::bindVertexArray(_vertex_array);
+  for (GLuint i = 0; i < 4; ++i)
+  {
+    GLState::bindBuffer(GL_ARRAY_BUFFER, _vertex_buffers[i]);
+    glEnableVertexAttribArray(i);
+    glVertexAttribPointer(i, attribute_sizes[i], GL_FLOAT, GL_FALSE, 0, 0);
+  }
+  GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, _index_buffer);
+  GLState::bindVertexArray(0);
+  GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+} }
@@ -0,0 +1,291 @@
+#include "elk/core/gl_state.h"
+
+namespace elk { namespace core {
+
+namespace {
+  const int n_texture_slots = 8;
+}
+
+GLuint GLState::_program = GLState::unknown;
+GLuint GLState::_vertex_array = GLState::unknown;
+GLuint GLState::_buffers[8] = {
+  GLState::unknown, GLState::unknown, GLState::unknown, GLState::unknown,
+  GLState::unknown, GLState::unknown, GLState::unknown, GLState::unknown };
+GLuint GLState::_active_texture = GLState::unknown;
+std::vector<GLuint> GLState::_bound_textures;
+GLuint GLState::_draw_framebuffer = GLState::unknown;
+GLuint GLState::_read_framebuffer = GLState::unknown;
+std::vector<std::pair<GLenum, GLuint>> GLState::_capabilities;
+GLuint GLState::_blend_source = GLState::unknown;
+GLuint GLState::_blend_destination = GLState::unknown;
+GLuint GLState::_depth_mask = GLState::unknown;
+GLuint GLState::_depth_func = GLState::unknown;
+GLint GLState::_viewport[4] = { 0, 0, 0, 0 };
+bool GLState::_viewport_known = false;
+GLStateStats GLState::_stats = { 0, 0 };
+GLStateStats GLState::_last_frame_stats = { 0, 0 };
+
+const GLuint GLState::unknown;
+
+void GLState::useProgram(GLuint program)
+{
+  if (change(_program, program))
+    glUseProgram(program);
+}
+
+void GLState::bindVertexArray(GLuint vertex_array)
+{
+  if (change(_vertex_array, vertex_array))
+  {
+    glBindVertexArray(vertex_array);
+    _buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = unknown;
+  }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer)
+{
+  int slot = bufferSlot(target);
+  if (slot < 0)
+  {
+    _stats.n_issued++;
+    glBindBuffer(target, buffer);
+  }
+  else if (change(_buffers[slot], buffer))
+    glBindBuffer(target, buffer);
+}
+
+void GLState::activeTexture(GLenum unit)
+{
+  if (change(_active_texture, unit))
+    glActiveTexture(unit);
+}
+
+void GLState::bindTexture(GLenum target, GLuint texture)
+{
+  int slot = textureSlot(target);
+  if (slot < 0 || _active_texture == unknown)
+  {
+    _stats.n_issued++;
+    glBindTexture(target, texture);
+    return;
+  }
+  size_t index = (_active_texture - GL_TEXTURE0) * n_texture_slots + slot;
+  if (index >= _bound_textures.size())
+    _bound_textures.resize(index - slot + n_texture_slots, unknown);
+  if (change(_bound_textures[index], texture))
+    glBindTexture(target, texture);
+}
+
+void GLState::bindFramebuffer(GLenum target, GLuint framebuffer)
+{
+  bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+  bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+  if ((!draw || _draw_framebuffer == framebuffer) &&
+      (!read || _read_framebuffer == framebuffer))
+  {
+    _stats.n_skipped++;
+    return;
+  }
+  _stats.n_issued++;
+  glBindFramebuffer(target, framebuffer);
+  if (draw)
+    _draw_framebuffer = framebuffer;
+  if (read)
+    _read_framebuffer = framebuffer;
+}
+
+void GLState::enable(GLenum capability)
+{
+  setCapability(capability, true);
+}
+
+void GLState::disable(GLenum capability)
+{
+  setCapability(capability, false);
+}
+
+void GLState::blendFunc(GLenum source_factor, GLenum destination_factor)
+{
+  if (_blend_source == source_factor && _blend_destination == destination_factor)
+  {
+    _stats.n_skipped++;
+    return;
+  }
+  _stats.n_issued++;
+  glBlendFunc(source_factor, destination_factor);
+  _blend_source = source_factor;
+  _blend_destination = destination_factor;
+}
+
+void GLState::depthMask(GLboolean enabled)
+{
+  if (change(_depth_mask, enabled))
+    glDepthMask(enabled);
+}
+
+void GLState::depthFunc(GLenum function)
+{
+  if (change(_depth_func, function))
+    glDepthFunc(function);
+}
+
+void GLState::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+  if (_viewport_known && _viewport[0] == x && _viewport[1] == y &&
+      _viewport[2] == width && _viewport[3] == height)
+  {
+    _stats.n_skipped++;
+    return;
+  }
+  _stats.n_issued++;
+  glViewport(x, y, width, height);
+  _viewport[0] = x;
+  _viewport[1] = y;
+  _viewport[2] = width;
+  _viewport[3] = height;
+  _viewport_known = true;
+}
+
+void GLState::deleteProgram(GLuint program)
+{
+  glDeleteProgram(program);
+  // A program in use is only deleted once another one is used
+  if (_program == program)
+    _program = unknown;
+}
+
+void GLState::deleteVertexArray(GLuint vertex_array)
+{
+  glDeleteVertexArrays(1, &vertex_array);
+  if (_vertex_array == vertex_array)
+  {
+    _vertex_array = 0;
+    _buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = unknown;
+  }
+}
+
+void GLState::deleteBuffer(GLuint buffer)
+{
+  glDeleteBuffers(1, &buffer);
+  for (auto& bound : _buffers)
+  {
+    if (bound == buffer)
+      bound = 0;
+  }
+}
+
+void GLState::deleteTexture(GLuint texture)
+{
+  glDeleteTextures(1, &texture);
+  for (auto& bound : _bound_textures)
+  {
+    if (bound == texture)
+      bound = 0;
+  }
+}
+
+void GLState::deleteFramebuffer(GLuint framebuffer)
+{
+  glDeleteFramebuffers(1, &framebuffer);
+  if (_draw_framebuffer == framebuffer)
+    _draw_framebuffer = 0;
+  if (_read_framebuffer == framebuffer)
+    _read_framebuffer = 0;
+}
+
+GLuint GLState::framebuffer()
+{
+  return _draw_framebuffer == unknown ? 0 : _draw_framebuffer;
+}
+
+void GLState::invalidate()
+{
+  _program = unknown;
+  _vertex_array = unknown;
+  for (auto& buffer : _buffers)
+    buffer = unknown;
+  _active_texture = unknown;
+  _bound_textures.clear();
+  _draw_framebuffer = unknown;
+  _read_framebuffer = unknown;
+  _capabilities.clear();
+  _blend_source = unknown;
+  _blend_destination = unknown;
+  _depth_mask = unknown;
+  _depth_func = unknown;
+  _viewport_known = false;
+}
+
+void GLState::beginFrame()
+{
+  _last_frame_stats = _stats;
+  _stats = { 0, 0 };
+}
+
+int GLState::bufferSlot(GLenum target)
+{
+  switch (target)
+  {
+    case GL_ARRAY_BUFFER: return 0;
+    case GL_ELEMENT_ARRAY_BUFFER: return 1;
+    case GL_COPY_READ_BUFFER: return 2;
+    case GL_COPY_WRITE_BUFFER: return 3;
+    case GL_DRAW_INDIRECT_BUFFER: return 4;
+    case GL_UNIFORM_BUFFER: return 5;
+    case GL_TEXTURE_BUFFER: return 6;
+    case GL_PIXEL_UNPACK_BUFFER: return 7;
+    default: return -1;
+  }
+}
+
+int GLState::textureSlot(GLenum target)
+{
+  switch (target)
+  {
+    case GL_TEXTURE_1D: return 0;
+    case GL_TEXTURE_2D: return 1;
+    case GL_TEXTURE_3D: return 2;
+    case GL_TEXTURE_CUBE_MAP: return 3;
+    case GL_TEXTURE_2D_ARRAY: return 4;
+    case GL_TEXTURE_BUFFER: return 5;
+    case GL_TEXTURE_RECTANGLE: return 6;
+    case GL_TEXTURE_2D_MULTISAMPLE: return 7;
+    default: return -1;
+  }
+}
+
+bool GLState::change(GLuint& cached, GLuint value)
+{
+  if (cached == value)
+  {
+    _stats.n_skipped++;
+    return false;
+  }
+  _stats.n_issued++;
+  cached = value;
+  return true;
+}
+
+void GLState::setCapability(GLenum capability, bool enabled)
+{
+  GLuint* cached = nullptr;
+  for (auto& pair : _capabilities)
+  {
+    if (pair.first == capability)
+      cached = &pair.second;
+  }
+  if (!cached)
+  {
+    _capabilities.push_back({ capability, unknown });
+    cached = &_capabilities.back().second;
+  }
+  if (change(*cached, enabled))
+  {
+    if (enabled)
+      glEnable(capability);
+    else
+      glDisable(capability);
+  }
+}
+
+} }
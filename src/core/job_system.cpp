@@ -0,0 +1,345 @@
+#include "elk/core/job_system.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace elk { namespace core {
+
+namespace {
+  // Job system and index of the worker owning the current thread, nullptr
+  // and -1 for other threads
+  thread_local const JobSystem* current_job_system = nullptr;
+  thread_local int current_worker_index = -1;
+
+  // Yields of a waiting thread with nothing to execute before it sleeps
+  const int n_wait_yields = 64;
+  const std::chrono::microseconds wait_sleep_duration(100);
+}
+
+JobSystem::JobSystem(unsigned int n_workers) :
+  _main_thread_id(std::this_thread::get_id()),
+  _n_queued_jobs(0),
+  _next_queue(0),
+  _stop(false)
+{
+  // There is always at least one queue, jobs scheduled without workers are
+  // executed by threads waiting for them
+  for (unsigned int i = 0; i < std::max(n_workers, 1u); ++i)
+    _queues.push_back(std::make_unique<WorkerQueue>());
+  for (unsigned int i = 0; i < n_workers; ++i)
+    _workers.emplace_back(&JobSystem::workerLoop, this, static_cast<int>(i));
+}
+
+JobSystem::~JobSystem()
+{
+  {
+    std::lock_guard<std::mutex> lock(_sleep_mutex);
+    _stop = true;
+  }
+  _work_available.notify_all();
+  for (auto& worker : _workers)
+    worker.join();
+}
+
+unsigned int JobSystem::defaultNumberOfWorkers()
+{
+  unsigned int n_threads = std::thread::hardware_concurrency();
+  return n_threads > 1 ? n_threads - 1 : 1;
+}
+
+JobSystem::JobHandle JobSystem::schedule(
+  std::function<void()> task, const std::vector<JobHandle>& dependencies)
+{
+  return createJob(std::move(task), false, dependencies);
+}
+
+JobSystem::JobHandle JobSystem::scheduleOnMainThread(
+  std::function<void()> task, const std::vector<JobHandle>& dependencies)
+{
+  return createJob(std::move(task), true, dependencies);
+}
+
+JobSystem::JobHandle JobSystem::createJob(
+  std::function<void()> task, bool main_thread,
+  const std::vector<JobHandle>& dependencies)
+{
+  JobHandle job = std::make_shared<Job>();
+  job->task = std::move(task);
+  job->main_thread = main_thread;
+  job->done = false;
+  // One extra count so that the job is not started while the dependencies
+  // are registered
+  job->n_pending_dependencies = 1;
+
+  for (auto& dependency : dependencies)
+  {
+    if (!dependency)
+      continue;
+    std::lock_guard<std::mutex> lock(dependency->mutex);
+    if (!dependency->done)
+    {
+      job->n_pending_dependencies++;
+      dependency->continuations.push_back(job);
+    }
+    else if (dependency->exception)
+      failDependent(*job, dependency->exception);
+  }
+
+  if (--job->n_pending_dependencies == 0)
+    makeReady(job);
+  return job;
+}
+
+void JobSystem::makeReady(const JobHandle& job)
+{
+  if (job->main_thread)
+  {
+    std::lock_guard<std::mutex> lock(_main_thread_mutex);
+    _main_thread_jobs.push_back(job);
+    return;
+  }
+
+  // Workers push to their own queue, other threads distribute the jobs
+  int worker_index = workerIndex();
+  int queue_index = worker_index >= 0 ?
+    worker_index : static_cast<int>(_next_queue++ % _queues.size());
+  {
+    std::lock_guard<std::mutex> lock(_queues[queue_index]->mutex);
+    _queues[queue_index]->jobs.push_back(job);
+  }
+  {
+    std::lock_guard<std::mutex> lock(_sleep_mutex);
+    _n_queued_jobs++;
+  }
+  _work_available.notify_one();
+}
+
+void JobSystem::failDependent(Job& job, std::exception_ptr exception)
+{
+  // Dependencies finishing on different threads may fail it at once
+  std::lock_guard<std::mutex> lock(job.mutex);
+  if (!job.exception)
+    job.exception = exception;
+}
+
+void JobSystem::execute(const JobHandle& job)
+{
+  // A job with a failed dependency already has its exception and is not run
+  if (job->task && !job->exception)
+  {
+    // Rethrown by wait(), an exception leaving the worker thread would
+    // terminate the program
+    try
+    {
+      job->task();
+    }
+    catch (...)
+    {
+      job->exception = std::current_exception();
+    }
+  }
+
+  std::vector<JobHandle> continuations;
+  {
+    std::lock_guard<std::mutex> lock(job->mutex);
+    job->done = true;
+    continuations.swap(job->continuations);
+  }
+  for (auto& continuation : continuations)
+  {
+    if (job->exception)
+      failDependent(*continuation, job->exception);
+    if (--continuation->n_pending_dependencies == 0)
+      makeReady(continuation);
+  }
+}
+
+bool JobSystem::executeOne()
+{
+  if (isMainThread())
+  {
+    JobHandle job = popMainThreadJob();
+    if (job)
+    {
+      execute(job);
+      return true;
+    }
+  }
+  JobHandle job = popOrSteal(workerIndex());
+  if (!job)
+    return false;
+  execute(job);
+  return true;
+}
+
+JobSystem::JobHandle JobSystem::popOrSteal(int worker_index)
+{
+  // Newest job from the own queue first, it is most likely in cache
+  if (worker_index >= 0)
+  {
+    WorkerQueue& queue = *_queues[worker_index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.jobs.empty())
+    {
+      JobHandle job = queue.jobs.back();
+      queue.jobs.pop_back();
+      _n_queued_jobs--;
+      return job;
+    }
+  }
+
+  // Steal the oldest job from one of the other queues
+  int n_queues = static_cast<int>(_queues.size());
+  int start = std::max(worker_index, 0);
+  for (int i = 0; i < n_queues; ++i)
+  {
+    int victim = (start + i + 1) % n_queues;
+    if (victim == worker_index)
+      continue;
+    WorkerQueue& queue = *_queues[victim];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.jobs.empty())
+    {
+      JobHandle job = queue.jobs.front();
+      queue.jobs.pop_front();
+      _n_queued_jobs--;
+      return job;
+    }
+  }
+  return nullptr;
+}
+
+JobSystem::JobHandle JobSystem::popMainThreadJob()
+{
+  std::lock_guard<std::mutex> lock(_main_thread_mutex);
+  if (_main_thread_jobs.empty())
+    return nullptr;
+  JobHandle job = _main_thread_jobs.front();
+  _main_thread_jobs.pop_front();
+  return job;
+}
+
+void JobSystem::wait(const JobHandle& job)
+{
+  int n_idle = 0;
+  while (job && !job->done)
+  {
+    if (executeOne())
+    {
+      n_idle = 0;
+      continue;
+    }
+    // The job runs on another thread, or waits for jobs that do
+    if (++n_idle < n_wait_yields)
+      std::this_thread::yield();
+    else
+      std::this_thread::sleep_for(wait_sleep_duration);
+  }
+  if (job && job->exception)
+    std::rethrow_exception(job->exception);
+}
+
+bool JobSystem::isDone(const JobHandle& job) const
+{
+  return !job || job->done;
+}
+
+void JobSystem::parallelFor(
+  size_t begin, size_t end, size_t grain_size,
+  const std::function<void(size_t, size_t)>& body)
+{
+  if (begin >= end)
+    return;
+  grain_size = std::max(grain_size, size_t(1));
+
+  std::vector<JobHandle> jobs;
+  for (size_t chunk_begin = begin + grain_size; chunk_begin < end;
+       chunk_begin += grain_size)
+  {
+    size_t chunk_end = std::min(chunk_begin + grain_size, end);
+    jobs.push_back(schedule([&body, chunk_begin, chunk_end]() {
+      body(chunk_begin, chunk_end);
+    }));
+  }
+  // The calling thread takes the first chunk itself. The jobs refer to
+  // body, all of them are waited for before an exception is passed on
+  std::exception_ptr exception;
+  try
+  {
+    body(begin, std::min(begin + grain_size, end));
+  }
+  catch (...)
+  {
+    exception = std::current_exception();
+  }
+  for (auto& job : jobs)
+  {
+    try
+    {
+      wait(job);
+    }
+    catch (...)
+    {
+      if (!exception)
+        exception = std::current_exception();
+    }
+  }
+  if (exception)
+    std::rethrow_exception(exception);
+}
+
+void JobSystem::runMainThreadJobs()
+{
+  // Jobs made ready by the ones executed here are run in the next call
+  std::deque<JobHandle> jobs;
+  {
+    std::lock_guard<std::mutex> lock(_main_thread_mutex);
+    jobs.swap(_main_thread_jobs);
+  }
+  std::exception_ptr exception;
+  for (auto& job : jobs)
+  {
+    execute(job);
+    // Nobody holds the handle to wait for it, the exception would be lost
+    if (job->exception && job.use_count() == 1 && !exception)
+      exception = job->exception;
+  }
+  if (exception)
+    std::rethrow_exception(exception);
+}
+
+void JobSystem::workerLoop(int worker_index)
+{
+  current_job_system = this;
+  current_worker_index = worker_index;
+  while (true)
+  {
+    JobHandle job = popOrSteal(worker_index);
+    if (job)
+    {
+      execute(job);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(_sleep_mutex);
+    _work_available.wait(lock, [this]() {
+      return _stop || _n_queued_jobs > 0;
+    });
+    if (_stop)
+      return;
+  }
+}
+
+int JobSystem::workerIndex() const
+{
+  // Workers of another job system waiting for a job of this one have no
+  // queue here
+  return current_job_system == this ? current_worker_index : -1;
+}
+
+bool JobSystem::isMainThread() const
+{
+  return std::this_thread::get_id() == _main_thread_id;
+}
+
+} }
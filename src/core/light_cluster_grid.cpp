@@ -0,0 +1,116 @@
+#include "elk/core/light_cluster_grid.h"
+
+#include "elk/core/camera.h"
+#include "elk/object_extensions/light_source.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace elk { namespace core {
+
+LightClusterGrid::LightClusterGrid(GLuint n_x, GLuint n_y, GLuint n_z) :
+  _n_x(n_x),
+  _n_y(n_y),
+  _n_z(n_z),
+  _near(0.0f),
+  _far(0.0f),
+  _projection(0.0f),
+  _clusters(n_x * n_y * n_z, { 0, 0 })
+{ }
+
+void LightClusterGrid::update(const PerspectiveCamera& camera)
+{
+  if (camera.projectionTransform() == _projection)
+    return;
+  _projection = camera.projectionTransform();
+  _near = camera.nearClippingPlane();
+  _far = camera.farClippingPlane();
+
+  // Half the width and height of the frustum at depth 1
+  float scale_x = 1.0f / _projection[0][0];
+  float scale_y = 1.0f / _projection[1][1];
+  _bounds.clear();
+  for (GLuint z = 0; z < _n_z; ++z)
+  {
+    float depth_near = _near * std::pow(_far / _near, float(z) / _n_z);
+    float depth_far = _near * std::pow(_far / _near, float(z + 1) / _n_z);
+    for (GLuint y = 0; y < _n_y; ++y)
+    {
+      float ndc_y0 = 2.0f * y / _n_y - 1.0f;
+      float ndc_y1 = 2.0f * (y + 1) / _n_y - 1.0f;
+      for (GLuint x = 0; x < _n_x; ++x)
+      {
+        float ndc_x0 = 2.0f * x / _n_x - 1.0f;
+        float ndc_x1 = 2.0f * (x + 1) / _n_x - 1.0f;
+        // The sides of the froxel are planes through the eye, the extremes
+        // are at the near or the far depth
+        glm::vec3 min(
+          std::min(ndc_x0 * depth_near, ndc_x0 * depth_far) * scale_x,
+          std::min(ndc_y0 * depth_near, ndc_y0 * depth_far) * scale_y,
+          -depth_far);
+        glm::vec3 max(
+          std::max(ndc_x1 * depth_near, ndc_x1 * depth_far) * scale_x,
+          std::max(ndc_y1 * depth_near, ndc_y1 * depth_far) * scale_y,
+          -depth_near);
+        _bounds.add(BoundingBox(min, max));
+      }
+    }
+  }
+}
+
+void LightClusterGrid::assign(const std::vector<PointLightInstance>& lights)
+{
+  const size_t n_slice_clusters = _n_x * _n_y;
+  _intersections.clear();
+  for (size_t i = 0; i < lights.size(); ++i)
+  {
+    glm::vec3 center(lights[i].position_and_radius);
+    float radius = lights[i].position_and_radius.w;
+    float depth = -center.z;
+    if (depth + radius < _near || depth - radius > _far)
+      continue;
+    // Only the clusters of the slices overlapped by the sphere are tested
+    size_t begin = slice(depth - radius) * n_slice_clusters;
+    size_t end = (slice(depth + radius) + 1) * n_slice_clusters;
+    // Rounded down to whole SIMD widths
+    size_t aligned_begin = begin / 8 * 8;
+    _intersecting.resize(end - aligned_begin + 8);
+    _bounds.intersects(
+      center, radius, aligned_begin, end, _intersecting.data());
+    for (size_t c = begin; c < end; ++c)
+    {
+      if (_intersecting[c - aligned_begin])
+        _intersections.push_back({ GLuint(c), GLuint(i) });
+    }
+  }
+
+  // Counting sort of the intersections by cluster
+  for (auto& cluster : _clusters)
+    cluster = { 0, 0 };
+  for (auto& intersection : _intersections)
+    _clusters[intersection.first].count++;
+  GLuint offset = 0;
+  for (auto& cluster : _clusters)
+  {
+    cluster.offset = offset;
+    offset += cluster.count;
+    cluster.count = 0;
+  }
+  _light_indices.resize(_intersections.size());
+  for (auto& intersection : _intersections)
+  {
+    LightCluster& cluster = _clusters[intersection.first];
+    _light_indices[cluster.offset + cluster.count++] = intersection.second;
+  }
+}
+
+int LightClusterGrid::slice(float depth) const
+{
+  if (depth <= _near)
+    return 0;
+  int z = static_cast<int>(
+    std::log(depth / _near) / std::log(_far / _near) * _n_z);
+  return std::min(z, static_cast<int>(_n_z) - 1);
+}
+
+} }
@@ -2,17 +2,31 @@
 
 #include "elk/core/create_texture.h"
 #include "elk/core/texture_unit.h"
+#include "elk/core/gl_state.h"
 
 namespace elk { namespace core {
 
+namespace {
+  const UniformName uniform_albedo_texture("albedo_texture");
+  const UniformName uniform_roughness_texture("roughness_texture");
+  const UniformName uniform_R0_texture("R0_texture");
+  const UniformName uniform_metalness_texture("metalness_texture");
+  const UniformName uniform_normal_texture("normal_texture");
+  const UniformName uniform_compact_g_buffer("compact_g_buffer");
+}
+
 std::shared_ptr<ShaderProgram> Material::_gbuffer_program = nullptr;
+std::shared_ptr<ShaderProgram> Material::_gbuffer_instanced_program = nullptr;
+unsigned int Material::_n_created_materials = 0;
+bool Material::_compact_g_buffer = false;
 
 Material::Material(
   std::shared_ptr<Texture> albedo_texture,
   std::shared_ptr<Texture> roughness_texture,
   std::shared_ptr<Texture> R0_texture,
   std::shared_ptr<Texture> metalness_texture,
-  std::shared_ptr<Texture> normal_texture)
+  std::shared_ptr<Texture> normal_texture) :
+  _id(_n_created_materials++)
 {
   _albedo_texture     = albedo_texture    ? albedo_texture    : CreateTexture::white(2,2);
   _roughness_texture  = roughness_texture ? roughness_texture : CreateTexture::white(2,2);
@@ -36,6 +50,16 @@ Material::Material(
       nullptr,
       (std::string(ELK_DIR) + "/shaders/deferred_shading/geometry_pass.frag").c_str());
   }
+  if (!_gbuffer_instanced_program)
+  {
+    _gbuffer_instanced_program = std::make_shared<ShaderProgram>(
+      "gbuffer_instanced_program",
+      (std::string(ELK_DIR) + "/shaders/deferred_shading/geometry_pass_instanced.vert").c_str(),
+      nullptr,
+      nullptr,
+      nullptr,
+      (std::string(ELK_DIR) + "/shaders/deferred_shading/geometry_pass.frag").c_str());
+  }
 }
 
 Material::~Material()
@@ -43,9 +67,24 @@ Material::~Material()
   
 }
 
+void Material::setCompactGBuffer(bool compact)
+{
+  _compact_g_buffer = compact;
+}
+
 void Material::use()
 {
-  glUseProgram(_gbuffer_program->id());
+  use(*_gbuffer_program);
+}
+
+void Material::useInstanced()
+{
+  use(*_gbuffer_instanced_program);
+}
+
+void Material::use(ShaderProgram& program)
+{
+  GLState::useProgram(program.id());
 
   TextureUnit
     tex_unit_albedo,
@@ -66,11 +105,12 @@ void Material::use()
   tex_unit_normal.activate();
   _normal_texture->bind();
 
-  glUniform1i(glGetUniformLocation(_gbuffer_program->id(), "albedo_texture"),    tex_unit_albedo);
-  glUniform1i(glGetUniformLocation(_gbuffer_program->id(), "roughness_texture"), tex_unit_roughness);
-  glUniform1i(glGetUniformLocation(_gbuffer_program->id(), "R0_texture"),        tex_unit_R0);
-  glUniform1i(glGetUniformLocation(_gbuffer_program->id(), "metalness_texture"), tex_unit_metalness);
-  glUniform1i(glGetUniformLocation(_gbuffer_program->id(), "normal_texture"),    tex_unit_normal);
+  program.setUniform(uniform_albedo_texture, tex_unit_albedo.unitNumber());
+  program.setUniform(uniform_roughness_texture, tex_unit_roughness.unitNumber());
+  program.setUniform(uniform_R0_texture, tex_unit_R0.unitNumber());
+  program.setUniform(uniform_metalness_texture, tex_unit_metalness.unitNumber());
+  program.setUniform(uniform_normal_texture, tex_unit_normal.unitNumber());
+  program.setUniform(uniform_compact_g_buffer, _compact_g_buffer ? 1 : 0);
 }
 
 } }
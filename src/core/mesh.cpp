@@ -1,7 +1,11 @@
 #include "elk/core/mesh.h"
 
+#include "elk/core/geometry_pool.h"
+
 namespace elk { namespace core {
 
+unsigned int Mesh::_n_created_meshes = 0;
+
 Mesh::Mesh(
   std::vector<unsigned short>* elements,
   std::vector<glm::vec3>* positions,
@@ -11,6 +15,12 @@ Mesh::Mesh(
   std::vector<glm::vec4>* colors,
   GLenum render_mode,
   GLenum render_method) :
+  _bounding_box(BoundingBox::infinite()),
+  _id(_n_created_meshes++),
+  _render_mode(render_mode),
+  _geometry_pool(nullptr),
+  _pool_base_vertex(0),
+  _pool_first_index(0),
   _elements(elements),
   _positions(positions),
   _normals(normals),
@@ -19,6 +29,9 @@ Mesh::Mesh(
   _colors(colors)
 {
   assert(positions);
+  _bounding_box = BoundingBox(computeMinPosition(), computeMaxPosition());
+  // The element buffer binding is stored in the vertex array
+  _vao.bind();
   if (_elements)
   {
     ArrayBuffer::InitData init_data =
@@ -72,6 +85,8 @@ Mesh::Mesh(
 
 Mesh::~Mesh()
 {
+  if (_geometry_pool)
+    _geometry_pool->remove(*this);
   if (_elements)
     delete _elements;
   if (_positions)
@@ -87,23 +102,78 @@ Mesh::~Mesh()
 }
 
 void Mesh::render()
+{
+  bind();
+  draw();
+  unbind();
+}
+
+void Mesh::bind()
 {
   _vao.bind();
-  _element_buffer->bind();
-  _vao.enableAttribArrays();
+}
+
+void Mesh::draw()
+{
   _element_buffer->render();
-  _vao.disableAttribArrays();
 }
 
-glm::vec3 Mesh::computeMinPosition() const
+void Mesh::drawInstanced(
+  StreamingBuffer& instance_transforms,
+  GLintptr offset,
+  GLsizei n_instances)
 {
-  glm::vec3 max = _positions->at(0);
-  for (int i = 1; i < _positions->size(); i++)
-    max = glm::max(max, _positions->at(i));
-  return max;
+  enableInstanceTransforms(instance_transforms, offset);
+  drawInstanced(n_instances);
+  disableInstanceTransforms();
 }
 
-glm::vec3 Mesh::computeMaxPosition() const
+void Mesh::drawInstanced(GLsizei n_instances)
+{
+  if (_element_buffer)
+    _element_buffer->renderInstanced(n_instances);
+  else
+    _vao.getBuffer(0).renderInstanced(n_instances);
+}
+
+namespace {
+  // Attributes 0 to 4 are used by the vertex buffers
+  const GLuint first_instance_attribute = 5;
+}
+
+void Mesh::enableInstanceTransforms(
+  StreamingBuffer& instance_transforms, GLintptr offset)
+{
+  // Binds through GLState, so the cached GL_ARRAY_BUFFER binding stays
+  // correct after the draw
+  instance_transforms.bind();
+  for (GLuint column = 0; column < 4; ++column)
+  {
+    glEnableVertexAttribArray(first_instance_attribute + column);
+    glVertexAttribPointer(
+      first_instance_attribute + column,
+      4,
+      GL_FLOAT,
+      GL_FALSE,
+      sizeof(glm::mat4),
+      reinterpret_cast<void*>(offset + column * sizeof(glm::vec4)));
+    glVertexAttribDivisor(first_instance_attribute + column, 1);
+  }
+}
+
+void Mesh::disableInstanceTransforms()
+{
+  for (GLuint column = 0; column < 4; ++column)
+    glDisableVertexAttribArray(first_instance_attribute + column);
+}
+
+void Mesh::unbind()
+{
+  // The vertex array holds all state of the mesh, it stays bound until the
+  // next one is bound
+}
+
+glm::vec3 Mesh::computeMinPosition() const
 {
   glm::vec3 min = _positions->at(0);
   for (int i = 1; i < _positions->size(); i++)
@@ -111,28 +181,62 @@ glm::vec3 Mesh::computeMaxPosition() const
   return min;
 }
 
+glm::vec3 Mesh::computeMaxPosition() const
+{
+  glm::vec3 max = _positions->at(0);
+  for (int i = 1; i < _positions->size(); i++)
+    max = glm::max(max, _positions->at(i));
+  return max;
+}
+
 CPUPointCloud::CPUPointCloud(std::vector<glm::vec3>* positions) :
   Mesh(nullptr, positions, nullptr, nullptr, nullptr, nullptr,
-    GL_POINTS, GL_DYNAMIC_DRAW)
+    GL_POINTS, GL_DYNAMIC_DRAW),
+  _n_points(static_cast<GLsizei>(positions->size()))
 {
 
 }
 
-void CPUPointCloud::render()
+void CPUPointCloud::bind()
 {
   _vao.bind();
-  _vao.enableAttribArrays();
-  glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
-  _vao.getBuffer(0).render();
-  _vao.disableAttribArrays();
+  GLState::enable(GL_VERTEX_PROGRAM_POINT_SIZE);
+}
+
+void CPUPointCloud::draw()
+{
+  glDrawArrays(GL_POINTS, 0, _n_points);
 }
 
 void CPUPointCloud::update(std::vector<glm::vec3>& positions)
 {
-  _vao.getBuffer(0).update(
-    {&positions[0], static_cast<GLsizei>(sizeof(glm::vec3) * positions.size()),
-    static_cast<GLuint>(positions.size()), GL_FLOAT, GL_ARRAY_BUFFER,
-    GL_DYNAMIC_DRAW, GL_POINTS});
+  if (positions.empty())
+  {
+    _n_points = 0;
+    _bounding_box = BoundingBox(glm::vec3(0.0f), glm::vec3(0.0f));
+    return;
+  }
+  glm::vec3 min = positions[0];
+  glm::vec3 max = positions[0];
+  for (auto& position : positions)
+  {
+    min = glm::min(min, position);
+    max = glm::max(max, position);
+  }
+  _bounding_box = BoundingBox(min, max);
+
+  GLsizeiptr size = sizeof(glm::vec3) * positions.size();
+  if (!_position_stream)
+    _position_stream = std::make_unique<StreamingBuffer>(GL_ARRAY_BUFFER, size);
+  _position_stream->beginFrame();
+  GLintptr offset = _position_stream->write(&positions[0], size);
+  _n_points = static_cast<GLsizei>(positions.size());
+
+  // The region written changes every frame, so does the attribute pointer
+  _vao.bind();
+  _position_stream->bind();
+  glVertexAttribPointer(
+    0, 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<void*>(offset));
 }
 
 } }
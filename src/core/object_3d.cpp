@@ -3,29 +3,95 @@
 #include "elk/core/deferred_shading_renderer.h"
 #include "elk/object_extensions/light_source.h"
 #include "elk/core/camera.h"
+#include "elk/core/transform_hierarchy.h"
+#include "elk/core/scene_listener.h"
 
 namespace elk { namespace core {
 
+Object3D::~Object3D()
+{
+  if (_parent)
+    _parent->detachChild(*this);
+  else if (_scene_listener)
+    setSceneListener(nullptr);
+  for (auto ch : _children) {
+    ch->_parent = nullptr;
+  }
+  if (_transform_hierarchy)
+    _transform_hierarchy->remove(*this);
+}
+
 void Object3D::addChild(Object3D& child)
 {
+  if (child._parent == this)
+    return;
+  if (child._parent)
+    child._parent->detachChild(child);
+  child._index_in_parent = _children.size();
   _children.push_back(&child);
+  child._parent = this;
+  // The stacked transform of the child has changed
+  child.markTransformDirty();
+  if (_transform_hierarchy)
+    _transform_hierarchy->invalidate();
+  if (child._scene_listener != _scene_listener)
+    child.setSceneListener(_scene_listener);
 }
 
 void Object3D::removeChild(Object3D& child)
 {
-  _children.erase(std::remove(
-    _children.begin(), _children.end(), &child), _children.end());
-  for (auto ch : _children) {
-    ch->removeChild(child);
+  // Only objects in the subtree of this object are removed
+  for (Object3D* node = child._parent; node != this; node = node->_parent)
+  {
+    if (!node)
+      return;
   }
+  child._parent->detachChild(child);
+}
+
+void Object3D::detachChild(Object3D& child)
+{
+  if (_transform_hierarchy)
+    _transform_hierarchy->invalidate();
+  Object3D* last = _children.back();
+  _children[child._index_in_parent] = last;
+  last->_index_in_parent = child._index_in_parent;
+  _children.pop_back();
+  child._parent = nullptr;
+  if (child._scene_listener)
+    child.setSceneListener(nullptr);
 }
 
 void Object3D::updateTransform(const glm::mat4& stacked_transform)
 {
-  _absolute_transform = stacked_transform * _relative_transform;
+  setAbsoluteTransform(stacked_transform * relativeTransform());
+  _transform_dirty = false;
+  _child_transform_dirty = false;
   for (auto ch : _children) {
-    ch->updateTransform(_absolute_transform);
+    ch->updateTransform(absoluteTransform());
+  }
+}
+
+unsigned int Object3D::updateDirtyTransforms(
+  const glm::mat4& stacked_transform, bool parent_changed)
+{
+  unsigned int n_updated = 0;
+  bool changed = parent_changed || _transform_dirty;
+  if (changed)
+  {
+    setAbsoluteTransform(stacked_transform * relativeTransform());
+    n_updated++;
+  }
+  // Clean subtrees are skipped completely
+  if (changed || _child_transform_dirty)
+  {
+    for (auto ch : _children) {
+      n_updated += ch->updateDirtyTransforms(absoluteTransform(), changed);
+    }
   }
+  _transform_dirty = false;
+  _child_transform_dirty = false;
+  return n_updated;
 }
 
 void Object3D::submit(Renderer& renderer)
@@ -44,17 +110,63 @@ void Object3D::update(double dt)
 
 const glm::mat4& Object3D::relativeTransform() const
 {
-  return _relative_transform;
+  return _transform_hierarchy ?
+    _transform_hierarchy->localTransform(_transform_index) :
+    _relative_transform;
 }
 
 const glm::mat4& Object3D::absoluteTransform() const
 {
-  return _absolute_transform;
+  return _transform_hierarchy ?
+    _transform_hierarchy->worldTransform(_transform_index) :
+    _absolute_transform;
 }
 
 void Object3D::setTransform(const glm::mat4& transform)
 {
-  _relative_transform = transform;
+  if (_transform_hierarchy)
+    _transform_hierarchy->setLocalTransform(_transform_index, transform);
+  else
+    _relative_transform = transform;
+  markTransformDirty();
+}
+
+void Object3D::markTransformDirty()
+{
+  _transform_dirty = true;
+  // Ancestors already flagged means the rest of the path is flagged too
+  for (Object3D* node = _parent;
+       node && !node->_child_transform_dirty.exchange(true);
+       node = node->_parent)
+  { }
+}
+
+void Object3D::setAbsoluteTransform(const glm::mat4& transform)
+{
+  if (_transform_hierarchy)
+    _transform_hierarchy->setWorldTransform(_transform_index, transform);
+  else
+    _absolute_transform = transform;
+  if (_scene_listener)
+    _scene_listener->objectMoved(*this);
+}
+
+void Object3D::boundsChanged()
+{
+  if (_scene_listener)
+    _scene_listener->objectMoved(*this);
+}
+
+void Object3D::setSceneListener(SceneListener* listener)
+{
+  if (_scene_listener)
+    _scene_listener->objectDetached(*this);
+  _scene_listener = listener;
+  if (_scene_listener)
+    _scene_listener->objectAttached(*this);
+  for (auto ch : _children) {
+    ch->setSceneListener(listener);
+  }
 }
 
 void RenderableDeferred::submit(Renderer& renderer)
@@ -0,0 +1,482 @@
+#include "elk/core/render_graph.h"
+
+#include "elk/core/gl_state.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+
+namespace elk { namespace core {
+
+RenderGraph::PassContext::PassContext(
+  const RenderGraph& graph, const Pass& pass, glm::uvec2 size) :
+  _graph(graph),
+  _pass(pass),
+  _size(size),
+  _texture_units(pass._reads.size())
+{
+  for (size_t i = 0; i < pass._reads.size(); ++i)
+  {
+    const Resource& resource = graph._resources[pass._reads[i].index];
+    _texture_units[i].activate();
+    graph._textures[resource.texture].texture->bind();
+    _unit_numbers.push_back(_texture_units[i].unitNumber());
+  }
+}
+
+void RenderGraph::PassContext::bindSamplers() const
+{
+  for (size_t i = 0; i < _pass._reads.size(); ++i)
+  {
+    ShaderProgram::current().setUniform(
+      _pass._reads[i].sampler, _unit_numbers[i]);
+  }
+}
+
+std::shared_ptr<Texture> RenderGraph::PassContext::texture(
+  const std::string& resource) const
+{
+  int index = _graph.resourceIndex(resource);
+  bool used =
+    std::any_of(_pass._reads.begin(), _pass._reads.end(),
+      [index](const Pass::Read& read) { return read.index == index; }) ||
+    std::any_of(_pass._writes.begin(), _pass._writes.end(),
+      [index](const Pass::Write& write) { return write.index == index; });
+  if (!used)
+    return nullptr;
+  return _graph._textures[_graph._resources[index].texture].texture;
+}
+
+RenderGraph::Pass::Pass(const std::string& name, Execute execute) :
+  _name(name),
+  _execute(execute),
+  _output(false)
+{ }
+
+RenderGraph::Pass& RenderGraph::Pass::read(
+  const std::string& resource, const UniformName& sampler, int mip_levels)
+{
+  _reads.push_back({ resource, sampler, std::max(mip_levels, 1), -1 });
+  return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::write(
+  const std::string& resource, GLenum attachment)
+{
+  _writes.push_back({ resource, attachment, -1 });
+  return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::output()
+{
+  _output = true;
+  return *this;
+}
+
+RenderGraph::RenderGraph() :
+  _render_scale(1.0f)
+{ }
+
+RenderGraph::~RenderGraph()
+{ }
+
+void RenderGraph::addTexture(
+  const std::string& name, const TextureDescription& description)
+{
+  int index = resourceIndex(name);
+  if (index != -1)
+    _resources[index].description = description;
+  else
+    _resources.push_back({ name, description, -1, 1 });
+}
+
+RenderGraph::Pass& RenderGraph::addPass(const std::string& name, Execute execute)
+{
+  _passes.push_back(std::unique_ptr<Pass>(new Pass(name, execute)));
+  return *_passes.back();
+}
+
+void RenderGraph::clear()
+{
+  _order.clear();
+  _passes.clear();
+  _resources.clear();
+}
+
+bool RenderGraph::compile()
+{
+  _order.clear();
+  std::vector<Pass*> order;
+  if (!resolveResources() || !orderPasses(order))
+    return false;
+  assignTextures(order);
+  createFramebuffers(order);
+  _order = order;
+  return true;
+}
+
+void RenderGraph::execute(FrameProfiler* profiler)
+{
+  for (Pass* pass : _order)
+  {
+    if (profiler)
+      profiler->beginScope(pass->_name);
+    for (int resource : pass->_generate_mip_maps)
+      generateMipMaps(_resources[resource]);
+
+    glm::uvec2 size(0);
+    if (pass->_fbo)
+    {
+      pass->_fbo->bind();
+      if (pass->_color_attachments.empty())
+        glDrawBuffer(GL_NONE);
+      else
+      {
+        glDrawBuffers(
+          static_cast<GLsizei>(pass->_color_attachments.size()),
+          pass->_color_attachments.data());
+      }
+      size = _resources[pass->_writes.front().index].description.size;
+    }
+    else
+      GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Binds the textures read until the pass is done
+    PassContext context(*this, *pass, size);
+    pass->_execute(context);
+    if (profiler)
+      profiler->endScope();
+  }
+  GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+std::vector<std::string> RenderGraph::executionOrder() const
+{
+  std::vector<std::string> names;
+  for (const Pass* pass : _order)
+    names.push_back(pass->_name);
+  return names;
+}
+
+int RenderGraph::resourceIndex(const std::string& name) const
+{
+  for (size_t i = 0; i < _resources.size(); ++i)
+  {
+    if (_resources[i].name == name)
+      return static_cast<int>(i);
+  }
+  return -1;
+}
+
+bool RenderGraph::resolveResources()
+{
+  for (auto& pass : _passes)
+  {
+    for (auto& read : pass->_reads)
+    {
+      read.index = resourceIndex(read.resource);
+      if (read.index == -1)
+      {
+        fprintf(stderr, "ERROR : Pass %s reads unknown texture %s\n",
+          pass->_name.c_str(), read.resource.c_str());
+        return false;
+      }
+    }
+    for (auto& write : pass->_writes)
+    {
+      write.index = resourceIndex(write.resource);
+      if (write.index == -1)
+      {
+        fprintf(stderr, "ERROR : Pass %s writes unknown texture %s\n",
+          pass->_name.c_str(), write.resource.c_str());
+        return false;
+      }
+      for (const auto& read : pass->_reads)
+      {
+        if (read.index == write.index)
+        {
+          fprintf(stderr, "ERROR : Pass %s reads and writes texture %s\n",
+            pass->_name.c_str(), write.resource.c_str());
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool RenderGraph::orderPasses(std::vector<Pass*>& order)
+{
+  size_t n_passes = _passes.size();
+  // Writers of each resource in the order they were added
+  std::vector<std::vector<size_t>> writers(_resources.size());
+  for (size_t i = 0; i < n_passes; ++i)
+  {
+    for (const auto& write : _passes[i]->_writes)
+      writers[write.index].push_back(i);
+  }
+
+  // Passes are needed by output passes through the textures they read.
+  // Earlier writes of a texture are needed by later ones, which may blend
+  std::vector<size_t> stack;
+  std::vector<bool> needed(n_passes, false);
+  std::vector<std::vector<size_t>> dependencies(n_passes);
+  for (size_t i = 0; i < n_passes; ++i)
+  {
+    if (_passes[i]->_output)
+    {
+      needed[i] = true;
+      stack.push_back(i);
+    }
+  }
+  while (!stack.empty())
+  {
+    size_t i = stack.back();
+    stack.pop_back();
+    for (const auto& read : _passes[i]->_reads)
+    {
+      if (writers[read.index].empty())
+      {
+        fprintf(stderr, "ERROR : Pass %s reads texture %s that is never written\n",
+          _passes[i]->_name.c_str(), read.resource.c_str());
+        return false;
+      }
+      for (size_t writer : writers[read.index])
+        dependencies[i].push_back(writer);
+    }
+    for (const auto& write : _passes[i]->_writes)
+    {
+      const auto& resource_writers = writers[write.index];
+      auto it = std::find(resource_writers.begin(), resource_writers.end(), i);
+      if (it != resource_writers.begin())
+        dependencies[i].push_back(*std::prev(it));
+    }
+    for (size_t dependency : dependencies[i])
+    {
+      if (!needed[dependency])
+      {
+        needed[dependency] = true;
+        stack.push_back(dependency);
+      }
+    }
+  }
+
+  // Runs the first added pass whose dependencies have run, until all
+  // needed passes have
+  size_t n_needed = std::count(needed.begin(), needed.end(), true);
+  std::vector<bool> done(n_passes, false);
+  while (order.size() < n_needed)
+  {
+    size_t next = n_passes;
+    for (size_t i = 0; i < n_passes && next == n_passes; ++i)
+    {
+      if (!needed[i] || done[i])
+        continue;
+      bool ready = std::all_of(dependencies[i].begin(), dependencies[i].end(),
+        [&done](size_t dependency) { return done[dependency]; });
+      if (ready)
+        next = i;
+    }
+    if (next == n_passes)
+    {
+      fprintf(stderr,
+        "ERROR : Passes of the render graph depend on each other in a cycle\n");
+      order.clear();
+      return false;
+    }
+    done[next] = true;
+    order.push_back(_passes[next].get());
+  }
+  return true;
+}
+
+void RenderGraph::assignTextures(const std::vector<Pass*>& order)
+{
+  // Lifetime of each resource as positions in the order
+  size_t n_resources = _resources.size();
+  std::vector<int> first_use(n_resources, -1);
+  std::vector<int> last_use(n_resources, -1);
+  auto use = [&](int resource, int position) {
+    if (first_use[resource] == -1)
+      first_use[resource] = position;
+    last_use[resource] = position;
+  };
+  for (auto& resource : _resources)
+  {
+    resource.texture = -1;
+    resource.mip_levels = 1;
+  }
+  for (auto& pass : _passes)
+    pass->_generate_mip_maps.clear();
+
+  for (Pass* pass : order)
+  {
+    for (const auto& read : pass->_reads)
+    {
+      Resource& resource = _resources[read.index];
+      resource.mip_levels = std::max(resource.mip_levels, read.mip_levels);
+    }
+  }
+  for (auto& resource : _resources)
+  {
+    glm::uvec2 size = resource.description.size;
+    GLuint largest = std::max(std::max(size.x, size.y), 1u);
+    int n_levels = static_cast<int>(std::log2(static_cast<float>(largest))) + 1;
+    resource.mip_levels = std::min(resource.mip_levels, n_levels);
+  }
+
+  std::vector<bool> mip_maps_scheduled(n_resources, false);
+  for (size_t position = 0; position < order.size(); ++position)
+  {
+    Pass& pass = *order[position];
+    for (const auto& write : pass._writes)
+      use(write.index, static_cast<int>(position));
+    for (const auto& read : pass._reads)
+    {
+      use(read.index, static_cast<int>(position));
+      // All writes are done before the first read, which generates the
+      // levels of all later reads
+      if (read.mip_levels > 1 && _resources[read.index].mip_levels > 1 &&
+          !mip_maps_scheduled[read.index])
+      {
+        mip_maps_scheduled[read.index] = true;
+        pass._generate_mip_maps.push_back(read.index);
+      }
+    }
+  }
+
+  // Resources in the order their lifetimes start, each takes the first
+  // texture that is free by then
+  std::vector<int> resources;
+  for (size_t i = 0; i < n_resources; ++i)
+  {
+    if (first_use[i] != -1)
+      resources.push_back(static_cast<int>(i));
+  }
+  std::stable_sort(resources.begin(), resources.end(),
+    [&first_use](int a, int b) { return first_use[a] < first_use[b]; });
+
+  struct Slot
+  {
+    TextureDescription description;
+    bool mip_maps;
+    int last_use;
+  };
+  std::vector<Slot> slots;
+  for (int i : resources)
+  {
+    Resource& resource = _resources[i];
+    auto slot = std::find_if(slots.begin(), slots.end(),
+      [&](const Slot& candidate) {
+        return candidate.last_use < first_use[i] &&
+          isCompatible(candidate.description, resource.description);
+      });
+    if (slot == slots.end())
+    {
+      slots.push_back({ resource.description, false, -1 });
+      slot = slots.end() - 1;
+    }
+    // A texture with mip maps can also be read without them, from level 0
+    slot->mip_maps = slot->mip_maps || resource.mip_levels > 1;
+    slot->last_use = last_use[i];
+    resource.texture = static_cast<int>(slot - slots.begin());
+  }
+
+  std::vector<PhysicalTexture> unused;
+  std::swap(unused, _textures);
+  bool mip_maps = false;
+  for (const auto& slot : slots)
+  {
+    _textures.push_back({ slot.description, slot.mip_maps,
+      createTexture(slot.description, slot.mip_maps, unused) });
+    mip_maps = mip_maps || slot.mip_maps;
+  }
+  if (mip_maps && !_downsampler && Downsampler::supported())
+    _downsampler = std::make_unique<Downsampler>();
+}
+
+void RenderGraph::createFramebuffers(const std::vector<Pass*>& order)
+{
+  for (auto& pass : _passes)
+  {
+    pass->_fbo.reset();
+    pass->_color_attachments.clear();
+  }
+  for (Pass* pass : order)
+  {
+    if (pass->_writes.empty())
+      continue;
+    pass->_fbo = std::make_unique<FrameBufferObject>();
+    for (const auto& write : pass->_writes)
+    {
+      const Resource& resource = _resources[write.index];
+      pass->_fbo->attach2DTexture(
+        _textures[resource.texture].texture->id(), write.attachment, 0);
+      if (write.attachment != GL_DEPTH_ATTACHMENT)
+        pass->_color_attachments.push_back(write.attachment);
+    }
+  }
+}
+
+void RenderGraph::generateMipMaps(const Resource& resource)
+{
+  const TextureDescription& description = resource.description;
+  Texture& texture = *_textures[resource.texture].texture;
+  // Levels 1 to mip_levels - 1 are sampled
+  int levels = resource.mip_levels - 1;
+  if (_downsampler && levels <= Downsampler::max_levels &&
+      Downsampler::supportsFormat(description.internal_format))
+  {
+    glm::uvec2 region = glm::min(description.size, glm::uvec2(
+      std::ceil(description.size.x * _render_scale.x),
+      std::ceil(description.size.y * _render_scale.y)));
+    _downsampler->generate(texture, description.internal_format, region, levels);
+  }
+  else
+    texture.generateMipMap(levels);
+}
+
+std::shared_ptr<Texture> RenderGraph::createTexture(
+  const TextureDescription& description, bool mip_maps,
+  std::vector<PhysicalTexture>& unused)
+{
+  for (auto it = unused.begin(); it != unused.end(); ++it)
+  {
+    if (it->mip_maps == mip_maps && isCompatible(it->description, description))
+    {
+      auto texture = it->texture;
+      unused.erase(it);
+      return texture;
+    }
+  }
+  Texture::FilterMode filter = description.filter;
+  if (mip_maps)
+  {
+    filter = filter == Texture::FilterMode::Nearest ?
+      Texture::FilterMode::NearestLinearMipMap :
+      Texture::FilterMode::LinearMipMap;
+  }
+  auto texture = std::make_shared<Texture>(
+    glm::uvec3(description.size, 1),
+    description.format,
+    description.internal_format,
+    description.type,
+    filter,
+    Texture::WrappingMode::ClampToEdge);
+  texture->upload();
+  return texture;
+}
+
+bool RenderGraph::isCompatible(
+  const TextureDescription& a, const TextureDescription& b)
+{
+  return
+    a.size == b.size &&
+    a.format == b.format &&
+    a.internal_format == b.internal_format &&
+    a.type == b.type &&
+    a.filter == b.filter;
+}
+
+} }
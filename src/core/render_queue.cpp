@@ -0,0 +1,362 @@
+#include "elk/core/render_queue.h"
+
+#include "elk/core/camera.h"
+#include "elk/core/mesh.h"
+#include "elk/core/material.h"
+#include "elk/core/streaming_buffer.h"
+
+#include <algorithm>
+
+namespace elk { namespace core {
+
+namespace {
+  // Bit offsets of the fields of the sort key
+  const int pass_shift = 60;
+  const int program_shift = 48;
+  const int material_shift = 32;
+  const int mesh_shift = 16;
+
+  // Objects drawing themselves use an unknown program, sorted after all
+  // known ones
+  const uint64_t object_program = 0xfff;
+
+  const UniformName uniform_M("M");
+}
+
+RenderQueue::RenderQueue() :
+  _sorting(true),
+  _instancing(true),
+  _stats({ 0, 0, 0, 0, 0, 0 }),
+  _near(0.0f),
+  _far(1.0f),
+  _instance_transforms_uploaded(false),
+  _instance_offset(0),
+  _geometry_pool(nullptr),
+  _commands_uploaded(false),
+  _commands_offset(0)
+{ }
+
+RenderQueue::~RenderQueue()
+{ }
+
+void RenderQueue::begin(const PerspectiveCamera& camera)
+{
+  _packets.clear();
+  _order.clear();
+  _view_transform = camera.viewTransform();
+  _near = camera.nearClippingPlane();
+  _far = camera.farClippingPlane();
+}
+
+void RenderQueue::push(
+  RenderPass pass,
+  Mesh& mesh,
+  Material& material,
+  const glm::mat4& transform)
+{
+  Packet packet = {
+    pass, &mesh, &material, static_cast<GLuint>(material.programId()),
+    &transform, nullptr, nullptr };
+  push(packet, glm::vec3(transform[3]));
+}
+
+void RenderQueue::push(RenderPass pass, RenderableDeferred& renderable)
+{
+  Packet packet = { pass, nullptr, nullptr, 0, nullptr, &renderable,
+    [](Object3D& object, const UsefulRenderData& data) {
+      static_cast<RenderableDeferred&>(object).render(data);
+    } };
+  push(packet, glm::vec3(renderable.absoluteTransform()[3]));
+}
+
+void RenderQueue::push(RenderPass pass, RenderableForward& renderable)
+{
+  Packet packet = { pass, nullptr, nullptr, 0, nullptr, &renderable,
+    [](Object3D& object, const UsefulRenderData& data) {
+      static_cast<RenderableForward&>(object).render(data);
+    } };
+  push(packet, glm::vec3(renderable.absoluteTransform()[3]));
+}
+
+void RenderQueue::push(const Packet& packet, const glm::vec3& position)
+{
+  uint64_t key = static_cast<uint64_t>(packet.pass) << pass_shift;
+  if (packet.pass == RenderPass::Forward)
+  {
+    // Forward packets may blend, they keep the order they were pushed in
+    key |= static_cast<uint64_t>(_packets.size());
+  }
+  else
+  {
+    if (packet.object)
+      key |= object_program << program_shift;
+    else
+    {
+      key |= static_cast<uint64_t>(packet.program & 0xfff) << program_shift;
+      key |= static_cast<uint64_t>(packet.material->id() & 0xffff) << material_shift;
+      key |= static_cast<uint64_t>(packet.mesh->id() & 0xffff) << mesh_shift;
+    }
+    key |= depthBits(position);
+  }
+  _order.push_back({ key, static_cast<uint32_t>(_packets.size()) });
+  _packets.push_back(packet);
+}
+
+uint64_t RenderQueue::depthBits(const glm::vec3& position) const
+{
+  float depth = -(_view_transform * glm::vec4(position, 1.0f)).z;
+  float t = glm::clamp((depth - _near) / (_far - _near), 0.0f, 1.0f);
+  return static_cast<uint64_t>(t * 0xffff);
+}
+
+void RenderQueue::sort()
+{
+  _stats.n_packets = static_cast<unsigned int>(_packets.size());
+  _stats.n_state_changes_unsorted = countStateChanges();
+  if (_sorting)
+    radixSort(_order, _sort_buffer);
+  _stats.n_state_changes_sorted = countStateChanges();
+  mergeDraws();
+}
+
+void RenderQueue::mergeDraws()
+{
+  _draws.clear();
+  _instance_transforms.clear();
+  _instance_transforms_uploaded = false;
+  _commands.clear();
+  _commands_uploaded = false;
+  _stats.n_instanced_draw_calls = 0;
+  _stats.n_multi_draw_calls = 0;
+  for (uint32_t i = 0; i < _order.size(); )
+  {
+    const Packet& packet = _packets[_order[i].index];
+    if (_geometry_pool && !packet.object &&
+        packet.mesh->geometryPool() == _geometry_pool)
+    {
+      i = mergeMultiDraw(i);
+      continue;
+    }
+    uint32_t end = i + 1;
+    if (_instancing && !packet.object)
+    {
+      while (end < _order.size())
+      {
+        const Packet& next = _packets[_order[end].index];
+        if (next.object || next.pass != packet.pass ||
+            next.mesh != packet.mesh || next.material != packet.material)
+          break;
+        end++;
+      }
+    }
+
+    Draw draw = { i, end - i, 0, 0, 0 };
+    if (draw.n_instances > 1)
+    {
+      draw.first_instance = static_cast<uint32_t>(_instance_transforms.size());
+      for (uint32_t j = i; j < end; ++j)
+        _instance_transforms.push_back(*_packets[_order[j].index].transform);
+      _stats.n_instanced_draw_calls++;
+    }
+    _draws.push_back(draw);
+    i = end;
+  }
+  _stats.n_draw_calls = static_cast<unsigned int>(_draws.size());
+}
+
+uint32_t RenderQueue::mergeMultiDraw(uint32_t begin)
+{
+  const Packet& first = _packets[_order[begin].index];
+  Draw draw = {
+    begin, 0,
+    static_cast<uint32_t>(_instance_transforms.size()),
+    static_cast<uint32_t>(_commands.size()), 0 };
+  uint32_t end = begin;
+  while (end < _order.size())
+  {
+    const Packet& packet = _packets[_order[end].index];
+    if (packet.object || packet.pass != first.pass ||
+        packet.material != first.material ||
+        packet.mesh->geometryPool() != _geometry_pool)
+      break;
+    // Consecutive packets of the same mesh share a command when instancing
+    const Mesh* mesh = packet.mesh;
+    DrawElementsIndirectCommand command = {
+      mesh->numberOfElements(), 0, mesh->poolFirstIndex(),
+      mesh->poolBaseVertex(),
+      static_cast<GLuint>(_instance_transforms.size()) };
+    do
+    {
+      _instance_transforms.push_back(*_packets[_order[end].index].transform);
+      command.instance_count++;
+      end++;
+    } while (_instancing && end < _order.size() &&
+      _packets[_order[end].index].mesh == mesh &&
+      _packets[_order[end].index].material == first.material &&
+      _packets[_order[end].index].pass == first.pass);
+    _commands.push_back(command);
+    draw.n_commands++;
+  }
+  draw.n_instances = end - begin;
+  _draws.push_back(draw);
+  _stats.n_multi_draw_calls++;
+  return end;
+}
+
+void RenderQueue::uploadInstanceTransforms()
+{
+  GLsizeiptr size = sizeof(glm::mat4) * _instance_transforms.size();
+  if (!_instance_buffer)
+    _instance_buffer = std::make_unique<StreamingBuffer>(GL_ARRAY_BUFFER, size);
+  _instance_buffer->beginFrame();
+  _instance_offset = _instance_buffer->write(
+    _instance_transforms.data(), size, sizeof(glm::vec4));
+  _instance_transforms_uploaded = true;
+}
+
+void RenderQueue::radixSort(
+  std::vector<SortItem>& items, std::vector<SortItem>& buffer)
+{
+  if (items.size() < 2)
+    return;
+  buffer.resize(items.size());
+  for (int shift = 0; shift < 64; shift += 8)
+  {
+    size_t offsets[256] = { 0 };
+    for (auto& item : items)
+      offsets[(item.key >> shift) & 0xff]++;
+    // All keys have the same byte, the order would not change
+    if (offsets[(items[0].key >> shift) & 0xff] == items.size())
+      continue;
+
+    size_t sum = 0;
+    for (auto& offset : offsets)
+    {
+      size_t count = offset;
+      offset = sum;
+      sum += count;
+    }
+    for (auto& item : items)
+      buffer[offsets[(item.key >> shift) & 0xff]++] = item;
+    items.swap(buffer);
+  }
+}
+
+void RenderQueue::uploadCommands()
+{
+  GLsizeiptr size = sizeof(DrawElementsIndirectCommand) * _commands.size();
+  if (!_indirect_buffer)
+  {
+    _indirect_buffer =
+      std::make_unique<StreamingBuffer>(GL_DRAW_INDIRECT_BUFFER, size);
+  }
+  _indirect_buffer->beginFrame();
+  _commands_offset = _indirect_buffer->write(_commands.data(), size);
+  _commands_uploaded = true;
+}
+
+unsigned int RenderQueue::countStateChanges() const
+{
+  unsigned int n_changes = 0;
+  const Packet* previous = nullptr;
+  for (auto& item : _order)
+  {
+    const Packet& packet = _packets[item.index];
+    if (packet.object || !previous || previous->object)
+      n_changes++;
+    else
+    {
+      n_changes += packet.program != previous->program;
+      n_changes += packet.material != previous->material;
+      n_changes += packet.mesh != previous->mesh;
+    }
+    previous = &packet;
+  }
+  return n_changes;
+}
+
+void RenderQueue::render(RenderPass pass, const UsefulRenderData& render_data)
+{
+  if (!_instance_transforms_uploaded && !_instance_transforms.empty())
+    uploadInstanceTransforms();
+  if (!_commands_uploaded && !_commands.empty())
+    uploadCommands();
+
+  Material* current_material = nullptr;
+  Mesh* current_mesh = nullptr;
+  GLuint current_program = 0;
+  GLint model_location = -1;
+  for (auto& draw : _draws)
+  {
+    const Packet& packet = _packets[_order[draw.begin].index];
+    if (packet.pass != pass)
+      continue;
+
+    if (packet.object)
+    {
+      if (current_mesh)
+        current_mesh->unbind();
+      packet.render_object(*packet.object, render_data);
+      // The object may have changed any state
+      current_material = nullptr;
+      current_mesh = nullptr;
+      current_program = 0;
+      continue;
+    }
+
+    bool instanced = draw.n_instances > 1 || draw.n_commands > 0;
+    GLuint program = instanced ?
+      static_cast<GLuint>(packet.material->instancedProgramId()) :
+      packet.program;
+    if (packet.material != current_material || program != current_program)
+    {
+      if (instanced)
+        packet.material->useInstanced();
+      else
+        packet.material->use();
+      current_material = packet.material;
+      if (program != current_program)
+      {
+        current_program = program;
+        ShaderProgram& shader_program = instanced ?
+          packet.material->instancedProgram() : packet.material->program();
+        model_location = shader_program.uniformLocation(uniform_M);
+      }
+    }
+    if (draw.n_commands > 0)
+    {
+      if (current_mesh)
+        current_mesh->unbind();
+      current_mesh = nullptr;
+      _geometry_pool->bind();
+      _geometry_pool->multiDraw(
+        _commands, *_indirect_buffer, _commands_offset,
+        draw.first_command, draw.n_commands,
+        *_instance_buffer, _instance_offset);
+      continue;
+    }
+    if (packet.mesh != current_mesh)
+    {
+      if (current_mesh)
+        current_mesh->unbind();
+      packet.mesh->bind();
+      current_mesh = packet.mesh;
+    }
+    if (instanced)
+    {
+      packet.mesh->drawInstanced(
+        *_instance_buffer,
+        _instance_offset + draw.first_instance * sizeof(glm::mat4),
+        draw.n_instances);
+    }
+    else
+    {
+      setUniform(model_location, *packet.transform);
+      packet.mesh->draw();
+    }
+  }
+  if (current_mesh)
+    current_mesh->unbind();
+}
+
+} }
@@ -0,0 +1,75 @@
+#include "elk/core/render_scale_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace elk { namespace core {
+
+namespace {
+  // Weight of the newest frame in the moving average
+  const float smoothing = 0.1f;
+  // Frame times within this fraction of the budget keep the scale
+  const float tolerance = 0.05f;
+  // Largest change of the scale per update
+  const float max_step = 0.05f;
+  const int settle_frames = 4;
+}
+
+RenderScaleController::RenderScaleController(
+  float target_frame_time, float min_scale, float max_scale) :
+  _target_frame_time(target_frame_time),
+  _min_scale(min_scale),
+  _max_scale(max_scale),
+  _scale(max_scale),
+  _smoothed_frame_time(0.0f),
+  _settle_frames(0)
+{ }
+
+float RenderScaleController::update(float frame_time)
+{
+  // No measurement, e.g. a frame the profiler has no result for. It would
+  // also be taken for the unset average below
+  if (frame_time <= 0.0f)
+    return _scale;
+  _smoothed_frame_time = _smoothed_frame_time == 0.0f ? frame_time :
+    _smoothed_frame_time + smoothing * (frame_time - _smoothed_frame_time);
+  if (_settle_frames > 0)
+  {
+    _settle_frames--;
+    return _scale;
+  }
+  float ratio = _target_frame_time / _smoothed_frame_time;
+  if (std::abs(ratio - 1.0f) < tolerance)
+    return _scale;
+
+  float scale = _scale * std::sqrt(ratio);
+  scale = std::max(_scale - max_step, std::min(_scale + max_step, scale));
+  scale = std::max(_min_scale, std::min(_max_scale, scale));
+  if (scale != _scale)
+  {
+    _scale = scale;
+    _settle_frames = settle_frames;
+  }
+  return _scale;
+}
+
+void RenderScaleController::reset()
+{
+  _scale = _max_scale;
+  _smoothed_frame_time = 0.0f;
+  _settle_frames = 0;
+}
+
+void RenderScaleController::setTargetFrameTime(float target_frame_time)
+{
+  _target_frame_time = target_frame_time;
+}
+
+void RenderScaleController::setScaleRange(float min_scale, float max_scale)
+{
+  _min_scale = min_scale;
+  _max_scale = max_scale;
+  _scale = std::max(_min_scale, std::min(_max_scale, _scale));
+}
+
+} }
@@ -1,16 +1,31 @@
 #include "elk/core/renderer.h"
 
-namespace elk { namespace core {
+#include "elk/object_extensions/light_source.h"
+#include "elk/core/mesh.h"
+#include "elk/core/material.h"
+
+#include <algorithm>
 
+namespace elk { namespace core {
 
 Renderer::Renderer(PerspectiveCamera& camera, int window_width, int window_height) :
 	_camera(camera),
 	_window_width(window_width),
-	_window_height(window_height)
+	_window_height(window_height),
+  _start_time(std::chrono::steady_clock::now()),
+  _entity_registry(nullptr),
+  _frustum_culling(true),
+  _culling_stats({ 0, 0 }),
+  _retained_mode(false),
+  _retained_scene(nullptr),
+  _n_registered_renderables(0)
 { }
 
 Renderer::~Renderer()
-{ }
+{
+  // The objects of the scene must not keep a dangling listener
+  retainScene(nullptr);
+}
 
 void Renderer::setWindowResolution(int width, int height)
 {
@@ -19,18 +34,400 @@ void Renderer::setWindowResolution(int width, int height)
   _camera.setAspectRatio( static_cast<float>(width) / height);
 }
 
+void Renderer::updateViewUniforms()
+{
+  updateViewUniforms(
+    glm::vec4(0.0f, 0.0f, _window_width, _window_height), glm::vec2(1.0f));
+}
+
+void Renderer::updateViewUniforms(
+  const glm::vec4& viewport, const glm::vec2& render_scale)
+{
+  std::chrono::duration<float> time =
+    std::chrono::steady_clock::now() - _start_time;
+  _view_uniform_buffer.update(_camera, viewport, time.count(), render_scale);
+  _view_uniform_buffer.bind();
+}
+
+void Renderer::setFrustumCulling(bool enabled)
+{
+  _frustum_culling = enabled;
+}
+
+void Renderer::beginSubmission()
+{
+  _frustum = _frustum_culling ? Frustum(_camera) : Frustum();
+  _culling_stats = { 0, 0 };
+}
+
+bool Renderer::isCulled(const BoundingBox& world_bounding_box)
+{
+  _culling_stats.n_submitted++;
+  if (!_frustum_culling || _frustum.intersects(world_bounding_box))
+    return false;
+  _culling_stats.n_culled++;
+  return true;
+}
+
+void Renderer::setRetainedMode(bool retained)
+{
+  _retained_mode = retained;
+  if (!retained)
+    retainScene(nullptr);
+}
+
+void Renderer::setEntityRegistry(EntityRegistry* registry)
+{
+  _entity_registry = registry;
+}
+
+void Renderer::submitScene(Object3D& scene)
+{
+  beginSubmission();
+  if (_retained_mode)
+    submitRetainedScene(scene);
+  else
+    scene.submit(*this);
+  if (_entity_registry)
+    submitEntities(*_entity_registry);
+}
+
+void Renderer::submitRetainedScene(Object3D& scene)
+{
+  if (&scene != _retained_scene)
+    retainScene(&scene);
+  refitMovedSceneObjects();
+
+  size_t n_renderables_before =
+    _renderables_deferred_to_render.size() +
+    _renderables_forward_to_render.size();
+  if (_frustum_culling)
+  {
+    _visible_proxies.clear();
+    _bounding_volume_hierarchy.query(_frustum, _visible_proxies);
+    for (auto scene_object : _unbounded_scene_objects)
+      addToRenderLists(*scene_object);
+    for (auto proxy : _visible_proxies)
+    {
+      addToRenderLists(*static_cast<SceneObject*>(
+        _bounding_volume_hierarchy.userData(proxy)));
+    }
+  }
+  else
+  {
+    for (auto& scene_object : _scene_objects)
+      addToRenderLists(*scene_object.second);
+  }
+
+  // Renderables that were not added are culled
+  size_t n_visible =
+    _renderables_deferred_to_render.size() +
+    _renderables_forward_to_render.size() - n_renderables_before;
+  _culling_stats.n_submitted = _n_registered_renderables;
+  _culling_stats.n_culled =
+    _n_registered_renderables - static_cast<unsigned int>(n_visible);
+}
+
+void Renderer::submitEntities(const EntityRegistry& registry)
+{
+  _entity_meshes_to_render.clear();
+  _entity_point_lights_to_render.clear();
+  _entity_directional_lights_to_render.clear();
+  if (_frustum_culling)
+  {
+    registry.cull(
+      _frustum, _visible_entity_meshes, _visible_entity_point_lights);
+  }
+  else
+  {
+    _visible_entity_meshes.clear();
+    _visible_entity_point_lights.clear();
+  }
+
+  // Components added or removed after the last
+  // EntityRegistry::updateTransforms() leave everything visible, cull()
+  // checks the structure version of the registry
+  const auto& meshes = registry.meshes();
+  for (size_t i = 0; i < meshes.size(); ++i)
+  {
+    // A mesh is only rendered together with a material
+    if (!registry.materials().contains(meshes.entity(i)))
+      continue;
+    _culling_stats.n_submitted++;
+    if (i < _visible_entity_meshes.size() && !_visible_entity_meshes[i])
+    {
+      _culling_stats.n_culled++;
+      continue;
+    }
+    _entity_meshes_to_render.push_back(i);
+  }
+  for (size_t i = 0; i < registry.pointLights().size(); ++i)
+  {
+    if (i >= _visible_entity_point_lights.size() ||
+        _visible_entity_point_lights[i])
+      _entity_point_lights_to_render.push_back(i);
+  }
+  for (size_t i = 0; i < registry.directionalLights().size(); ++i)
+    _entity_directional_lights_to_render.push_back(i);
+}
+
+void Renderer::setSortDraws(bool sort)
+{
+  _render_queue.setSorting(sort);
+}
+
+void Renderer::setInstancedDraws(bool instanced)
+{
+  _render_queue.setInstancing(instanced);
+}
+
+void Renderer::setGeometryPooling(bool pooling)
+{
+  if (pooling && !_geometry_pool)
+    _geometry_pool = std::make_unique<GeometryPool>();
+  else if (!pooling)
+    _geometry_pool.reset();
+  _render_queue.setGeometryPool(_geometry_pool.get());
+}
+
+void Renderer::fillRenderQueue()
+{
+  _render_queue.begin(_camera);
+  for (auto renderable : _renderables_deferred_to_render)
+  {
+    Mesh* mesh = renderable->renderedMesh();
+    Material* material = renderable->renderedMaterial();
+    if (mesh && material)
+    {
+      if (_geometry_pool)
+        _geometry_pool->add(*mesh);
+      _render_queue.push(RenderPass::Geometry,
+        *mesh, *material, renderable->absoluteTransform());
+    }
+    else
+      _render_queue.push(RenderPass::Geometry, *renderable);
+  }
+  _renderables_deferred_to_render.clear();
+
+  if (_entity_registry)
+  {
+    const auto& meshes = _entity_registry->meshes();
+    for (auto i : _entity_meshes_to_render)
+    {
+      if (_geometry_pool)
+        _geometry_pool->add(*meshes[i].mesh);
+      _render_queue.push(RenderPass::Geometry,
+        *meshes[i].mesh,
+        *_entity_registry->materials().find(meshes.entity(i))->material,
+        _entity_registry->worldTransform(meshes, i));
+    }
+  }
+  _entity_meshes_to_render.clear();
+
+  for (auto renderable : _renderables_forward_to_render)
+    _render_queue.push(RenderPass::Forward, *renderable);
+  _renderables_forward_to_render.clear();
+
+  _render_queue.sort();
+}
+
+void Renderer::retainScene(Object3D* scene)
+{
+  if (_retained_scene && _retained_scene->sceneListener() == this)
+    _retained_scene->setSceneListener(nullptr);
+  _retained_scene = scene;
+  // Registers all objects of the scene
+  if (_retained_scene)
+    _retained_scene->setSceneListener(this);
+}
+
+void Renderer::objectAttached(Object3D& object)
+{
+  SceneObjectType type;
+  if (dynamic_cast<RenderableDeferred*>(&object))
+    type = SceneObjectType::RenderableDeferred;
+  else if (dynamic_cast<RenderableForward*>(&object))
+    type = SceneObjectType::RenderableForward;
+  else if (dynamic_cast<PointLightSource*>(&object))
+    type = SceneObjectType::PointLightSource;
+  else if (dynamic_cast<DirectionalLightSource*>(&object))
+    type = SceneObjectType::DirectionalLightSource;
+  else
+    return;
+
+  auto scene_object = std::make_unique<SceneObject>();
+  scene_object->object = &object;
+  scene_object->type = type;
+  scene_object->moved = false;
+  BoundingBox box = worldBoundingBox(*scene_object);
+  if (box.isInfinite())
+  {
+    scene_object->proxy = -1;
+    scene_object->unbounded_index = _unbounded_scene_objects.size();
+    _unbounded_scene_objects.push_back(scene_object.get());
+  }
+  else
+  {
+    scene_object->proxy =
+      _bounding_volume_hierarchy.insert(box, scene_object.get());
+  }
+  if (isRenderable(*scene_object))
+    _n_registered_renderables++;
+  _scene_objects[&object] = std::move(scene_object);
+}
+
+void Renderer::objectDetached(Object3D& object)
+{
+  // Called from ~Object3D too, the object may only be used as a key here
+  if (&object == _retained_scene)
+    _retained_scene = nullptr;
+  auto it = _scene_objects.find(&object);
+  if (it == _scene_objects.end())
+    return;
+
+  SceneObject& scene_object = *it->second;
+  if (scene_object.proxy >= 0)
+    _bounding_volume_hierarchy.remove(scene_object.proxy);
+  else
+  {
+    // Swap with the last one
+    SceneObject* last = _unbounded_scene_objects.back();
+    _unbounded_scene_objects[scene_object.unbounded_index] = last;
+    last->unbounded_index = scene_object.unbounded_index;
+    _unbounded_scene_objects.pop_back();
+  }
+  if (scene_object.moved)
+  {
+    _moved_scene_objects.erase(std::remove(
+      _moved_scene_objects.begin(), _moved_scene_objects.end(),
+      &scene_object), _moved_scene_objects.end());
+  }
+  if (isRenderable(scene_object))
+    _n_registered_renderables--;
+  _scene_objects.erase(it);
+}
+
+void Renderer::objectMoved(Object3D& object)
+{
+  // Objects are not attached or detached during the update, so only the
+  // moved list needs guarding
+  std::lock_guard<std::mutex> lock(_moved_scene_objects_mutex);
+  auto it = _scene_objects.find(&object);
+  if (it == _scene_objects.end() || it->second->moved)
+    return;
+  it->second->moved = true;
+  _moved_scene_objects.push_back(it->second.get());
+}
+
+void Renderer::refitMovedSceneObjects()
+{
+  for (auto scene_object : _moved_scene_objects)
+  {
+    scene_object->moved = false;
+    if (scene_object->proxy >= 0)
+    {
+      _bounding_volume_hierarchy.move(
+        scene_object->proxy, worldBoundingBox(*scene_object));
+    }
+  }
+  _moved_scene_objects.clear();
+}
+
+void Renderer::addToRenderLists(const SceneObject& scene_object)
+{
+  switch (scene_object.type)
+  {
+    case SceneObjectType::RenderableDeferred :
+      _renderables_deferred_to_render.push_back(
+        static_cast<RenderableDeferred*>(scene_object.object));
+      break;
+    case SceneObjectType::RenderableForward :
+      _renderables_forward_to_render.push_back(
+        static_cast<RenderableForward*>(scene_object.object));
+      break;
+    case SceneObjectType::PointLightSource :
+      _point_light_sources_to_render.push_back(
+        static_cast<PointLightSource*>(scene_object.object));
+      break;
+    case SceneObjectType::DirectionalLightSource :
+      _directional_light_sources_to_render.push_back(
+        static_cast<DirectionalLightSource*>(scene_object.object));
+      break;
+  }
+}
+
+bool Renderer::isRenderable(const SceneObject& scene_object)
+{
+  return scene_object.type == SceneObjectType::RenderableDeferred ||
+    scene_object.type == SceneObjectType::RenderableForward;
+}
+
+BoundingBox Renderer::worldBoundingBox(const SceneObject& scene_object)
+{
+  switch (scene_object.type)
+  {
+    case SceneObjectType::RenderableDeferred :
+      return static_cast<RenderableDeferred*>(
+        scene_object.object)->worldBoundingBox();
+    case SceneObjectType::RenderableForward :
+      return static_cast<RenderableForward*>(
+        scene_object.object)->worldBoundingBox();
+    case SceneObjectType::PointLightSource :
+      return static_cast<PointLightSource*>(
+        scene_object.object)->worldBoundingBox();
+    default :
+      return BoundingBox::infinite();
+  }
+}
+
+std::vector<Object3D*> Renderer::objectsIntersecting(
+  const BoundingBox& box) const
+{
+  std::vector<int> proxies;
+  _bounding_volume_hierarchy.query(box, proxies);
+  std::vector<Object3D*> objects;
+  for (auto proxy : proxies)
+  {
+    objects.push_back(static_cast<SceneObject*>(
+      _bounding_volume_hierarchy.userData(proxy))->object);
+  }
+  return objects;
+}
+
+Object3D* Renderer::pick(
+  const glm::vec3& origin, const glm::vec3& direction) const
+{
+  std::vector<std::pair<int, float>> hits;
+  _bounding_volume_hierarchy.raycast(origin, direction, hits);
+  for (auto& hit : hits)
+  {
+    auto scene_object = static_cast<SceneObject*>(
+      _bounding_volume_hierarchy.userData(hit.first));
+    if (isRenderable(*scene_object))
+      return scene_object->object;
+  }
+  return nullptr;
+}
+
 void Renderer::submitRenderableDeferred(RenderableDeferred& renderable)
 {
+  if (isCulled(renderable.worldBoundingBox()))
+    return;
   _renderables_deferred_to_render.push_back(&renderable);
 }
 
 void Renderer::submitRenderableForward(RenderableForward& renderable)
 {
+  if (isCulled(renderable.worldBoundingBox()))
+    return;
   _renderables_forward_to_render.push_back(&renderable);
 }
 
 void Renderer::submitPointLightSource(PointLightSource& light_source)
 {
+  // Lights are not counted in the culling stats
+  if (_frustum_culling && !_frustum.intersects(light_source.worldBoundingBox()))
+    return;
   _point_light_sources_to_render.push_back(&light_source);
 }
 
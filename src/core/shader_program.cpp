@@ -1,13 +1,93 @@
 #include "elk/core/shader_program.h"
 
 #include "elk/core/file_utils.h"
+#include "elk/core/gl_state.h"
+#include "elk/core/view_uniform_buffer.h"
 
+#include <algorithm>
 #include <array>
+#include <sstream>
+#include <unordered_map>
 #include <vector>
 
 namespace elk { namespace core {
 
-std::stack<GLuint> ShaderProgram::_shader_stack;
+std::stack<ShaderProgram*> ShaderProgram::_shader_stack;
+
+namespace {
+  // Interned uniform names, indexed by id. Function statics so that names
+  // can be interned during static initialization
+  std::vector<std::string>& internedNames()
+  {
+    static std::vector<std::string> names;
+    return names;
+  }
+
+  unsigned int intern(const std::string& name)
+  {
+    static std::unordered_map<std::string, unsigned int> ids;
+    auto it = ids.find(name);
+    if (it != ids.end())
+      return it->second;
+    unsigned int id = static_cast<unsigned int>(internedNames().size());
+    internedNames().push_back(name);
+    ids[name] = id;
+    return id;
+  }
+
+  // Source of the shader at \param path with lines #include "file" replaced
+  // by that file, found relative to the including one. GLSL has no includes
+  // of its own. #line directives before and after each included file keep
+  // the line numbers of compilation errors right, their source string
+  // number is the index of the file in \param files
+  std::string readShaderSource(
+    const std::string& path, std::vector<std::string>& files, int depth = 0)
+  {
+    int file_index = static_cast<int>(files.size());
+    files.push_back(path);
+    std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+    std::istringstream lines(read_file(path.c_str()));
+    std::string source;
+    std::string line;
+    for (int line_number = 1; std::getline(lines, line); ++line_number)
+    {
+      size_t first = line.find_first_not_of(" \t");
+      if (first == std::string::npos || line.compare(first, 8, "#include") != 0)
+      {
+        source += line + "\n";
+        continue;
+      }
+      size_t begin = line.find('"', first);
+      size_t end = begin == std::string::npos ?
+        std::string::npos : line.find('"', begin + 1);
+      if (end == std::string::npos || depth > 8)
+      {
+        fprintf(stderr, "ERROR : Invalid #include in %s line %d\n",
+          path.c_str(), line_number);
+        continue;
+      }
+      source += "#line 1 " + std::to_string(files.size()) + "\n";
+      source += readShaderSource(
+        directory + line.substr(begin + 1, end - begin - 1), files, depth + 1);
+      source += "#line " + std::to_string(line_number + 1) + " " +
+        std::to_string(file_index) + "\n";
+    }
+    return source;
+  }
+}
+
+UniformName::UniformName(const char* name) :
+  _id(intern(name))
+{ }
+
+UniformName::UniformName(const std::string& name) :
+  _id(intern(name))
+{ }
+
+const std::string& UniformName::str() const
+{
+  return internedNames()[_id];
+}
 
 ShaderProgram::ShaderProgram(
 	std::string name,
@@ -18,30 +98,45 @@ ShaderProgram::ShaderProgram(
 	const char* fs_src) :
   _name(name)
 {
-  _id = loadShaderProgram(vs_src, tcs_src, tes_src, gs_src, fs_src);
+  _id = loadShaderProgram(vs_src, tcs_src, tes_src, gs_src, fs_src, nullptr);
+  reflectUniforms();
+  bindUniformBlocks();
+}
+
+ShaderProgram::ShaderProgram(std::string name, const char* cs_src) :
+  _name(name)
+{
+  _id = loadShaderProgram(nullptr, nullptr, nullptr, nullptr, nullptr, cs_src);
+  reflectUniforms();
+  bindUniformBlocks();
 }
 
 ShaderProgram::~ShaderProgram()
 {
-  glDeleteProgram(_id);
+  GLState::deleteProgram(_id);
 }
 
 void ShaderProgram::pushUsage()
 {
-  _shader_stack.push(_id);
-  glUseProgram(_shader_stack.top());
+  _shader_stack.push(this);
+  GLState::useProgram(_id);
 }
 
 void ShaderProgram::popUsage()
 {
   _shader_stack.pop();
-  glUseProgram(_shader_stack.empty() ? 0 : _shader_stack.top());
+  GLState::useProgram(_shader_stack.empty() ? 0 : _shader_stack.top()->id());
 }
 
 void ShaderProgram::useNone()
 {
-  _shader_stack = std::stack<GLuint>();
-  glUseProgram(0);
+  _shader_stack = std::stack<ShaderProgram*>();
+  GLState::useProgram(0);
+}
+
+bool ShaderProgram::computeShadersSupported()
+{
+  return GLEW_VERSION_4_3 || GLEW_ARB_compute_shader;
 }
 
 // https://www.omniref.com/ruby/gems/opengl-bindings/1.3.5/symbols/OpenGL::GL_TESS_CONTROL_SHADER
@@ -57,23 +152,28 @@ void ShaderProgram::useNone()
 #ifndef GL_PATCHES
     #define GL_PATCHES 0x000E
 #endif
+#ifndef GL_COMPUTE_SHADER
+    #define GL_COMPUTE_SHADER 0x91B9
+#endif
 
 GLuint ShaderProgram::loadShaderProgram(
     const char* vs_src,
     const char* tcs_src,
     const char* tes_src,
     const char* gs_src,
-    const char* fs_src)
+    const char* fs_src,
+    const char* cs_src)
 {
-  std::array<const char*, 5> paths = {{vs_src,tcs_src,tes_src,gs_src,fs_src}};
-  std::array<GLenum, 5> types = {{
+  std::array<const char*, 6> paths = {{
+    vs_src,tcs_src,tes_src,gs_src,fs_src,cs_src}};
+  std::array<GLenum, 6> types = {{
     GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER,
-    GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER}};
-  std::array<std::string, 5> types_names = {{
+    GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER, GL_COMPUTE_SHADER}};
+  std::array<std::string, 6> types_names = {{
     "vertex shader", "tesselation control shader", "tesselation evaluation shader",
-    "geometry shader", "fragment shader"}};
-  std::array<GLuint, 5> ids = {{0,0,0,0,0}};
-  std::array<std::string, 5> code;
+    "geometry shader", "fragment shader", "compute shader"}};
+  std::array<GLuint, 6> ids = {{0,0,0,0,0,0}};
+  std::array<std::string, 6> code;
 
   GLint result = 0;
   int info_log_length;
@@ -84,7 +184,8 @@ GLuint ShaderProgram::loadShaderProgram(
   for (int i = 0; i < ids.size(); ++i)
   {
     // Try to create shader
-    code[i] = paths[i] ? read_file(paths[i])  : "";
+    std::vector<std::string> files;
+    code[i] = paths[i] ? readShaderSource(paths[i], files) : "";
     ids[i] = (code[i] != "") ? glCreateShader(types[i]) : 0;
     
     if (ids[i])
@@ -104,6 +205,9 @@ GLuint ShaderProgram::loadShaderProgram(
         fprintf(stdout,"COMPILATION %s", &error_message[0]);
         fprintf(stdout, "in file %s \n",
           paths[i]);
+        // Errors are reported as source string number(line number)
+        for (size_t file = 1; file < files.size(); ++file)
+          fprintf(stdout, "  %zu: %s\n", file, files[file].c_str());
       }
       glAttachShader(program_id, ids[i]);
       glDeleteShader(ids[i]);
@@ -125,6 +229,89 @@ GLuint ShaderProgram::loadShaderProgram(
   return program_id;
 }
 
-} }
+void ShaderProgram::reflectUniforms()
+{
+  GLint n_uniforms = 0;
+  GLint max_name_length = 0;
+  glGetProgramiv(_id, GL_ACTIVE_UNIFORMS, &n_uniforms);
+  glGetProgramiv(_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+  std::vector<char> name_buffer(std::max(max_name_length, 1));
+
+  auto addLocation = [this](const std::string& name, GLint location) {
+    unsigned int id = UniformName(name).id();
+    if (id >= _locations.size())
+      _locations.resize(id + 1, -1);
+    _locations[id] = location;
+  };
+
+  for (GLint i = 0; i < n_uniforms; ++i)
+  {
+    UniformInfo info;
+    glGetActiveUniform(_id, i, static_cast<GLsizei>(name_buffer.size()), nullptr,
+      &info.size, &info.type, &name_buffer[0]);
+    info.name = &name_buffer[0];
+    // Uniforms in uniform blocks have no location
+    info.location = glGetUniformLocation(_id, info.name.c_str());
+    if (info.location == -1)
+      continue;
+    // Arrays are reported as "name[0]"
+    size_t bracket = info.name.rfind("[0]");
+    if (bracket != std::string::npos && bracket + 3 == info.name.size())
+    {
+      info.name.erase(bracket);
+      for (GLint j = 0; j < info.size; ++j)
+      {
+        std::string element = info.name + "[" + std::to_string(j) + "]";
+        addLocation(element, glGetUniformLocation(_id, element.c_str()));
+      }
+    }
+    addLocation(info.name, info.location);
+    _uniforms.push_back(info);
+  }
+}
+
+void ShaderProgram::bindUniformBlocks()
+{
+  GLuint index = glGetUniformBlockIndex(_id, ViewUniformBuffer::block_name);
+  if (index != GL_INVALID_INDEX)
+    glUniformBlockBinding(_id, index, ViewUniformBuffer::binding);
+}
 
+bool ShaderProgram::hasType(const UniformName& name, GLenum type) const
+{
+  // Elements of arrays have the type of the array
+  std::string base_name = name.str();
+  if (!base_name.empty() && base_name.back() == ']')
+    base_name.erase(base_name.rfind('['));
+  for (auto& info : _uniforms)
+  {
+    if (info.name != base_name)
+      continue;
+    if (info.type == type)
+      return true;
+    // Samplers, images and booleans are set as integers
+    if (type != GL_INT)
+      return false;
+    switch (info.type)
+    {
+      case GL_BOOL:
+      case GL_SAMPLER_1D:
+      case GL_SAMPLER_2D:
+      case GL_SAMPLER_3D:
+      case GL_SAMPLER_CUBE:
+      case GL_SAMPLER_2D_SHADOW:
+      case GL_SAMPLER_2D_ARRAY:
+      case GL_SAMPLER_BUFFER:
+      case GL_INT_SAMPLER_BUFFER:
+      case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+      case GL_SAMPLER_2D_MULTISAMPLE:
+      case GL_IMAGE_2D:
+        return true;
+      default:
+        return false;
+    }
+  }
+  return false;
+}
 
+} }
\ No newline at end of file
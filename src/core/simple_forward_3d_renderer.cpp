@@ -1,5 +1,10 @@
 #include "elk/core/simple_forward_3d_renderer.h"
 
+#include "elk/core/gl_state.h"
+
+#include <cassert>
+#include <cstdio>
+
 namespace elk { namespace core {
 
 SimpleForward3DRenderer::SimpleForward3DRenderer(
@@ -16,17 +21,31 @@ SimpleForward3DRenderer::~SimpleForward3DRenderer()
 
 void SimpleForward3DRenderer::render(Object3D& scene)
 {
+  GLState::beginFrame();
   // Submit all objects in the scene to the lists of renderable objects
-  scene.submit(*this);
+  submitScene(scene);
+  fillRenderQueue();
+  updateViewUniforms();
 
-  glViewport(0,0, _window_width, _window_height);
+  GLState::viewport(0,0, _window_width, _window_height);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  for (auto renderable : _renderables_forward_to_render)
-    renderable->render({ _camera });
-  _renderables_forward_to_render.clear();  
+  _render_queue.render(RenderPass::Forward, { _camera });
 
   checkForErrors();
 }
 
+void SimpleForward3DRenderer::setEntityRegistry(EntityRegistry* registry)
+{
+  // Materials only have G-buffer programs, this renderer has no geometry
+  // pass to draw entity meshes in
+  assert(!registry);
+  if (registry)
+  {
+    fprintf(stderr,
+      "ERROR : Entities can not be rendered by SimpleForward3DRenderer\n");
+  }
+  Renderer::setEntityRegistry(nullptr);
+}
+
 } }
@@ -0,0 +1,149 @@
+#include "elk/core/streaming_buffer.h"
+
+#include "elk/core/gl_state.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace elk { namespace core {
+
+namespace {
+  const GLbitfield persistent_flags =
+    GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  // One second, in nanoseconds
+  const GLuint64 fence_timeout = 1000000000;
+}
+
+StreamingBuffer::StreamingBuffer(
+  GLenum target, GLsizeiptr region_size, int n_regions) :
+  _target(target),
+  _id(0),
+  _persistent(persistentMappingSupported()),
+  _n_regions(_persistent ? std::max(n_regions, 1) : 1),
+  _region_size(0),
+  _region(0),
+  _offset(0),
+  _mapping(nullptr),
+  _fences(_n_regions, nullptr),
+  _n_stalls(0),
+  _n_allocations(0)
+{
+  allocate(std::max(region_size, GLsizeiptr(1)));
+}
+
+StreamingBuffer::~StreamingBuffer()
+{
+  release();
+}
+
+void StreamingBuffer::beginFrame()
+{
+  _offset = 0;
+  if (!_persistent)
+  {
+    // The driver gives the buffer new storage if the old one is in use
+    bind();
+    glBufferData(_target, _region_size, nullptr, GL_STREAM_DRAW);
+    return;
+  }
+  if (_fences[_region])
+    glDeleteSync(_fences[_region]);
+  _fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  _region = (_region + 1) % _n_regions;
+  GLsync fence = _fences[_region];
+  if (!fence)
+    return;
+  GLenum result = glClientWaitSync(fence, 0, 0);
+  if (result == GL_TIMEOUT_EXPIRED)
+  {
+    _n_stalls++;
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    do
+    {
+      result = glClientWaitSync(fence, flags, fence_timeout);
+      flags = 0;
+    } while (result == GL_TIMEOUT_EXPIRED);
+  }
+  if (result == GL_WAIT_FAILED)
+    fprintf(stderr, "ERROR : Waiting for a streaming buffer fence failed\n");
+  glDeleteSync(fence);
+  _fences[_region] = nullptr;
+}
+
+GLintptr StreamingBuffer::write(
+  const void* data, GLsizeiptr size, GLsizeiptr alignment)
+{
+  GLsizeiptr region_offset = _region * _region_size;
+  // Aligned relative to the start of the buffer
+  GLsizeiptr start =
+    (region_offset + _offset + alignment - 1) / alignment * alignment;
+  if (start + size > region_offset + _region_size)
+  {
+    allocate(std::max(2 * _region_size, size + alignment));
+    region_offset = _region * _region_size;
+    start = (region_offset + alignment - 1) / alignment * alignment;
+  }
+  if (_persistent)
+    memcpy(_mapping + start, data, size);
+  else
+  {
+    bind();
+    glBufferSubData(_target, start, size, data);
+  }
+  _offset = start + size - region_offset;
+  return start;
+}
+
+void StreamingBuffer::bind()
+{
+  GLState::bindBuffer(_target, _id);
+}
+
+bool StreamingBuffer::persistentMappingSupported()
+{
+  return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+void StreamingBuffer::allocate(GLsizeiptr region_size)
+{
+  // A buffer deleted while the GPU reads it lives on until it is done
+  release();
+  _region_size = region_size;
+  _region = 0;
+  _offset = 0;
+  _n_allocations++;
+  glGenBuffers(1, &_id);
+  bind();
+  if (_persistent)
+  {
+    GLsizeiptr size = _region_size * _n_regions;
+    glBufferStorage(_target, size, nullptr, persistent_flags);
+    _mapping = static_cast<char*>(
+      glMapBufferRange(_target, 0, size, persistent_flags));
+  }
+  else
+    glBufferData(_target, _region_size, nullptr, GL_STREAM_DRAW);
+}
+
+void StreamingBuffer::release()
+{
+  for (auto& fence : _fences)
+  {
+    if (fence)
+      glDeleteSync(fence);
+    fence = nullptr;
+  }
+  if (!_id)
+    return;
+  if (_mapping)
+  {
+    bind();
+    glUnmapBuffer(_target);
+    _mapping = nullptr;
+  }
+  GLState::deleteBuffer(_id);
+  _id = 0;
+}
+
+} }
@@ -1,4 +1,5 @@
 #include "elk/core/texture.h"
+#include "elk/core/gl_state.h"
 #include <cassert>
 #include <cstring>
 
@@ -41,7 +42,7 @@ Texture::Texture(
 Texture::~Texture()
 {
   if (_id) {
-    glDeleteTextures(1, &_id);
+    GLState::deleteTexture(_id);
   }
 
   if (_has_ownership_of_data) {
@@ -91,7 +92,7 @@ void Texture::disable() const
 
 void Texture::bind() const
 {
-  glBindTexture(_type, _id);
+  GLState::bindTexture(_type, _id);
 }
 
 void Texture::applyFilter()
@@ -149,6 +150,13 @@ void Texture::generateMipMap()
   glGenerateMipmap(_type);
 }
 
+void Texture::generateMipMap(int max_level)
+{
+  bind();
+  glTexParameteri(_type, GL_TEXTURE_MAX_LEVEL, max_level);
+  glGenerateMipmap(_type);
+}
+
 int Texture::numberOfChannels() const
 {
   return numberOfChannels(_format);
@@ -0,0 +1,41 @@
+#include "elk/core/texture_buffer.h"
+
+#include "elk/core/gl_state.h"
+
+namespace elk { namespace core {
+
+TextureBuffer::TextureBuffer(
+  GLenum internal_format, GLsizeiptr texel_size, GLsizeiptr region_size) :
+  _buffer(GL_TEXTURE_BUFFER, region_size),
+  _texture(0),
+  _internal_format(internal_format),
+  _texel_size(texel_size),
+  _attached_allocation(0)
+{
+  glGenTextures(1, &_texture);
+}
+
+TextureBuffer::~TextureBuffer()
+{
+  GLState::deleteTexture(_texture);
+}
+
+GLint TextureBuffer::update(const void* data, GLsizeiptr size)
+{
+  _buffer.beginFrame();
+  GLintptr offset = _buffer.write(data, size, _texel_size);
+  if (_attached_allocation != _buffer.nAllocations())
+  {
+    bind();
+    glTexBuffer(GL_TEXTURE_BUFFER, _internal_format, _buffer.id());
+    _attached_allocation = _buffer.nAllocations();
+  }
+  return static_cast<GLint>(offset / _texel_size);
+}
+
+void TextureBuffer::bind()
+{
+  GLState::bindTexture(GL_TEXTURE_BUFFER, _texture);
+}
+
+} }
@@ -1,5 +1,7 @@
 #include "elk/core/texture_unit.h"
 
+#include "elk/core/gl_state.h"
+
 namespace elk { namespace core {
 
 bool TextureUnit::_initialized = false;
@@ -28,7 +30,7 @@ void TextureUnit::activate() {
     if (!_assigned) {
         assignUnit();
     }
-    glActiveTexture(_glEnum);
+    GLState::activeTexture(_glEnum);
 }
 
 GLint TextureUnit::glEnum() {
@@ -50,7 +52,7 @@ TextureUnit::operator GLint() {
 }
 
 void TextureUnit::setZeroUnit() {
-    glActiveTexture(GL_TEXTURE0);
+    GLState::activeTexture(GL_TEXTURE0);
 }
 
 int TextureUnit::numberActiveUnits() {
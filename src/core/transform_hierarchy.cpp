@@ -0,0 +1,166 @@
+#include "elk/core/transform_hierarchy.h"
+
+#include "elk/core/object_3d.h"
+#include "elk/core/scene_listener.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace elk { namespace core {
+
+TransformHierarchy::TransformHierarchy() :
+  _root(nullptr),
+  _valid(false)
+{ }
+
+TransformHierarchy::~TransformHierarchy()
+{
+  clear();
+}
+
+void TransformHierarchy::build(Object3D& root)
+{
+  clear();
+  _root = &root;
+
+  // Depth first traversal, children are pushed in reverse order to keep
+  // the order of the siblings
+  std::vector<std::pair<Object3D*, int>> stack;
+  stack.push_back({ &root, -1 });
+  while (!stack.empty())
+  {
+    Object3D* node = stack.back().first;
+    int parent_index = stack.back().second;
+    stack.pop_back();
+
+    // The node can only be part of one hierarchy at a time
+    if (node->_transform_hierarchy)
+      node->_transform_hierarchy->detach(*node);
+
+    int index = static_cast<int>(_nodes.size());
+    _nodes.push_back(node);
+    _parent_indices.push_back(parent_index);
+    _local_transforms.push_back(node->_relative_transform);
+    _world_transforms.push_back(node->_absolute_transform);
+    node->_transform_hierarchy = this;
+    node->_transform_index = index;
+
+    for (auto it = node->_children.rbegin(); it != node->_children.rend(); ++it)
+      stack.push_back({ *it, index });
+  }
+
+  // Children come after their parents so the subtree ends can be
+  // accumulated backwards
+  _subtree_ends.resize(_nodes.size());
+  for (int i = static_cast<int>(_nodes.size()) - 1; i >= 0; --i)
+  {
+    _subtree_ends[i] = std::max(_subtree_ends[i], i + 1);
+    if (_parent_indices[i] >= 0)
+    {
+      _subtree_ends[_parent_indices[i]] =
+        std::max(_subtree_ends[_parent_indices[i]], _subtree_ends[i]);
+    }
+  }
+  _dirty.assign(_nodes.size(), 0);
+  _valid = true;
+}
+
+void TransformHierarchy::clear()
+{
+  for (auto node : _nodes)
+  {
+    if (node && node->_transform_hierarchy == this)
+      detach(*node);
+  }
+  _nodes.clear();
+  _parent_indices.clear();
+  _local_transforms.clear();
+  _world_transforms.clear();
+  _subtree_ends.clear();
+  _dirty_indices.clear();
+  _dirty.clear();
+  _root = nullptr;
+  _valid = false;
+}
+
+void TransformHierarchy::update()
+{
+  for (size_t i = 0; i < _nodes.size(); ++i)
+  {
+    int parent_index = _parent_indices[i];
+    _world_transforms[i] = parent_index < 0 ?
+      _local_transforms[i] :
+      _world_transforms[parent_index] * _local_transforms[i];
+    notifyMoved(static_cast<int>(i));
+  }
+  for (auto index : _dirty_indices)
+    _dirty[index] = 0;
+  _dirty_indices.clear();
+}
+
+unsigned int TransformHierarchy::updateDirty()
+{
+  unsigned int n_updated = 0;
+  // Sorted, a subtree that is contained in an already updated one is skipped
+  std::sort(_dirty_indices.begin(), _dirty_indices.end());
+  int updated_end = 0;
+  for (auto index : _dirty_indices)
+  {
+    _dirty[index] = 0;
+    if (index < updated_end)
+      continue;
+    updated_end = _subtree_ends[index];
+    for (int i = index; i < updated_end; ++i)
+    {
+      int parent_index = _parent_indices[i];
+      _world_transforms[i] = parent_index < 0 ?
+        _local_transforms[i] :
+        _world_transforms[parent_index] * _local_transforms[i];
+      notifyMoved(i);
+    }
+    n_updated += updated_end - index;
+  }
+  _dirty_indices.clear();
+  return n_updated;
+}
+
+void TransformHierarchy::setLocalTransform(int index, const glm::mat4& transform)
+{
+  _local_transforms[index] = transform;
+  if (!_dirty[index])
+  {
+    _dirty[index] = 1;
+    std::lock_guard<std::mutex> lock(_dirty_indices_mutex);
+    _dirty_indices.push_back(index);
+  }
+}
+
+void TransformHierarchy::remove(Object3D& node)
+{
+  _nodes[node._transform_index] = nullptr;
+  node._transform_hierarchy = nullptr;
+  node._transform_index = -1;
+  if (&node == _root)
+    _root = nullptr;
+  invalidate();
+}
+
+void TransformHierarchy::detach(Object3D& node)
+{
+  // Copy the transforms back so that the node can be used on its own
+  node._relative_transform = _local_transforms[node._transform_index];
+  node._absolute_transform = _world_transforms[node._transform_index];
+  _nodes[node._transform_index] = nullptr;
+  node._transform_hierarchy = nullptr;
+  node._transform_index = -1;
+  invalidate();
+}
+
+void TransformHierarchy::notifyMoved(int index)
+{
+  Object3D* node = _nodes[index];
+  if (node && node->_scene_listener)
+    node->_scene_listener->objectMoved(*node);
+}
+
+} }
@@ -9,7 +9,7 @@ VertexArray::VertexArray()
 
 VertexArray::~VertexArray()
 {
-  glDeleteVertexArrays(1, &_id);
+  GLState::deleteVertexArray(_id);
 }
 
 void VertexArray::addBuffer(
@@ -30,6 +30,8 @@ void VertexArray::addBuffer(
     normalized,
     0, // stride
     static_cast<void*>(0) ); // array buffer offset
+  // Enabled arrays are part of the vertex array state, enabled once here
+  glEnableVertexAttribArray(attribute_index);
 }
 
 void VertexArray::enableAttribArrays()
@@ -0,0 +1,61 @@
+#include "elk/core/view_uniform_buffer.h"
+
+#include "elk/core/camera.h"
+
+namespace elk { namespace core {
+
+static_assert(sizeof(ViewUniforms) == 5 * 64 + 16 + 16,
+  "ViewUniforms must match the std140 layout of the shader block");
+
+const GLuint ViewUniformBuffer::binding;
+const char* const ViewUniformBuffer::block_name = "ViewUniforms";
+
+namespace {
+  GLint uniformBufferOffsetAlignment()
+  {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return alignment;
+  }
+}
+
+ViewUniformBuffer::ViewUniformBuffer() :
+  _offset_alignment(uniformBufferOffsetAlignment()),
+  // Room for one update per frame wherever the region starts
+  _buffer(GL_UNIFORM_BUFFER, sizeof(ViewUniforms) + _offset_alignment),
+  _offset(0),
+  _uniforms(),
+  _updated(false)
+{ }
+
+void ViewUniformBuffer::update(
+  const AbstractCamera& camera,
+  const glm::vec4& viewport,
+  float time,
+  const glm::vec2& render_scale)
+{
+  glm::mat4 view_projection = _uniforms.projection * _uniforms.view;
+  _uniforms.view = camera.viewTransform();
+  _uniforms.projection = camera.projectionTransform();
+  _uniforms.view_inverse = camera.absoluteTransform();
+  _uniforms.projection_inverse = glm::inverse(_uniforms.projection);
+  _uniforms.previous_view_projection = _updated ?
+    view_projection : _uniforms.projection * _uniforms.view;
+  _uniforms.viewport = viewport;
+  _uniforms.time = time;
+  _uniforms.render_scale = render_scale;
+  _updated = true;
+
+  _buffer.beginFrame();
+  _offset = _buffer.write(&_uniforms, sizeof(ViewUniforms), _offset_alignment);
+}
+
+void ViewUniformBuffer::bind()
+{
+  // glBindBufferRange also changes the generic binding, keep GLState in sync
+  _buffer.bind();
+  glBindBufferRange(
+    GL_UNIFORM_BUFFER, binding, _buffer.id(), _offset, sizeof(ViewUniforms));
+}
+
+} }
@@ -20,7 +20,9 @@ FrameBufferQuad::FrameBufferQuad(
     auto texture = std::get<std::shared_ptr<Texture>>(render_texture);
     auto attachment = std::get<GLenum>(render_texture);
     
-    _color_attachments.push_back(attachment);
+    if (attachment != GL_DEPTH_ATTACHMENT)
+      _color_attachments.push_back(attachment);
+    _sampler_names.push_back(std::get<std::string>(render_texture));
     texture->upload();
     _fbo.attach2DTexture(texture->id(), attachment, 0);
   }
@@ -45,12 +47,11 @@ void FrameBufferQuad::bindTextures()
   for (int i = 0; i < _render_textures.size(); ++i)
   {
     auto texture = std::get<std::shared_ptr<Texture>>(_render_textures[i]);
-    auto name = std::get<std::string>(_render_textures[i]);
     
     _texture_units_in_use[i].activate();
     texture->bind();
-    glUniform1i(glGetUniformLocation(ShaderProgram::currentProgramId(),
-      &name[0]), _texture_units_in_use[i]);
+    ShaderProgram::current().setUniform(
+      _sampler_names[i], _texture_units_in_use[i].unitNumber());
   }
 }
 
@@ -63,12 +64,12 @@ void FrameBufferQuad::bindTextures(
   {
     int render_texture_index = std::get<int>(render_texture_info[i]);
     auto texture = std::get<std::shared_ptr<Texture>>(_render_textures[render_texture_index]);
-    auto name = std::get<std::string>(render_texture_info[i]);
+    const UniformName& name = std::get<UniformName>(render_texture_info[i]);
     
     _texture_units_in_use[i].activate();
     texture->bind();
-    glUniform1i(glGetUniformLocation(ShaderProgram::currentProgramId(),
-      &name[0]), _texture_units_in_use[i]);
+    ShaderProgram::current().setUniform(
+      name, _texture_units_in_use[i].unitNumber());
   }
 }
 
@@ -83,6 +84,8 @@ void FrameBufferQuad::generateMipMaps()
 {
   for (auto render_texture : _render_textures)
   {
+    if (std::get<GLenum>(render_texture) == GL_DEPTH_ATTACHMENT)
+      continue;
     auto texture = std::get<std::shared_ptr<Texture>>(render_texture);
     texture->generateMipMap(); 
   }
@@ -2,17 +2,20 @@
 
 #include "elk/core/renderer.h"
 #include "elk/core/create_mesh.h"
-#include <glm/gtx/matrix_decompose.hpp>
 
 namespace elk { namespace core {
 
+namespace {
+  const UniformName uniform_light_source_color("light_source.color");
+  const UniformName uniform_light_source_direction("light_source.direction");
+  const UniformName uniform_light_source_radiance("light_source.radiance");
+}
+
 PointLightSource::PointLightSource(glm::vec3 color, float radiant_flux) :
   Object3D(),
   _color(color)
 {
   setRadiantFlux(radiant_flux);
-  _quad_mesh = CreateMesh::quad();
-  _sphere_mesh = CreateMesh::lonLatSphere(16, 8);
 }
 
 void PointLightSource::submit(Renderer& renderer)
@@ -28,89 +31,32 @@ void PointLightSource::update(double dt)
   //  relativeTransform() * glm::rotate(float(dt) * 0.1f, glm::vec3(1.0f, 1.0f, 0.0f)) );
 }
 
-void PointLightSource::render(const UsefulRenderData& render_data)
-{
-  // If we are inside the sphere affected by the light source, render a full
-  // quad. Otherwize just render the light sphere
-  glm::vec4 position_world_space = glm::vec4(absoluteTransform()[3]);
-  glm::vec3 position_view_space =
-    glm::vec3(render_data.camera.viewTransform() * position_world_space);
-  float distance_to_light_source = glm::length(position_view_space);
-  
-  // Probably not the best way of handling rescaled light sources,
-  // but works for now..
-  glm::vec3 scale;
-  glm::quat rotation;
-  glm::vec3 translation;
-  glm::vec3 skew;
-  glm::vec4 perspective;
-  glm::decompose(
-    absoluteTransform(), scale, rotation, translation, skew,perspective);
-  float transform_scale = scale.x;
-
-  if (distance_to_light_source < _sphere_scale * transform_scale)
-    renderQuad(render_data);
-  else
-    renderSphere(render_data);
-}
-
-void PointLightSource::renderQuad(const UsefulRenderData& render_data)
-{
-  setupLightSourceUniforms(render_data);
-  _quad_mesh->render();
-}
-
-void PointLightSource::renderSphere(const UsefulRenderData& render_data)
-{
-  glm::mat4 scaled_transform = absoluteTransform();
-  scaled_transform[0][0] *= _sphere_scale;
-  scaled_transform[1][1] *= _sphere_scale;
-  scaled_transform[2][2] *= _sphere_scale;
-
-  glUniformMatrix4fv(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "M"),
-    1,
-    GL_FALSE,
-    &scaled_transform[0][0]);
-  glUniformMatrix4fv(
-      glGetUniformLocation(ShaderProgram::currentProgramId(), "V"),
-      1,
-      GL_FALSE,
-      &render_data.camera.viewTransform()[0][0]);
-  glUniformMatrix4fv(
-      glGetUniformLocation(ShaderProgram::currentProgramId(), "P"),
-      1,
-      GL_FALSE,
-      &render_data.camera.projectionTransform()[0][0]);
-
-  setupLightSourceUniforms(render_data);
-
-  _sphere_mesh->render();
-}
-
-void PointLightSource::setupLightSourceUniforms(const UsefulRenderData& render_data)
-{
-  glm::vec4 position_world_space = glm::vec4(absoluteTransform()[3]);
-  glm::vec4 position_view_space = render_data.camera.viewTransform() * position_world_space;
-
-  glUniform3f(
-    glGetUniformLocation(ShaderProgram::currentProgramId(),
-      "light_source.position"),
-    position_view_space.x, position_view_space.y, position_view_space.z);
-  glUniform3f(
-    glGetUniformLocation(ShaderProgram::currentProgramId(),
-      "light_source.color"),
-    _color.r, _color.g, _color.b);
-  glUniform1f(
-    glGetUniformLocation(ShaderProgram::currentProgramId(),
-      "light_source.radiant_flux"),
-    _radiant_flux);
+PointLightInstance PointLightSource::instance(
+  const glm::mat4& view_transform,
+  const glm::mat4& transform,
+  const glm::vec3& color,
+  float radiant_flux)
+{
+  glm::vec4 position_view_space = view_transform * transform[3];
+  // Rescaled light sources scale their volume by the scale along x
+  float transform_scale = glm::length(glm::vec3(transform[0]));
+  PointLightInstance light;
+  light.position_and_radius = glm::vec4(glm::vec3(position_view_space),
+    radius(radiant_flux) * transform_scale);
+  light.color_and_radiant_flux = glm::vec4(color, radiant_flux);
+  return light;
+}
+
+float PointLightSource::radius(float radiant_flux)
+{
+  return radiant_flux * 16 / 2 * (M_PI * 2); // sqrt(256) / 2
 }
 
 void PointLightSource::setRadiantFlux(float radiant_flux)
 {
   _radiant_flux = radiant_flux;
-  _sphere_scale = _radiant_flux * 16 / 2 * (M_PI * 2); // sqrt(256) / 2
+  _sphere_scale = radius(_radiant_flux);
+  boundsChanged();
 }
 
 void PointLightSource::setColor(glm::vec3 color)
@@ -118,6 +64,16 @@ void PointLightSource::setColor(glm::vec3 color)
   _color = color;
 }
 
+BoundingBox PointLightSource::localBoundingBox() const
+{
+  return BoundingBox(glm::vec3(-_sphere_scale), glm::vec3(_sphere_scale));
+}
+
+BoundingBox PointLightSource::worldBoundingBox() const
+{
+  return localBoundingBox().transformed(absoluteTransform());
+}
+
 DirectionalLightSource::DirectionalLightSource(glm::vec3 color, float radiance) :
   Object3D(),
   _color(color),
@@ -141,30 +97,36 @@ void DirectionalLightSource::update(double dt)
 
 void DirectionalLightSource::render(const UsefulRenderData& render_data)
 {
-  setupLightSourceUniforms(render_data);
-  _quad_mesh->render();
+  render(render_data, absoluteTransform(), _color, _radiance, *_quad_mesh);
+}
+
+void DirectionalLightSource::render(
+  const UsefulRenderData& render_data,
+  const glm::mat4& transform,
+  const glm::vec3& color,
+  float radiance,
+  Mesh& quad_mesh)
+{
+  setupLightSourceUniforms(render_data, transform, color, radiance);
+  quad_mesh.render();
 }
 
-void DirectionalLightSource::setupLightSourceUniforms(const UsefulRenderData& render_data)
+void DirectionalLightSource::setupLightSourceUniforms(
+  const UsefulRenderData& render_data,
+  const glm::mat4& transform,
+  const glm::vec3& color,
+  float radiance)
 {
   glm::vec3 direction_model_space = glm::vec3(0.0f, -1.0f, 0.0f);
   glm::vec3 direction_world_space =
-    glm::mat3(absoluteTransform()) * direction_model_space;
+    glm::mat3(transform) * direction_model_space;
   glm::vec3 direction_view_space =
     glm::mat3(render_data.camera.viewTransform()) * direction_world_space;
 
-  glUniform3f(
-    glGetUniformLocation(ShaderProgram::currentProgramId(),
-      "light_source.direction"),
-    direction_view_space.x, direction_view_space.y, direction_view_space.z);
-  glUniform3f(
-    glGetUniformLocation(ShaderProgram::currentProgramId(),
-      "light_source.color"),
-    _color.r, _color.g, _color.b);
-  glUniform1f(
-    glGetUniformLocation(ShaderProgram::currentProgramId(),
-      "light_source.radiance"),
-    _radiance);
+  ShaderProgram::current().setUniform(uniform_light_source_direction,
+    direction_view_space);
+  ShaderProgram::current().setUniform(uniform_light_source_color, color);
+  ShaderProgram::current().setUniform(uniform_light_source_radiance, radiance);
 }
 
 void DirectionalLightSource::setRadiance(float radiance)
@@ -7,6 +7,10 @@
 
 namespace elk { namespace core {
 
+namespace {
+  const UniformName uniform_cube_map("cube_map");
+}
+
 RenderableCubeMap::RenderableCubeMap(std::shared_ptr<CubeMapTexture> cube_map) :
   _cube_map(cube_map)
 {
@@ -34,7 +38,8 @@ void RenderableCubeMap::render()
   TextureUnit tex_unit_cube_map;
   tex_unit_cube_map.activate();
   _cube_map->bind();
-  glUniform1i(glGetUniformLocation(ShaderProgram::currentProgramId(), "cube_map"), tex_unit_cube_map);
+  ShaderProgram::current().setUniform(
+    uniform_cube_map, tex_unit_cube_map.unitNumber());
 
   _cube->render();
 }
@@ -4,6 +4,10 @@
 
 namespace elk { namespace core {
 
+namespace {
+  const UniformName uniform_M("M");
+}
+
 RenderableGrid::RenderableGrid()
 {
   _program = std::make_shared<ShaderProgram>(
@@ -19,24 +23,15 @@ RenderableGrid::RenderableGrid()
 void RenderableGrid::render(const UsefulRenderData& render_data)
 {
   _program->pushUsage();
-  glUniformMatrix4fv(
-      glGetUniformLocation(ShaderProgram::currentProgramId(), "M"),
-      1,
-      GL_FALSE,
-      &absoluteTransform()[0][0]);
-  glUniformMatrix4fv(
-      glGetUniformLocation(ShaderProgram::currentProgramId(), "V"),
-      1,
-      GL_FALSE,
-      &render_data.camera.viewTransform()[0][0]);
-  glUniformMatrix4fv(
-      glGetUniformLocation(ShaderProgram::currentProgramId(), "P"),
-      1,
-      GL_FALSE,
-      &render_data.camera.projectionTransform()[0][0]);
+  ShaderProgram::current().setUniform(uniform_M, absoluteTransform());
 
   _mesh->render();
   _program->popUsage();
 }
 
+BoundingBox RenderableGrid::localBoundingBox() const
+{
+  return _mesh->boundingBox();
+}
+
 } }
@@ -8,6 +8,10 @@
 
 namespace elk { namespace core {
 
+namespace {
+  const UniformName uniform_M("M");
+}
+
 RenderableModel::RenderableModel(
       std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material) :
   _mesh(mesh),
@@ -18,25 +22,16 @@ void RenderableModel::render(const UsefulRenderData& render_data)
 {
   _material->use();
 
-  glUniformMatrix4fv(
-    glGetUniformLocation(_material->programId(), "M"),
-    1,
-    GL_FALSE,
-    &absoluteTransform()[0][0]);
-  glUniformMatrix4fv(
-      glGetUniformLocation(_material->programId(), "V"),
-      1,
-      GL_FALSE,
-      &render_data.camera.viewTransform()[0][0]);
-  glUniformMatrix4fv(
-      glGetUniformLocation(_material->programId(), "P"),
-      1,
-      GL_FALSE,
-      &render_data.camera.projectionTransform()[0][0]);
+  _material->program().setUniform(uniform_M, absoluteTransform());
 
   _mesh->render();
 }
 
+BoundingBox RenderableModel::localBoundingBox() const
+{
+  return _mesh->boundingBox();
+}
+
 void RenderableModel::update(double dt)
 {
   Object3D::update(dt);
@@ -9,6 +9,7 @@
 #include <vector>
 #include <iostream>
 #include <cassert>
+#include <cstdio>
 
 namespace elk { namespace core {
 
@@ -16,6 +17,11 @@ std::pair<void*, glm::uvec2> loadTexture_freeimage(const char* path)
 {
   FREE_IMAGE_FORMAT format = FreeImage_GetFileType(path,0);
   FIBITMAP* image = FreeImage_Load(format, path);
+  if (!image)
+  {
+    fprintf(stderr, "ERROR : Could not load texture %s\n", path);
+    return {nullptr, glm::uvec2(0)};
+  }
  
   FIBITMAP* temp = image;
   image = FreeImage_ConvertTo32Bits(image);